@@ -3,7 +3,16 @@
 
 #include "libs/v4d/graphics/Camera.hpp"
 #include "libs/v4d/graphics/LightSource.hpp"
+#include "libs/v4d/graphics/LightVolume.hpp"
+#include "libs/v4d/graphics/ShadowAtlas.hpp"
+#include "libs/v4d/graphics/ShadowCascades.hpp"
 #include "libs/v4d/graphics/PrimitiveGeometry.hpp"
+#include "libs/v4d/graphics/MeshInstancing.hpp"
+#include "libs/v4d/graphics/MeshFile.h"
+#include "libs/v4d/graphics/MeshStreamer.h"
+#include "libs/v4d/graphics/DynamicAabbTree.h"
+#include "libs/v4d/graphics/GpuTimer.h"
+#include "libs/v4d/graphics/RenderQueue.h"
 
 using namespace v4d::graphics;
 
@@ -13,13 +22,508 @@ class DeferredRenderer : public Renderer {
 public: // Scene
 	Camera camera;
 	std::vector<LightSource> lightSources {};
+	std::vector<std::shared_ptr<Mesh>> meshes {};
 	std::vector<PrimitiveGeometry> sceneObjects {};
+	DynamicAabbTree sceneTree {}; // user data is the index of the object in sceneObjects
 
-	StagedBuffer cameraUBO {VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(Camera::viewMatrix)};
+	StagedBuffer cameraUBO {VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(Camera::viewMatrix) + sizeof(Camera::projectionMatrix)};
+
+public: // Level of detail
+	double lodMaxPixelError = 1.0; // objects are drawn with the coarsest level whose error is smaller than this many pixels on screen
+	double shadowLodMaxPixelError = 4.0; // shadow casters may use coarser levels than what is visible
+	int shadowLodBias = 1; // additional levels to skip for shadow casters
+
+private: // Instancing
+	// Maximum number of instances drawn per frame, all passes included
+	static const uint32_t maxInstances = 65536;
+
+	// The staging buffer has one region per frame in flight, so that we never overwrite instances that a previous frame has not copied yet
+	Buffer instanceStagingBuffer {VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
+	Buffer instanceBuffer {VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(MeshInstance) * maxInstances};
+
+	std::vector<PrimitiveGeometry*> visibleObjects {};
+	std::vector<PrimitiveGeometry*> shadowCasters {};
+	std::vector<PrimitiveGeometry*> staticShadowCasters {};
+	MeshInstanceList objectInstances {};
+	// One list per shadow map, only the first shadowMapDraws.size() are used, static ones are empty unless their cache is out of date
+	std::vector<MeshInstanceList> shadowInstances {};
+	std::vector<MeshInstanceList> staticShadowInstances {};
+	// Casters of layered shadow maps (shadow cubes and cascades), one entry per layer that a caster overlaps
+	struct ShadowLayer {
+		mat4 viewProjection; // without translation, for the cubes it is the cube's projection times the face's rotation
+		dvec3 origin; // world position that translations are relative to
+		uint32_t layer; // cube * 6 + face, or cascade
+	};
+	std::vector<PrimitiveGeometry*> shadowCubeCasters {};
+	std::vector<ShadowLayer> shadowCubeCasterLayers {}; // one per entry of shadowCubeCasters
+	MeshInstanceList shadowCubeInstances {};
+	std::vector<PrimitiveGeometry*> shadowCascadeCasters {};
+	std::vector<ShadowLayer> shadowCascadeCasterLayers {}; // one per entry of shadowCascadeCasters
+	MeshInstanceList shadowCascadeInstances {};
+
+	// Per-object work of FrameUpdate is spread over these threads, they also load streamed meshes
+	v4d::utilities::ThreadPool threadPool {};
+
+public: // Command recording
+	// Draws and binds recorded in the last frame's command buffer, and the binds that were skipped because the same state was already bound
+	const CommandRecorder::Stats& GetCommandStats() const {return commandStats;}
+
+private: // Command recording
+	CommandRecorder::Stats commandStats {};
+	// Mesh draws of every pass of a frame are queued in it before recording, sorted by pass, state then front to back
+	RenderQueue renderQueue {};
+	// Render passes of the mesh draws, in the order of the sort keys
+	enum DrawPass : uint32_t {
+		GBUFFER_DRAW_PASS = 0,
+		SHADOW_CACHE_DRAW_PASS, // static casters of the shadow map tiles whose cache is out of date
+		SHADOW_ATLAS_DRAW_PASS, // dynamic casters of the shadow map tiles
+		SHADOW_CUBES_DRAW_PASS,
+		SHADOW_CASCADES_DRAW_PASS,
+	};
+
+public: // Lighting
+	enum LightingMode {
+		LIGHTING_PER_LIGHT, // one full screen draw per light type, that shades all the lights of that type for every pixel
+		LIGHTING_CLUSTERED, // lights are binned into clusters by a compute pass, then shaded in a single full screen draw
+		LIGHTING_VOLUMES, // lights with a radius are drawn as spheres (point lights) or cones (spot lights) that only cover the pixels they may reach
+	};
+	LightingMode lightingMode = LIGHTING_CLUSTERED;
+
+	// Cluster grid, depth slices are distributed exponentially between clusterNear and clusterFar (view distance)
+	uint32_t clusterTileSize = 64;
+	uint32_t clusterDepthSlices = 16;
+	float clusterNear = 0.1f;
+	float clusterFar = 1000.0f;
+
+	// GPU time of the lighting (clustering included) in milliseconds, measured a few frames ago
+	double GetLightingGpuTime() const {
+		return gpuTimer.GetMilliseconds("lighting");
+	}
+
+	// Lights with an influence radius are skipped when their sphere is outside of the camera's frustum,
+	// and their full screen draws are scissored to the sphere's rectangle on screen.
+	struct LightCullingStats {
+		uint32_t lights; // lights with an influence radius this frame
+		uint32_t culled; // of which outside of the frustum or off screen
+		uint32_t scissored; // full screen draws limited to a light's rectangle
+		uint64_t pixelsSaved; // pixels of the full screen draws outside of the lights' rectangles
+	};
+	const LightCullingStats& GetLightCullingStats() const {return lightCullingStats;}
+
+private: // Lights
+	// Maximum number of lights in a frame, and per cluster
+	static constexpr uint32_t maxLights = 16384;
+	static constexpr uint32_t maxLightsPerCluster = 256;
+
+	// How a light is drawn, lights of the same group are contiguous in the lights buffer, in this order
+	enum LightGroup {
+		LIGHT_GROUP_CLUSTERED, // first, since the clustering pass bins the lights from 0 to clusteredLightCount
+		LIGHT_GROUP_FULL_SCREEN_POINT, // full screen draws, one per light type
+		LIGHT_GROUP_FULL_SCREEN_SPOT,
+		LIGHT_GROUP_FULL_SCREEN_AMBIENT,
+		LIGHT_GROUP_FULL_SCREEN_DIRECTIONAL,
+		LIGHT_GROUP_SPHERE_VOLUME,
+		LIGHT_GROUP_CONE_VOLUME,
+		LIGHT_GROUP_COUNT
+	};
+	std::array<std::vector<const LightSource*>, LIGHT_GROUP_COUNT> lightGroups {};
+
+	// All the lights of the frame in camera space, uploaded to lightBuffer once per frame
+	std::vector<LightSourceBufferData> frameLights {};
+	uint32_t clusteredLightCount = 0;
+
+	// Full screen draws (all the lights in LIGHTING_PER_LIGHT mode, otherwise the ambient and directional lights),
+	// lights with an influence radius are drawn one by one within their rectangle on screen
+	struct LightBatchDraw {
+		LightBatchPushConstant batch;
+		VkRect2D scissor;
+		uint32_t permutation; // of lightingShader, for the type of the batch's lights
+	};
+	std::vector<LightBatchDraw> lightBatches {};
+	LightCullingStats lightCullingStats {};
+
+	// Lights drawn as volumes, the depth bounds reject the pixels whose depth is out of the light's reach
+	struct LightVolumeDraw {
+		uint32_t light; // index in the lights buffer
+		Mesh* volume;
+		float minDepth, maxDepth;
+		uint32_t permutation; // of lightVolumeShader, for the light's type
+	};
+	std::vector<LightVolumeDraw> lightVolumes {};
+	std::shared_ptr<Mesh> lightVolumeSphere = LightVolume::MakeSphere();
+	std::shared_ptr<Mesh> lightVolumeCone = LightVolume::MakeCone();
+	// Wider spot lights are drawn as spheres
+	float maxSpotLightVolumeAngle = 80;
+
+	// Same staging scheme as the instances
+	Buffer lightStagingBuffer {VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
+	Buffer lightBuffer {VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(LightSourceBufferData) * maxLights};
+
+	// Sized for the swapchain's extent
+	Buffer clusterLightCountBuffer {VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+	Buffer clusterLightIndexBuffer {VK_BUFFER_USAGE_STORAGE_BUFFER_BIT};
+
+	GpuTimer gpuTimer {};
+
+	LightClusterGridPushConstant MakeClusterGrid() const {
+		return {
+			{swapChain->extent.width, swapChain->extent.height},
+			clusterTileSize,
+			clusterDepthSlices,
+			clusterNear,
+			clusterFar,
+			(float)camera.projectionMatrix[0][0],
+			(float)camera.projectionMatrix[1][1],
+			clusteredLightCount,
+			maxLightsPerCluster,
+		};
+	}
+
+	uint32_t GetClusterCount(uint32_t* tilesX = nullptr, uint32_t* tilesY = nullptr) const {
+		uint32_t x = (swapChain->extent.width + clusterTileSize - 1) / clusterTileSize;
+		uint32_t y = (swapChain->extent.height + clusterTileSize - 1) / clusterTileSize;
+		if (tilesX) *tilesX = x;
+		if (tilesY) *tilesY = y;
+		return x * y * clusterDepthSlices;
+	}
+
+public: // Shadows
+	// Spot lights cast shadows in tiles of a shadow atlas, the ones that cover more of the screen get larger tiles
+	ShadowAtlas shadowAtlas {};
+	static constexpr uint32_t maxShadowMaps = 64;
+
+	// Point lights cast shadows in the cubes of a cube map array, all rendered in a single layered pass.
+	// Each caster is drawn once per cube with one instance per face that it overlaps (culled on the CPU), and a geometry shader selects the face's layer.
+	// Shadow cubes use hardware PCF whatever the shadowFilter, and are not cached.
+	uint32_t shadowCubeSize = 512;
+	static constexpr uint32_t maxShadowCubes = 8;
+
+	// The first directional light casts shadows in cascades that cover the camera's frustum up to shadowCascades.distance,
+	// all rendered in a single layered pass like the shadow cubes, with hardware PCF and no caching.
+	// Its count and size are applied when the resources are created (ReloadRenderer() after changing them).
+	ShadowCascades shadowCascades {};
+
+	// How shadow maps are filtered, these are applied when the pipelines are created (ReloadRenderer() after changing them)
+	enum ShadowFilter {
+		SHADOW_FILTER_HARDWARE_PCF, // one comparison sample per pixel, bilinearly filtered by the sampler (2x2 texels)
+		SHADOW_FILTER_POISSON, // shadowFilterTaps comparison samples on a Poisson disk of shadowFilterRadius texels, rotated per pixel
+		SHADOW_FILTER_VARIANCE, // depth moments are blurred over shadowFilterRadius texels by a compute pass, then filtered by the sampler
+		SHADOW_FILTER_EXPONENTIAL, // same as variance, with the exponential of the depth
+	};
+	ShadowFilter shadowFilter = SHADOW_FILTER_POISSON;
+	uint32_t shadowFilterTaps = 16; // 1 to 32
+	float shadowFilterRadius = 3; // in texels, at most 8 when prefiltered
+	float shadowExponent = 80; // exponential shadow maps, at most 88 for the exponential to fit in a float
+
+	// Blinn-Phong specular of the lighting shaders, also applied when the pipelines are created
+	float specularPower = 32;
+	float specularStrength = 0.5f;
+
+	// GPU time in milliseconds, measured a few frames ago, of rendering the shadow maps and of prefiltering them (variance and exponential only).
+	// Sampling them is part of the lighting's time.
+	double GetShadowGpuTime() const {
+		return gpuTimer.GetMilliseconds("shadows");
+	}
+	double GetShadowPrefilteringGpuTime() const {
+		return gpuTimer.GetMilliseconds("shadow prefiltering");
+	}
+
+	// Static casters are rendered into a cached atlas only when their shadow map is out of date,
+	// then each frame the cached tiles are copied to the atlas and dynamic casters are rendered on top.
+	struct ShadowCacheStats {
+		uint32_t shadowMaps; // shadow maps drawn this frame
+		uint32_t staticUpdates; // of which the static casters were rendered again
+		uint32_t skippedUpdates; // of which the static casters came from the cache
+		uint64_t totalSkippedUpdates;
+	};
+	const ShadowCacheStats& GetShadowCacheStats() const {return shadowCacheStats;}
+
+	// The static casters of these lights' shadow maps will be rendered again on the next frame
+	void InvalidateShadowCache(size_t lightIndex) {
+		if (lightIndex < shadowCache.size()) shadowCache[lightIndex].valid = false;
+	}
+	void InvalidateShadowCaches() {
+		for (auto& entry : shadowCache) entry.valid = false;
+	}
+	// Only the lights that may cast a shadow of something within these bounds
+	void InvalidateShadowCaches(const Aabb& bounds) {
+		for (size_t i = 0; i < shadowCache.size() && i < lightSources.size(); ++i) {
+			if (BoundingSphere{lightSources[i].worldPosition, lightSources[i].GetShadowRange()}.Test(bounds) != OUTSIDE) {
+				shadowCache[i].valid = false;
+			}
+		}
+	}
+
+private: // Shadows
+	struct ShadowMapDraw {
+		ShadowAtlas::Tile tile;
+		mat4 projectionMatrix;
+		bool updateStatic; // the cached static casters are out of date
+	};
+	std::vector<ShadowMapDraw> shadowMapDraws {};
+	std::vector<ShadowMapBufferData> frameShadowMaps {};
+	std::vector<int32_t> lightShadowMaps {}; // shadow map index of each light in lightSources, -1 if none
+	uint32_t shadowCubeCount = 0; // cubes drawn this frame, their shadow maps follow the spot lights' ones
+	uint32_t shadowCascadeCount = 0; // cascades drawn this frame, their shadow maps follow the cubes' ones
+
+	// What the cached static casters of a light were rendered with, they are rendered again when any of it changes
+	struct ShadowCacheEntry {
+		bool valid = false;
+		ShadowAtlas::Tile tile {0, 0, 0};
+		dvec3 worldPosition {0};
+		vec3 worldDirection {0};
+		float outerAngle = 0;
+		float radius = 0;
+	};
+	std::vector<ShadowCacheEntry> shadowCache {}; // one per light in lightSources
+	ShadowCacheStats shadowCacheStats {};
+	bool shadowCacheImageReady = false; // false until the cached atlas' layout is set on first use
+
+	bool IsShadowFilterPrefiltered() const {
+		return shadowFilter == SHADOW_FILTER_VARIANCE || shadowFilter == SHADOW_FILTER_EXPONENTIAL;
+	}
+
+	// Specialization constants of the lighting and prefiltering shaders, from the shadow filter and specular options when the pipelines are created
+	struct LightingConstants {
+		int32_t shadowFilter;
+		int32_t shadowFilterTaps;
+		float shadowFilterRadius;
+		float shadowExponent;
+		float specularPower;
+		float specularStrength;
+	};
+	SpecializationConstants<LightingConstants> lightingConstants {};
+
+	// Permutations of the lighting shaders for a single light type, whose branches on the light's type are resolved when the pipeline is created
+	struct LightTypeConstants {
+		int32_t lightType;
+	};
+	SpecializationConstants<LightTypeConstants> lightTypeConstants {};
+	std::array<uint32_t, 4> lightingPermutations {}; // per light type, of lightingShader
+	std::array<uint32_t, 4> lightVolumePermutations {}; // per light type, of lightVolumeShader
+
+	// Same staging scheme as the lights
+	Buffer shadowMapStagingBuffer {VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
+	Buffer shadowMapBuffer {VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(ShadowMapBufferData) * maxShadowMaps};
+
+	// Selects the spot lights that cast shadows this frame, assigns their tiles in the atlas and culls their shadow casters
+	void UpdateShadowMaps(const Frustum& cameraFrustum) {
+		struct ShadowedLight {
+			size_t lightIndex;
+			double screenCoverage; // in pixels
+			uint32_t tileSize;
+		};
+		std::vector<ShadowedLight> shadowedLights;
+		for (size_t i = 0; i < lightSources.size(); ++i) {
+			auto& lightSource = lightSources[i];
+			if (lightSource.type != SPOT_LIGHT) continue;
+			double range = lightSource.GetShadowRange();
+			if (cameraFrustum.Test(BoundingSphere{lightSource.worldPosition, range}) == OUTSIDE) continue;
+			double distance = glm::distance(camera.worldPosition, lightSource.worldPosition);
+			double screenCoverage = 2.0 * range * camera.GetPixelsPerUnit(distance - range, swapChain->extent.height);
+			shadowedLights.push_back({i, screenCoverage, shadowAtlas.GetTileSize(screenCoverage)});
+		}
+		std::sort(shadowedLights.begin(), shadowedLights.end(), [](const ShadowedLight& a, const ShadowedLight& b){
+			return a.screenCoverage > b.screenCoverage;
+		});
+		if (shadowedLights.size() > maxShadowMaps) shadowedLights.resize(maxShadowMaps);
+
+		// Tiles are placed in order of size then light, so that they stay where they are (and cached) while the sizes do not change
+		std::sort(shadowedLights.begin(), shadowedLights.end(), [](const ShadowedLight& a, const ShadowedLight& b){
+			return a.tileSize != b.tileSize ? a.tileSize > b.tileSize : a.lightIndex < b.lightIndex;
+		});
+		std::vector<uint32_t> tileSizes;
+		for (auto& shadowedLight : shadowedLights) tileSizes.push_back(shadowedLight.tileSize);
+		auto tiles = shadowAtlas.Allocate(tileSizes);
+
+		if (shadowCache.size() != lightSources.size()) shadowCache.assign(lightSources.size(), {});
+		// A light without a tile may have its cached tile overwritten by another light
+		std::vector<bool> hasTile(lightSources.size(), false);
+
+		lightShadowMaps.assign(lightSources.size(), -1);
+		shadowMapDraws.clear();
+		frameShadowMaps.clear();
+		shadowCacheStats.staticUpdates = 0;
+		if (shadowInstances.size() < shadowedLights.size()) shadowInstances.resize(shadowedLights.size());
+		if (staticShadowInstances.size() < shadowedLights.size()) staticShadowInstances.resize(shadowedLights.size());
+		for (size_t i = 0; i < shadowedLights.size(); ++i) {
+			auto& tile = tiles[i];
+			if (tile.size == 0) continue; // the atlas is full
+			size_t lightIndex = shadowedLights[i].lightIndex;
+			auto& lightSource = lightSources[lightIndex];
+			hasTile[lightIndex] = true;
+			lightShadowMaps[lightIndex] = (int32_t)frameShadowMaps.size();
+			frameShadowMaps.push_back({lightSource.MakeCameraViewToShadowMapMatrix(camera), vec4(tile.x, tile.y, tile.size, tile.size) / float(shadowAtlas.size)});
+
+			auto& cache = shadowCache[lightIndex];
+			bool updateStatic = !cache.valid
+				|| cache.tile.x != tile.x || cache.tile.y != tile.y || cache.tile.size != tile.size
+				|| cache.worldPosition != lightSource.worldPosition
+				|| cache.worldDirection != lightSource.worldDirection
+				|| cache.outerAngle != lightSource.outerAngle
+				|| cache.radius != lightSource.radius;
+			if (updateStatic) {
+				cache = {true, tile, lightSource.worldPosition, lightSource.worldDirection, lightSource.outerAngle, lightSource.radius};
+				shadowCacheStats.staticUpdates++;
+			}
+
+			// Shadow casters are the objects within the light's cone, whether or not they are visible from the camera
+			shadowCasters.clear();
+			staticShadowCasters.clear();
+			sceneTree.Query(BoundingCone{lightSource.worldPosition, glm::normalize(dvec3(lightSource.worldDirection)), lightSource.GetShadowRange(), glm::radians((double)lightSource.outerAngle)}, [this, updateStatic](uint32_t objectIndex){
+				auto& obj = sceneObjects[objectIndex];
+				if (!obj.isStatic) shadowCasters.push_back(&obj);
+				else if (updateStatic) staticShadowCasters.push_back(&obj);
+			});
+			glm::mat4 lightViewRotation = glm::mat4(glm::mat3(lightSource.MakeLightViewMatrix()));
+			auto makeInstance = [&lightSource, &lightViewRotation](const PrimitiveGeometry& obj){
+				MeshInstance instance;
+				instance.SetTransform(lightViewRotation, glm::translate(glm::mat4(1), glm::vec3(dvec3(obj.position) - lightSource.worldPosition)));
+				return instance;
+			};
+			auto selectLod = [this](const PrimitiveGeometry& obj){
+				// Shadow detail is only noticeable where the camera looks, so the level is selected from the camera's point of view
+				return SelectLod(obj, shadowLodMaxPixelError, shadowLodBias);
+			};
+			shadowInstances[shadowMapDraws.size()].Build(shadowCasters, makeInstance, selectLod, &threadPool);
+			staticShadowInstances[shadowMapDraws.size()].Build(staticShadowCasters, makeInstance, selectLod, &threadPool);
+			shadowMapDraws.push_back({tile, lightSource.MakeLightProjectionMatrix(), updateStatic});
+		}
+		for (size_t i = 0; i < shadowCache.size(); ++i) {
+			if (!hasTile[i]) shadowCache[i].valid = false;
+		}
+
+		shadowCacheStats.shadowMaps = shadowMapDraws.size();
+		shadowCacheStats.skippedUpdates = shadowCacheStats.shadowMaps - shadowCacheStats.staticUpdates;
+		shadowCacheStats.totalSkippedUpdates += shadowCacheStats.skippedUpdates;
+	}
+
+	// Selects the point lights that cast shadows this frame and lists their casters per cube face, must be called after UpdateShadowMaps()
+	void UpdateShadowCubes(const Frustum& cameraFrustum) {
+		struct ShadowedLight {
+			size_t lightIndex;
+			double screenCoverage; // in pixels
+		};
+		std::vector<ShadowedLight> shadowedLights;
+		for (size_t i = 0; i < lightSources.size(); ++i) {
+			auto& lightSource = lightSources[i];
+			if (lightSource.type != POINT_LIGHT) continue;
+			double range = lightSource.GetShadowRange();
+			if (cameraFrustum.Test(BoundingSphere{lightSource.worldPosition, range}) == OUTSIDE) continue;
+			double distance = glm::distance(camera.worldPosition, lightSource.worldPosition);
+			shadowedLights.push_back({i, 2.0 * range * camera.GetPixelsPerUnit(distance - range, swapChain->extent.height)});
+		}
+		std::sort(shadowedLights.begin(), shadowedLights.end(), [](const ShadowedLight& a, const ShadowedLight& b){
+			return a.screenCoverage > b.screenCoverage;
+		});
+		size_t maxCubes = std::min<size_t>(maxShadowCubes, maxShadowMaps - frameShadowMaps.size());
+		if (shadowedLights.size() > maxCubes) shadowedLights.resize(maxCubes);
+
+		shadowCubeCasters.clear();
+		shadowCubeCasterLayers.clear();
+		shadowCubeCount = 0;
+		for (auto& shadowedLight : shadowedLights) {
+			auto& lightSource = lightSources[shadowedLight.lightIndex];
+			uint32_t cube = shadowCubeCount++;
+			mat4 projection = lightSource.MakeShadowCubeProjectionMatrix();
+			lightShadowMaps[shadowedLight.lightIndex] = (int32_t)frameShadowMaps.size();
+			ShadowMapBufferData shadowMap {lightSource.MakeCameraViewToShadowCubeMatrix(camera), vec4(0)};
+			shadowMap.cubeDepthProjection = {projection[2][2], projection[3][2]};
+			shadowMap.layer = (int32_t)cube;
+			frameShadowMaps.push_back(shadowMap);
+
+			mat4 faceViewProjections[6];
+			for (int face = 0; face < 6; ++face) faceViewProjections[face] = projection * LightSource::MakeShadowCubeFaceRotation(face);
+
+			// A face sees the pyramid where its axis is the major one, a box overlaps it if the box's farthest point along the axis
+			// is at least as far as the box's closest point to the axis, on both other axes.
+			sceneTree.Query(BoundingSphere{lightSource.worldPosition, lightSource.GetShadowRange()}, [&](uint32_t objectIndex){
+				auto& obj = sceneObjects[objectIndex];
+				auto bounds = obj.GetWorldBounds();
+				vec3 boundsMin = vec3(dvec3(bounds.min) - lightSource.worldPosition);
+				vec3 boundsMax = vec3(dvec3(bounds.max) - lightSource.worldPosition);
+				vec3 minAbs = glm::max(glm::max(boundsMin, -boundsMax), vec3(0)); // 0 where the box straddles the axis
+				for (int face = 0; face < 6; ++face) {
+					int axis = face / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+					float farthest = face % 2 == 0 ? boundsMax[axis] : -boundsMin[axis];
+					if (farthest < minAbs[u] || farthest < minAbs[v]) continue;
+					shadowCubeCasters.push_back(&obj);
+					shadowCubeCasterLayers.push_back({faceViewProjections[face], lightSource.worldPosition, cube * 6 + face});
+				}
+			});
+		}
+
+		// All cubes in the same instance list, so that each mesh is drawn once for all of them
+		BuildLayeredShadowInstances(shadowCubeInstances, shadowCubeCasters, shadowCubeCasterLayers);
+	}
+
+	// Fits the cascades of the first directional light to the camera's frustum and culls their casters, must be called after UpdateShadowCubes()
+	void UpdateShadowCascades() {
+		shadowCascadeCasters.clear();
+		shadowCascadeCasterLayers.clear();
+		shadowCascadeCount = 0;
+		auto lightSource = std::find_if(lightSources.begin(), lightSources.end(), [](const LightSource& light){return light.type == DIRECTIONAL_LIGHT;});
+		if (lightSource == lightSources.end()) return;
+
+		auto cascades = shadowCascades.Fit(camera, (double)swapChain->extent.width / swapChain->extent.height, dvec3(lightSource->worldDirection));
+		if (frameShadowMaps.size() + cascades.size() > maxShadowMaps) return;
+		lightShadowMaps[lightSource - lightSources.begin()] = (int32_t)frameShadowMaps.size();
+		dmat4 cameraViewToWorld = inverse(camera.viewMatrix);
+		for (auto& cascade : cascades) {
+			uint32_t layer = shadowCascadeCount++;
+			ShadowMapBufferData shadowMap {mat4(cascade.projectionMatrix * cascade.viewMatrix * cameraViewToWorld), vec4(0)};
+			shadowMap.layer = (int32_t)layer;
+			shadowMap.cascadeEnd = (float)cascade.end;
+			shadowMap.cascadeCount = (int32_t)cascades.size();
+			frameShadowMaps.push_back(shadowMap);
+
+			// Casters within the cascade's box, which extends towards the light by shadowCascades.casterDistance
+			mat4 viewProjection = mat4(cascade.projectionMatrix * dmat4(dmat3(cascade.viewMatrix)));
+			sceneTree.Query(Frustum::FromMatrix(cascade.projectionMatrix * cascade.viewMatrix), [&](uint32_t objectIndex){
+				shadowCascadeCasters.push_back(&sceneObjects[objectIndex]);
+				shadowCascadeCasterLayers.push_back({viewProjection, cascade.eye, layer});
+			});
+		}
+		BuildLayeredShadowInstances(shadowCascadeInstances, shadowCascadeCasters, shadowCascadeCasterLayers);
+	}
+
+	void BuildLayeredShadowInstances(MeshInstanceList& instanceList, const std::vector<PrimitiveGeometry*>& casters, const std::vector<ShadowLayer>& layers) {
+		instanceList.Build(casters, [&layers](size_t i, const PrimitiveGeometry& obj){
+			auto& layer = layers[i];
+			MeshInstance instance;
+			instance.SetTransform(layer.viewProjection, glm::translate(glm::mat4(1), glm::vec3(dvec3(obj.position) - layer.origin)));
+			instance.SetLayer(layer.layer);
+			return instance;
+		}, [this](const PrimitiveGeometry& obj){
+			return SelectLod(obj, shadowLodMaxPixelError, shadowLodBias);
+		}, &threadPool);
+	}
+
+public: // Skybox
+	// The skybox is only generated when the resources are created or after InvalidateSkybox() (when what it shows changes),
+	// then each of its mip levels is prefiltered from the previous one by a compute pass, for rough reflections.
+	void InvalidateSkybox() {
+		skyboxDirty = true;
+	}
+	// GPU time in milliseconds of the last generation, prefiltering included
+	double GetSkyboxGpuTime() const {
+		return gpuTimer.GetMilliseconds("skybox");
+	}
+
+private: // Skybox
+	static constexpr uint32_t skyboxMipLevels = 6; // same as shaders/skybox.prefilter.comp
+	bool skyboxDirty = true;
+	struct SkyboxMipPushConstant {
+		uint32_t mip;
+	};
+
+public: // Streaming
+	MeshStreamer meshStreamer {threadPool, MAX_FRAMES_IN_FLIGHT};
+	double streamingDistance = 1000; // streamed meshes of objects within this distance from the camera are made resident
 
 private: // Shaders
 
-    PipelineLayout rasterizationLayout, lightingLayout;
+    PipelineLayout rasterizationLayout, lightingLayout, lightClusteringLayout, clusteredLightingLayout, shadowPrefilteringLayout, skyboxPrefilteringLayout;
 
     RasterShaderPipeline primitivesShader {rasterizationLayout, {
         "shaders/primitives.vert",
@@ -31,6 +535,18 @@ private: // Shaders
         "shaders/primitives.shadow.frag",
     }};
 
+    RasterShaderPipeline shadowCubeShader {rasterizationLayout, {
+        "shaders/primitives.shadow.layered.vert",
+        "shaders/primitives.shadow.layered.geom",
+        "shaders/primitives.shadow.frag",
+    }};
+
+    RasterShaderPipeline shadowCascadeShader {rasterizationLayout, {
+        "shaders/primitives.shadow.layered.vert",
+        "shaders/primitives.shadow.layered.geom",
+        "shaders/primitives.shadow.frag",
+    }};
+
     RasterShaderPipeline skyboxShader {rasterizationLayout, {
         "shaders/skybox.vert",
         "shaders/skybox.geom",
@@ -39,11 +555,27 @@ private: // Shaders
 
     RasterShaderPipeline lightingShader {lightingLayout, {
         "shaders/lighting.vert",
-        "shaders/lighting.frag",
+        {"shaders/lighting.frag", "main", lightingConstants.GetInfo()},
     }};
 
+    RasterShaderPipeline lightVolumeShader {lightingLayout, {
+        "shaders/lighting.volume.vert",
+        {"shaders/lighting.frag", "main", lightingConstants.GetInfo()},
+    }};
+
+    ComputeShaderPipeline lightClusteringShader {lightClusteringLayout, "shaders/lighting.clusters.comp"};
+
+    RasterShaderPipeline clusteredLightingShader {clusteredLightingLayout, {
+        "shaders/lighting.vert",
+        {"shaders/lighting.clustered.frag", "main", lightingConstants.GetInfo()},
+    }};
+
+    ComputeShaderPipeline shadowPrefilteringShader {shadowPrefilteringLayout, {"shaders/shadows.prefilter.comp", "main", lightingConstants.GetInfo()}};
+
+    ComputeShaderPipeline skyboxPrefilteringShader {skyboxPrefilteringLayout, "shaders/skybox.prefilter.comp"};
+
 private: // Render passes
-    RenderPass rasterizationPass, shadowPass, skyboxPass, lightingPass;
+    RenderPass rasterizationPass, shadowCachePass, shadowPass, shadowCubePass, shadowCascadePass, skyboxPass, lightingPass;
 
 private: // Images
 	Image gBuffer_albedo { VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT ,1,1, { VK_FORMAT_R32G32B32A32_SFLOAT }};
@@ -51,10 +583,14 @@ private: // Images
 	Image gBuffer_position { VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT ,1,1, { VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT }};
 	DepthStencilImage depthStencilImage {};
 	
-	DepthImage spotLightShadowMap { VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT };
-	int shadowMapSize = 1024;
+	DepthImage shadowAtlasImage { VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT };
+	DepthImage shadowAtlasCacheImage { VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT }; // static casters only
+	Image shadowMomentsImage { VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT ,1,1, { VK_FORMAT_R32G32_SFLOAT }}; // prefiltered shadow maps, 1x1 when not used
+	DepthCubeMapImage shadowCubesImage { VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, maxShadowCubes }; // sampled as a cube array (imageCubeArray feature)
+	DepthArrayImage shadowCascadesImage { VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, ShadowCascades::maxCount };
 
-	CubeMapImage skybox {};
+	// Compact HDR format (4 bytes per texel), with a fallback that all devices can render to and store into
+	CubeMapImage skybox { VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, { VK_FORMAT_B10G11R11_UFLOAT_PACK32, VK_FORMAT_R16G16B16A16_SFLOAT }, skyboxMipLevels };
 	int skyboxSize = 1024;
 
 	std::vector<VkClearValue> clearValues{4};
@@ -62,37 +598,85 @@ private: // Images
 private: // Init
     void Init() override {
 		cameraUBO.AddSrcDataPtr(&camera.viewMatrix, sizeof(Camera::viewMatrix));
+		cameraUBO.AddSrcDataPtr(&camera.projectionMatrix, sizeof(Camera::projectionMatrix));
 	}
     void ScorePhysicalDeviceSelection(int&, PhysicalDevice*) override {}
 
+	// The stages of the bindings and push constants are those of the shaders that read them (see Renderer::ReflectLayouts)
 	void InitLayouts() override {
 		// Base descriptor set containing Camera and such
 		auto* baseDescriptorSet_0 = descriptorSets.emplace_back(new DescriptorSet(0));
-        baseDescriptorSet_0->AddBinding_uniformBuffer(0, &cameraUBO.deviceLocalBuffer, VK_SHADER_STAGE_FRAGMENT_BIT);
+        baseDescriptorSet_0->AddBinding_uniformBuffer(0, &cameraUBO.deviceLocalBuffer);
 
 		// Rasterization
 		rasterizationLayout.AddDescriptorSet(baseDescriptorSet_0);
-        rasterizationLayout.AddPushConstant<PrimitiveGeometry::MVP>(VK_SHADER_STAGE_VERTEX_BIT);
+        rasterizationLayout.AddPushConstant<MeshInstancePushConstant>();
 
 		// Lighting
 		auto* gBuffersDescriptorSet_1 = descriptorSets.emplace_back(new DescriptorSet(1));
-		gBuffersDescriptorSet_1->AddBinding_inputAttachment(0, &gBuffer_albedo.view, VK_SHADER_STAGE_FRAGMENT_BIT);
-		gBuffersDescriptorSet_1->AddBinding_inputAttachment(1, &gBuffer_normal.view, VK_SHADER_STAGE_FRAGMENT_BIT);
-		gBuffersDescriptorSet_1->AddBinding_inputAttachment(2, &gBuffer_position.view, VK_SHADER_STAGE_FRAGMENT_BIT);
-		gBuffersDescriptorSet_1->AddBinding_combinedImageSampler(3, &spotLightShadowMap, VK_SHADER_STAGE_FRAGMENT_BIT);
-		gBuffersDescriptorSet_1->AddBinding_combinedImageSampler(4, &skybox, VK_SHADER_STAGE_FRAGMENT_BIT);
+		gBuffersDescriptorSet_1->AddBinding_inputAttachment(0, &gBuffer_albedo.view);
+		gBuffersDescriptorSet_1->AddBinding_inputAttachment(1, &gBuffer_normal.view);
+		gBuffersDescriptorSet_1->AddBinding_inputAttachment(2, &gBuffer_position.view);
+		gBuffersDescriptorSet_1->AddBinding_combinedImageSampler(3, &shadowAtlasImage);
+		gBuffersDescriptorSet_1->AddBinding_combinedImageSampler(4, &skybox);
+		gBuffersDescriptorSet_1->AddBinding_combinedImageSampler(5, &shadowMomentsImage);
+		gBuffersDescriptorSet_1->AddBinding_combinedImageSampler(6, &shadowCubesImage);
+		gBuffersDescriptorSet_1->AddBinding_combinedImageSampler(7, &shadowCascadesImage);
+		auto* lightsDescriptorSet_2 = descriptorSets.emplace_back(new DescriptorSet(2));
+		lightsDescriptorSet_2->AddBinding_storageBuffer(0, &lightBuffer);
+		lightsDescriptorSet_2->AddBinding_storageBuffer(1, &clusterLightCountBuffer);
+		lightsDescriptorSet_2->AddBinding_storageBuffer(2, &clusterLightIndexBuffer);
+		lightsDescriptorSet_2->AddBinding_storageBuffer(3, &shadowMapBuffer);
+		lightsDescriptorSet_2->SetBufferType<LightSourceBufferData>(0);
+		lightsDescriptorSet_2->SetBufferType<uint32_t>(1);
+		lightsDescriptorSet_2->SetBufferType<uint32_t>(2);
+		lightsDescriptorSet_2->SetBufferType<ShadowMapBufferData>(3);
 		lightingLayout.AddDescriptorSet(baseDescriptorSet_0);
 		lightingLayout.AddDescriptorSet(gBuffersDescriptorSet_1);
-		lightingLayout.AddPushConstant<LightSourcePushConstant>(VK_SHADER_STAGE_FRAGMENT_BIT);
+		lightingLayout.AddDescriptorSet(lightsDescriptorSet_2);
+		lightingLayout.AddPushConstant<LightBatchPushConstant>();
+
+		// Clustered lighting
+		lightClusteringLayout.AddDescriptorSet(lightsDescriptorSet_2); // set 0 in the compute shader
+		lightClusteringLayout.AddPushConstant<LightClusterGridPushConstant>();
+		clusteredLightingLayout.AddDescriptorSet(baseDescriptorSet_0);
+		clusteredLightingLayout.AddDescriptorSet(gBuffersDescriptorSet_1);
+		clusteredLightingLayout.AddDescriptorSet(lightsDescriptorSet_2);
+		clusteredLightingLayout.AddPushConstant<LightClusterGridPushConstant>(); // lighting.vert's batch block only gets the start of it, which it does not use here
+
+		// Shadow prefiltering
+		auto* shadowPrefilteringDescriptorSet_3 = descriptorSets.emplace_back(new DescriptorSet(3));
+		shadowPrefilteringDescriptorSet_3->AddBinding_combinedImageSampler(0, &shadowAtlasImage);
+		shadowPrefilteringDescriptorSet_3->AddBinding_imageView(1, &shadowMomentsImage.view);
+		shadowPrefilteringLayout.AddDescriptorSet(shadowPrefilteringDescriptorSet_3); // set 0 in the compute shader
+		shadowPrefilteringLayout.AddDescriptorSet(lightsDescriptorSet_2); // set 1, for the shadow maps' tiles
+
+		// Skybox prefiltering, reads the previous mip level and writes the next one
+		auto* skyboxPrefilteringDescriptorSet_4 = descriptorSets.emplace_back(new DescriptorSet(4));
+		skyboxPrefilteringDescriptorSet_4->AddBinding_combinedImageSampler(0, &skybox);
+		skyboxPrefilteringDescriptorSet_4->AddBinding_imageView(1, &skybox.mipViews[1], VK_SHADER_STAGE_ALL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, skyboxMipLevels - 1);
+		skyboxPrefilteringLayout.AddDescriptorSet(skyboxPrefilteringDescriptorSet_4); // set 0 in the compute shader
+		skyboxPrefilteringLayout.AddPushConstant<SkyboxMipPushConstant>();
 	}
 	
 	void ConfigureShaders() override {
+		// Specialization constants, same constant_id as in the shaders
+		lightingConstants
+			.Bind(0, &LightingConstants::shadowFilter)
+			.Bind(1, &LightingConstants::shadowFilterTaps)
+			.Bind(2, &LightingConstants::shadowFilterRadius)
+			.Bind(3, &LightingConstants::shadowExponent)
+			.Bind(5, &LightingConstants::specularPower)
+			.Bind(6, &LightingConstants::specularStrength);
+		lightTypeConstants.Bind(4, &LightTypeConstants::lightType);
+
 		// Rasterization Pass
 		primitivesShader.inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		primitivesShader.depthStencilState.depthTestEnable = VK_TRUE;
 		primitivesShader.depthStencilState.depthWriteEnable = VK_TRUE;
         primitivesShader.rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
         primitivesShader.AddVertexInputBinding(sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX, Vertex::GetInputAttributes());
+        primitivesShader.AddVertexInputBinding(sizeof(MeshInstance), VK_VERTEX_INPUT_RATE_INSTANCE, MeshInstance::GetInputAttributes());
 
 		// Shadow map
 		shadowMapShader.inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -100,6 +684,19 @@ private: // Init
 		shadowMapShader.depthStencilState.depthWriteEnable = VK_TRUE;
         shadowMapShader.rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
         shadowMapShader.AddVertexInputBinding(sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX, Vertex::GetInputAttributes());
+        shadowMapShader.AddVertexInputBinding(sizeof(MeshInstance), VK_VERTEX_INPUT_RATE_INSTANCE, MeshInstance::GetInputAttributes());
+		shadowMapShader.dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR}; // set to each light's tile of the atlas
+
+		// Shadow cubes and cascades, their projections do not flip y like the camera's so front faces are clockwise
+		for (auto* shader : {&shadowCubeShader, &shadowCascadeShader}) {
+			shader->inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+			shader->depthStencilState.depthTestEnable = VK_TRUE;
+			shader->depthStencilState.depthWriteEnable = VK_TRUE;
+			shader->rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+			shader->rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+			shader->AddVertexInputBinding(sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX, Vertex::GetInputAttributes());
+			shader->AddVertexInputBinding(sizeof(MeshInstance), VK_VERTEX_INPUT_RATE_INSTANCE, MeshInstance::GetLayeredInputAttributes());
+		}
 		
 		// Skybox
 		skyboxShader.inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
@@ -114,6 +711,21 @@ private: // Init
 		lightingShader.depthStencilState.depthWriteEnable = VK_FALSE;
 		lightingShader.rasterizer.cullMode = VK_CULL_MODE_NONE;
 		lightingShader.SetData(3);
+		lightingShader.dynamicStates = {VK_DYNAMIC_STATE_SCISSOR}; // set to each light's rectangle on screen
+		clusteredLightingShader.inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		clusteredLightingShader.depthStencilState.depthTestEnable = VK_FALSE;
+		clusteredLightingShader.depthStencilState.depthWriteEnable = VK_FALSE;
+		clusteredLightingShader.rasterizer.cullMode = VK_CULL_MODE_NONE;
+		clusteredLightingShader.SetData(3);
+
+		// Light volumes, only their back faces are drawn so that they still cover the screen when the camera is inside,
+		// and they are depth tested against the scene so that what lies behind a volume is not lit.
+		lightVolumeShader.inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		lightVolumeShader.depthStencilState.depthTestEnable = VK_TRUE;
+		lightVolumeShader.depthStencilState.depthWriteEnable = VK_FALSE;
+		lightVolumeShader.depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL; // reversed depth, passes where the back face is behind the scene
+		lightVolumeShader.rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
+		lightVolumeShader.AddVertexInputBinding(sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX, Vertex::GetInputAttributes());
 	}
 	
 private: // Resources
@@ -123,8 +735,24 @@ private: // Resources
 		gBuffer_albedo.Create(renderingDevice, swapChain->extent.width, swapChain->extent.height);
 		gBuffer_normal.Create(renderingDevice, swapChain->extent.width, swapChain->extent.height);
 		gBuffer_position.Create(renderingDevice, swapChain->extent.width, swapChain->extent.height);
-		spotLightShadowMap.Create(renderingDevice, shadowMapSize, shadowMapSize);
+		// Prefiltered shadow maps read the depth itself, the others are sampled with hardware comparison
+		shadowAtlasImage.samplerInfo.compareEnable = IsShadowFilterPrefiltered()? VK_FALSE : VK_TRUE;
+		shadowAtlasImage.samplerInfo.compareOp = VK_COMPARE_OP_GREATER_OR_EQUAL; // reversed depth, lit where the receiver is not behind the occluder
+		shadowAtlasImage.Create(renderingDevice, shadowAtlas.size, shadowAtlas.size);
+		shadowMomentsImage.Create(renderingDevice, IsShadowFilterPrefiltered()? shadowAtlas.size : 1, IsShadowFilterPrefiltered()? shadowAtlas.size : 1);
+		shadowAtlasCacheImage.Create(renderingDevice, shadowAtlas.size, shadowAtlas.size);
+		shadowCacheImageReady = false;
+		shadowCubesImage.samplerInfo.compareEnable = VK_TRUE;
+		shadowCubesImage.samplerInfo.compareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+		shadowCubesImage.Create(renderingDevice, shadowCubeSize, shadowCubeSize);
+		shadowCascadesImage.samplerInfo.compareEnable = VK_TRUE;
+		shadowCascadesImage.samplerInfo.compareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+		shadowCascadesImage.Create(renderingDevice, shadowCascades.size, shadowCascades.size);
+		InvalidateShadowCaches();
+		skybox.samplerInfo.maxLod = skyboxMipLevels - 1;
 		skybox.Create(renderingDevice, skyboxSize, skyboxSize);
+		skyboxDirty = true;
+		gpuTimer.Create(renderingDevice, MAX_FRAMES_IN_FLIGHT);
 	}
 	
 	void DestroyResources() override {
@@ -132,24 +760,68 @@ private: // Resources
 		gBuffer_albedo.Destroy(renderingDevice);
 		gBuffer_normal.Destroy(renderingDevice);
 		gBuffer_position.Destroy(renderingDevice);
-		spotLightShadowMap.Destroy(renderingDevice);
+		shadowAtlasImage.Destroy(renderingDevice);
+		shadowAtlasCacheImage.Destroy(renderingDevice);
+		shadowMomentsImage.Destroy(renderingDevice);
+		shadowCubesImage.Destroy(renderingDevice);
+		shadowCascadesImage.Destroy(renderingDevice);
 		skybox.Destroy(renderingDevice);
+		gpuTimer.Destroy(renderingDevice);
 	}
 	
 	void AllocateBuffers() override {
 		cameraUBO.Allocate(renderingDevice);
 
-		for (auto& obj : sceneObjects) {
-			obj.AllocateBuffers(renderingDevice, transferQueue);
+		instanceStagingBuffer.size = sizeof(MeshInstance) * maxInstances * MAX_FRAMES_IN_FLIGHT;
+		instanceStagingBuffer.Allocate(renderingDevice, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false);
+		instanceStagingBuffer.MapMemory(renderingDevice);
+		instanceBuffer.Allocate(renderingDevice, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+
+		lightStagingBuffer.size = sizeof(LightSourceBufferData) * maxLights * MAX_FRAMES_IN_FLIGHT;
+		lightStagingBuffer.Allocate(renderingDevice, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false);
+		lightStagingBuffer.MapMemory(renderingDevice);
+		lightBuffer.Allocate(renderingDevice, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+		shadowMapStagingBuffer.size = sizeof(ShadowMapBufferData) * maxShadowMaps * MAX_FRAMES_IN_FLIGHT;
+		shadowMapStagingBuffer.Allocate(renderingDevice, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false);
+		shadowMapStagingBuffer.MapMemory(renderingDevice);
+		shadowMapBuffer.Allocate(renderingDevice, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+		clusterLightCountBuffer.size = sizeof(uint32_t) * GetClusterCount();
+		clusterLightCountBuffer.Allocate(renderingDevice, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+		clusterLightIndexBuffer.size = sizeof(uint32_t) * GetClusterCount() * maxLightsPerCluster;
+		clusterLightIndexBuffer.Allocate(renderingDevice, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+
+		for (auto& mesh : meshes) {
+			mesh->AllocateBuffers(renderingDevice, transferQueue);
 		}
+		lightVolumeSphere->AllocateBuffers(renderingDevice, transferQueue);
+		lightVolumeCone->AllocateBuffers(renderingDevice, transferQueue);
+
+		meshStreamer.Init(renderingDevice, transferQueue);
 	}
 	
 	void FreeBuffers() override {
         cameraUBO.Free(renderingDevice);
 
-		for (auto& obj : sceneObjects) {
-			obj.FreeBuffers(renderingDevice);
+		instanceStagingBuffer.UnmapMemory(renderingDevice);
+		instanceStagingBuffer.Free(renderingDevice);
+		instanceBuffer.Free(renderingDevice);
+
+		lightStagingBuffer.UnmapMemory(renderingDevice);
+		lightStagingBuffer.Free(renderingDevice);
+		lightBuffer.Free(renderingDevice);
+		shadowMapStagingBuffer.UnmapMemory(renderingDevice);
+		shadowMapStagingBuffer.Free(renderingDevice);
+		shadowMapBuffer.Free(renderingDevice);
+		clusterLightCountBuffer.Free(renderingDevice);
+		clusterLightIndexBuffer.Free(renderingDevice);
+
+		for (auto& mesh : meshes) {
+			mesh->FreeBuffers(renderingDevice);
 		}
+		lightVolumeSphere->FreeBuffers(renderingDevice);
+		lightVolumeCone->FreeBuffers(renderingDevice);
+
+		meshStreamer.Release();
 	}
 
 private: // Pipelines
@@ -157,6 +829,19 @@ private: // Pipelines
 	void CreatePipelines() override {
 		lightingLayout.Create(renderingDevice);
 		rasterizationLayout.Create(renderingDevice);
+		lightClusteringLayout.Create(renderingDevice);
+		clusteredLightingLayout.Create(renderingDevice);
+		shadowPrefilteringLayout.Create(renderingDevice);
+		skyboxPrefilteringLayout.Create(renderingDevice);
+
+		lightingConstants.values = {
+			(int32_t)shadowFilter,
+			(int32_t)std::clamp(shadowFilterTaps, 1u, 32u),
+			IsShadowFilterPrefiltered()? std::clamp(shadowFilterRadius, 0.0f, 8.0f) : std::max(shadowFilterRadius, 0.0f),
+			std::min(shadowExponent, 88.0f),
+			std::max(specularPower, 1.0f),
+			specularStrength,
+		};
 
 		const std::array<Image*, 3> gBuffers {
 			&gBuffer_albedo,
@@ -197,7 +882,7 @@ private: // Pipelines
 					attachments[attachmentsIndex].format = image->format;
 					attachments[attachmentsIndex].samples = VK_SAMPLE_COUNT_1_BIT;
 					attachments[attachmentsIndex].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-					attachments[attachmentsIndex].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+					attachments[attachmentsIndex].storeOp = VK_ATTACHMENT_STORE_OP_STORE; // depth tested by light volumes
 					attachments[attachmentsIndex].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 					attachments[attachmentsIndex].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 					attachments[attachmentsIndex].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -220,24 +905,44 @@ private: // Pipelines
 			
 			// Create the render pass
 			rasterizationPass.Create(renderingDevice);
-			rasterizationPass.CreateFrameBuffers(renderingDevice, images.data(), images.size());
 			
 			// Shader
 			primitivesShader.SetRenderPass(&gBuffer_albedo, rasterizationPass.handle, 0);
 			for (size_t i = 0; i < gBuffers.size(); ++i)
 				primitivesShader.AddColorBlendAttachmentState(VK_FALSE);
-			primitivesShader.CreatePipeline(renderingDevice);
+			pipelineScheduler.Add(&primitivesShader, "primitives");
 		}
 		
-		{// Shadow pass
+		{// Shadow passes, both load the atlas since only some of its tiles are rendered
+			// Static casters are rendered into the cached atlas, which stays ready to be copied from
+			VkAttachmentDescription cacheAttachment {};
+			cacheAttachment.format = shadowAtlasCacheImage.format;
+			cacheAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			cacheAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			cacheAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			cacheAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			cacheAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			cacheAttachment.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			cacheAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			VkAttachmentReference cacheAttachmentRef {
+				shadowCachePass.AddAttachment(cacheAttachment),
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+			};
+			VkSubpassDescription cacheSubpass = {};
+				cacheSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+				cacheSubpass.pDepthStencilAttachment = &cacheAttachmentRef;
+			shadowCachePass.AddSubpass(cacheSubpass);
+			shadowCachePass.Create(renderingDevice);
+
+			// Dynamic casters are rendered on top of the cached tiles copied to the atlas
 			VkAttachmentDescription depthAttachment {};
-			depthAttachment.format = spotLightShadowMap.format;
+			depthAttachment.format = shadowAtlasImage.format;
 			depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-			depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 			depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 			depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 			depthAttachment.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
 
 			VkAttachmentReference depthAttachmentRef {
@@ -253,11 +958,37 @@ private: // Pipelines
 			
 			// Create the render pass
 			shadowPass.Create(renderingDevice);
-			shadowPass.CreateFrameBuffers(renderingDevice, spotLightShadowMap);
 			
-			// Shader
-			shadowMapShader.SetRenderPass(&spotLightShadowMap, shadowPass.handle, 0);
-			shadowMapShader.CreatePipeline(renderingDevice);
+			// Shader, the two passes are compatible so it is used in both
+			shadowMapShader.SetRenderPass(&shadowAtlasImage, shadowPass.handle, 0);
+			pipelineScheduler.Add(&shadowMapShader, "shadowMap");
+		}
+
+		// Shadow cubes and cascades passes, one layered framebuffer with all the cubes' faces, and one with all the cascades
+		for (auto [pass, image, shader, name] : {
+			std::tuple<RenderPass*, Image*, RasterShaderPipeline*, const char*>{&shadowCubePass, &shadowCubesImage, &shadowCubeShader, "shadowCube"},
+			std::tuple<RenderPass*, Image*, RasterShaderPipeline*, const char*>{&shadowCascadePass, &shadowCascadesImage, &shadowCascadeShader, "shadowCascade"},
+		}) {
+			VkAttachmentDescription depthAttachment {};
+			depthAttachment.format = image->format;
+			depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthAttachment.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+			VkAttachmentReference depthAttachmentRef {
+				pass->AddAttachment(depthAttachment),
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+			};
+			VkSubpassDescription subpass = {};
+				subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+				subpass.pDepthStencilAttachment = &depthAttachmentRef;
+			pass->AddSubpass(subpass);
+			pass->Create(renderingDevice);
+			shader->SetRenderPass(image, pass->handle, 0);
+			pipelineScheduler.Add(shader, name);
 		}
 		
 		{// Skybox pass
@@ -266,7 +997,7 @@ private: // Pipelines
 			colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			colorAttachment.initialLayout = VK_IMAGE_LAYOUT_GENERAL; // all mip levels are transitioned before the pass
 			colorAttachment.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
 
 			VkAttachmentReference colorAttachmentRef {
@@ -283,26 +1014,19 @@ private: // Pipelines
 			
 			// Create the render pass
 			skyboxPass.Create(renderingDevice);
-			skyboxPass.CreateFrameBuffers(renderingDevice, skybox);
 			
 			// Shader
 			skyboxShader.SetRenderPass(&skybox, skyboxPass.handle, 0);
 			skyboxShader.AddColorBlendAttachmentState(VK_FALSE);
-			skyboxShader.CreatePipeline(renderingDevice);
+			pipelineScheduler.Add(&skyboxShader, "skybox");
 		}
 		
 		{// Lighting pass
 
-			std::array<VkImageView, gBuffers.size() + 1> imageViews {
-				gBuffer_albedo.view,
-				gBuffer_normal.view,
-				gBuffer_position.view,
-				VK_NULL_HANDLE, // VK_NULL_HANDLE = the swapchain
-			};
-
 			std::array<VkAttachmentReference, 1> colorAttachmentRefs {};
 			std::array<VkAttachmentReference, gBuffers.size()> inputAttachmentRefs {};
-			std::array<VkAttachmentDescription, colorAttachmentRefs.size() + inputAttachmentRefs.size()> attachments {};
+			VkAttachmentReference depthStencilAttachmentRef {};
+			std::array<VkAttachmentDescription, colorAttachmentRefs.size() + inputAttachmentRefs.size() + 1> attachments {};
 
 			int attachmentsIndex = 0;
 			int colorAttachmentsIndex = 0;
@@ -336,6 +1060,21 @@ private: // Pipelines
 			};
 			attachmentsIndex++;
 
+			// Add the scene's depth as a read-only depth attachment, light volumes are tested against it
+			attachments[attachmentsIndex].format = depthStencilImage.format;
+			attachments[attachmentsIndex].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachments[attachmentsIndex].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			attachments[attachmentsIndex].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachments[attachmentsIndex].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			attachments[attachmentsIndex].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachments[attachmentsIndex].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			attachments[attachmentsIndex].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthStencilAttachmentRef = {
+				lightingPass.AddAttachment(attachments[attachmentsIndex]),
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+			};
+			attachmentsIndex++;
+
 			// SubPass
 			VkSubpassDescription subpass {};
 				subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
@@ -343,11 +1082,11 @@ private: // Pipelines
 				subpass.pColorAttachments = colorAttachmentRefs.data();
 				subpass.inputAttachmentCount = inputAttachmentRefs.size();
 				subpass.pInputAttachments = inputAttachmentRefs.data();
+				subpass.pDepthStencilAttachment = &depthStencilAttachmentRef;
 			lightingPass.AddSubpass(subpass);
 			
 			// Create the render pass
 			lightingPass.Create(renderingDevice);
-			lightingPass.CreateFrameBuffers(renderingDevice, swapChain, imageViews.data(), imageViews.size());
 			
 			// Shader
 			lightingShader.SetRenderPass(swapChain, lightingPass.handle, 0);
@@ -360,103 +1099,600 @@ private: // Pipelines
 				VK_BLEND_FACTOR_ONE,
 				VK_BLEND_OP_MAX
 			);
-			lightingShader.CreatePipeline(renderingDevice);
+			for (int32_t type = 0; type < (int32_t)lightingPermutations.size(); ++type) {
+				lightTypeConstants.values.lightType = type;
+				lightingPermutations[type] = lightingShader.AddPermutation(*lightTypeConstants.GetInfo());
+			}
+			pipelineScheduler.Add(&lightingShader, "lighting", true);
+
+			clusteredLightingShader.SetRenderPass(swapChain, lightingPass.handle, 0);
+			clusteredLightingShader.AddColorBlendAttachmentState(
+				VK_TRUE,
+				VK_BLEND_FACTOR_ONE,
+				VK_BLEND_FACTOR_ONE,
+				VK_BLEND_OP_ADD,
+				VK_BLEND_FACTOR_ONE,
+				VK_BLEND_FACTOR_ONE,
+				VK_BLEND_OP_MAX
+			);
+			pipelineScheduler.Add(&clusteredLightingShader, "clusteredLighting");
+
+			lightVolumeShader.SetRenderPass(swapChain, lightingPass.handle, 0);
+			// The depth bounds reject the pixels that are too far in front of or behind the light to be reached by it
+			lightVolumeShader.depthStencilState.depthBoundsTestEnable = deviceFeatures.depthBounds;
+			lightVolumeShader.dynamicStates = deviceFeatures.depthBounds? std::vector<VkDynamicState>{VK_DYNAMIC_STATE_DEPTH_BOUNDS} : std::vector<VkDynamicState>{};
+			lightVolumeShader.AddColorBlendAttachmentState(
+				VK_TRUE,
+				VK_BLEND_FACTOR_ONE,
+				VK_BLEND_FACTOR_ONE,
+				VK_BLEND_OP_ADD,
+				VK_BLEND_FACTOR_ONE,
+				VK_BLEND_FACTOR_ONE,
+				VK_BLEND_OP_MAX
+			);
+			for (int32_t type = 0; type < (int32_t)lightVolumePermutations.size(); ++type) {
+				lightTypeConstants.values.lightType = type;
+				lightVolumePermutations[type] = lightVolumeShader.AddPermutation(*lightTypeConstants.GetInfo());
+			}
+			pipelineScheduler.Add(&lightVolumeShader, "lightVolume", true);
 		}
+
+		// Light clustering, group counts are set with the frame buffers
+		pipelineScheduler.Add(&lightClusteringShader, "lightClustering");
+
+		// Shadow prefiltering, group counts are set per frame
+		pipelineScheduler.Add(&shadowPrefilteringShader, "shadowPrefiltering");
+
+		// Skybox prefiltering, group counts are set per mip level
+		pipelineScheduler.Add(&skyboxPrefilteringShader, "skyboxPrefiltering");
 		
+		// All of the above at once, the per light type permutations of the lighting are only needed once they are ready
+		pipelineScheduler.Build(renderingDevice, threadPool);
 	}
 	
 	void DestroyPipelines() override {
 		// shader pipelines
 		primitivesShader.DestroyPipeline(renderingDevice);
 		shadowMapShader.DestroyPipeline(renderingDevice);
+		shadowCubeShader.DestroyPipeline(renderingDevice);
+		shadowCascadeShader.DestroyPipeline(renderingDevice);
 		skyboxShader.DestroyPipeline(renderingDevice);
 		lightingShader.DestroyPipeline(renderingDevice);
-
-		// frame buffers
-		rasterizationPass.DestroyFrameBuffers(renderingDevice);
-		shadowPass.DestroyFrameBuffers(renderingDevice);
-		skyboxPass.DestroyFrameBuffers(renderingDevice);
-		lightingPass.DestroyFrameBuffers(renderingDevice);
+		clusteredLightingShader.DestroyPipeline(renderingDevice);
+		lightVolumeShader.DestroyPipeline(renderingDevice);
+		lightClusteringShader.DestroyPipeline(renderingDevice);
+		shadowPrefilteringShader.DestroyPipeline(renderingDevice);
+		skyboxPrefilteringShader.DestroyPipeline(renderingDevice);
 
 		// render passes
 		rasterizationPass.Destroy(renderingDevice);
+		shadowCachePass.Destroy(renderingDevice);
 		shadowPass.Destroy(renderingDevice);
+		shadowCubePass.Destroy(renderingDevice);
+		shadowCascadePass.Destroy(renderingDevice);
 		skyboxPass.Destroy(renderingDevice);
 		lightingPass.Destroy(renderingDevice);
 
 		// layouts
 		lightingLayout.Destroy(renderingDevice);
 		rasterizationLayout.Destroy(renderingDevice);
+		lightClusteringLayout.Destroy(renderingDevice);
+		clusteredLightingLayout.Destroy(renderingDevice);
+		shadowPrefilteringLayout.Destroy(renderingDevice);
+		skyboxPrefilteringLayout.Destroy(renderingDevice);
+	}
+
+	// The render passes and pipelines above do not depend on the size of the swap chain, what does is recreated with it here
+	void CreateFrameBuffers() override {
+		std::array<Image*, 4> rasterizationImages {
+			&gBuffer_albedo,
+			&gBuffer_normal,
+			&gBuffer_position,
+			&depthStencilImage,
+		};
+		rasterizationPass.CreateFrameBuffers(renderingDevice, rasterizationImages.data(), rasterizationImages.size());
+		shadowCachePass.CreateFrameBuffers(renderingDevice, shadowAtlasCacheImage);
+		shadowPass.CreateFrameBuffers(renderingDevice, shadowAtlasImage);
+		shadowCubePass.CreateFrameBuffers(renderingDevice, shadowCubesImage);
+		shadowCascadePass.CreateFrameBuffers(renderingDevice, shadowCascadesImage);
+		skyboxPass.CreateFrameBuffers(renderingDevice, {skybox.width, skybox.height}, &skybox.mipViews[0], 1, 6); // only the first mip level is rendered
+
+		std::array<VkImageView, 5> lightingImageViews {
+			gBuffer_albedo.view,
+			gBuffer_normal.view,
+			gBuffer_position.view,
+			VK_NULL_HANDLE, // VK_NULL_HANDLE = the swapchain
+			depthStencilImage.view,
+		};
+		lightingPass.CreateFrameBuffers(renderingDevice, swapChain, lightingImageViews.data(), lightingImageViews.size());
+
+		// Light clustering, one work group per tile and depth slice
+		uint32_t tilesX, tilesY;
+		GetClusterCount(&tilesX, &tilesY);
+		lightClusteringShader.SetGroupCounts(tilesX, tilesY, clusterDepthSlices);
+	}
+
+	void DestroyFrameBuffers() override {
+		rasterizationPass.DestroyFrameBuffers(renderingDevice);
+		shadowCachePass.DestroyFrameBuffers(renderingDevice);
+		shadowPass.DestroyFrameBuffers(renderingDevice);
+		shadowCubePass.DestroyFrameBuffers(renderingDevice);
+		shadowCascadePass.DestroyFrameBuffers(renderingDevice);
+		skyboxPass.DestroyFrameBuffers(renderingDevice);
+		lightingPass.DestroyFrameBuffers(renderingDevice);
 	}
 	
 private: // Commands
 
 	void RecordGraphicsCommandBuffer(VkCommandBuffer, int) override {}
 	
-    void RunDynamicGraphics(VkCommandBuffer commandBuffer, int imageIndex) override {
-		cameraUBO.Update(renderingDevice, commandBuffer);
+	void UpdateInstanceBuffer(VkCommandBuffer commandBuffer) {
+		VkDeviceSize stagingOffset = sizeof(MeshInstance) * maxInstances * currentFrameInFlight;
+		auto* instances = (MeshInstance*)((std::byte*)instanceStagingBuffer.data + stagingOffset);
+		uint32_t instanceCount = objectInstances.Write(instances, 0, maxInstances);
+		for (size_t i = 0; i < shadowMapDraws.size(); ++i) {
+			instanceCount += shadowInstances[i].Write(instances + instanceCount, instanceCount, maxInstances - instanceCount);
+			instanceCount += staticShadowInstances[i].Write(instances + instanceCount, instanceCount, maxInstances - instanceCount);
+		}
+		if (shadowCubeCount > 0) {
+			instanceCount += shadowCubeInstances.Write(instances + instanceCount, instanceCount, maxInstances - instanceCount);
+		}
+		if (shadowCascadeCount > 0) {
+			instanceCount += shadowCascadeInstances.Write(instances + instanceCount, instanceCount, maxInstances - instanceCount);
+		}
+		if (instanceCount == 0) return;
 
-		// Render primitives
-		rasterizationPass.Begin(renderingDevice, commandBuffer, gBuffer_albedo, clearValues);
-		for (auto& obj : sceneObjects) {
-			primitivesShader.SetData(&obj.vertexBuffer.deviceLocalBuffer, &obj.indexBuffer.deviceLocalBuffer, obj.indices.size());
-			primitivesShader.Execute(renderingDevice, commandBuffer, 1, &obj.mvp);
+		VkBufferMemoryBarrier barrier {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = instanceBuffer.buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		// The previous frame may still be reading instances
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		renderingDevice->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		Buffer::Copy(renderingDevice, commandBuffer, instanceStagingBuffer.buffer, instanceBuffer.buffer, sizeof(MeshInstance) * instanceCount, stagingOffset, 0);
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		renderingDevice->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	void UpdateLightBuffer(VkCommandBuffer commandBuffer) {
+		uint32_t lightCount = std::min((uint32_t)frameLights.size(), maxLights);
+		if (lightCount == 0) return;
+		uint32_t shadowMapCount = std::min((uint32_t)frameShadowMaps.size(), maxShadowMaps);
+		VkDeviceSize lightStagingOffset = sizeof(LightSourceBufferData) * maxLights * currentFrameInFlight;
+		VkDeviceSize shadowMapStagingOffset = sizeof(ShadowMapBufferData) * maxShadowMaps * currentFrameInFlight;
+		memcpy((std::byte*)lightStagingBuffer.data + lightStagingOffset, frameLights.data(), sizeof(LightSourceBufferData) * lightCount);
+		memcpy((std::byte*)shadowMapStagingBuffer.data + shadowMapStagingOffset, frameShadowMaps.data(), sizeof(ShadowMapBufferData) * shadowMapCount);
+
+		std::array<VkBufferMemoryBarrier, 2> barriers {};
+		for (auto& barrier : barriers) {
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
 		}
-		rasterizationPass.End(renderingDevice, commandBuffer);
+		barriers[0].buffer = lightBuffer.buffer;
+		barriers[1].buffer = shadowMapBuffer.buffer;
 
-		// Shadow map
-		for (auto& lightSource : lightSources) {
-			if (lightSource.type == SPOT_LIGHT) {
-				shadowPass.Begin(renderingDevice, commandBuffer, spotLightShadowMap, clearValues);
-				for (auto& obj : sceneObjects) {
-					PrimitiveGeometry::MVP mvp {
-						// Make a new projection matrix and modelView matrix based on that spot light
-						lightSource.MakeLightProjectionMatrix(),
-						lightSource.MakeLightViewMatrix(camera) * glm::translate(glm::mat4(1), obj.position)
-					};
-					shadowMapShader.SetData(&obj.vertexBuffer.deviceLocalBuffer, &obj.indexBuffer.deviceLocalBuffer, obj.indices.size());
-					shadowMapShader.Execute(renderingDevice, commandBuffer, 1, &mvp);
+		// The previous frame may still be reading lights
+		for (auto& barrier : barriers) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		}
+		renderingDevice->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+
+		Buffer::Copy(renderingDevice, commandBuffer, lightStagingBuffer.buffer, lightBuffer.buffer, sizeof(LightSourceBufferData) * lightCount, lightStagingOffset, 0);
+		if (shadowMapCount > 0) {
+			Buffer::Copy(renderingDevice, commandBuffer, shadowMapStagingBuffer.buffer, shadowMapBuffer.buffer, sizeof(ShadowMapBufferData) * shadowMapCount, shadowMapStagingOffset, 0);
+		}
+
+		for (auto& barrier : barriers) {
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+		renderingDevice->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+	}
+
+	uint32_t AddShadowMapViewport(const ShadowAtlas::Tile& tile) {
+		VkViewport viewport {(float)tile.x, (float)tile.y, (float)tile.size, (float)tile.size, 0, 1};
+		VkRect2D scissor {{(int32_t)tile.x, (int32_t)tile.y}, {tile.size, tile.size}};
+		return renderQueue.AddViewport(viewport, scissor);
+	}
+
+	void ShadowAtlasBarrier(VkCommandBuffer commandBuffer, Image& image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask) {
+		VkImageMemoryBarrier barrier {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image.image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (image.format == VK_FORMAT_D32_SFLOAT_S8_UINT) barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = image.arrayLayers;
+		barrier.srcAccessMask = srcAccessMask;
+		barrier.dstAccessMask = dstAccessMask;
+		renderingDevice->CmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void RenderShadowMaps(CommandRecorder& commandBuffer) {
+		const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		const VkAccessFlags depthAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// Static casters, only in the tiles whose cache is out of date
+		if (shadowCacheStats.staticUpdates > 0) {
+			// The previous frame may still be copying from the cache
+			ShadowAtlasBarrier(commandBuffer, shadowAtlasCacheImage, shadowCacheImageReady? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, depthAccess, VK_PIPELINE_STAGE_TRANSFER_BIT, depthStages);
+			shadowCacheImageReady = true;
+			shadowCachePass.Begin(commandBuffer, shadowAtlasCacheImage, clearValues);
+			// Clears all the tiles to update before their draws, which are sorted across tiles
+			std::vector<VkClearRect> clearRects;
+			for (auto& draw : shadowMapDraws) if (draw.updateStatic) {
+				clearRects.push_back({{{(int32_t)draw.tile.x, (int32_t)draw.tile.y}, {draw.tile.size, draw.tile.size}}, 0, 1});
+			}
+			VkClearAttachment clear {VK_IMAGE_ASPECT_DEPTH_BIT, 0, clearValues[0]};
+			renderingDevice->CmdClearAttachments(commandBuffer, 1, &clear, clearRects.size(), clearRects.data());
+			renderQueue.Submit(commandBuffer, SHADOW_CACHE_DRAW_PASS);
+			shadowCachePass.End(commandBuffer);
+		}
+
+		// Copy the cached tiles to the atlas, the previous frame may still be sampling it
+		ShadowAtlasBarrier(commandBuffer, shadowAtlasCacheImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, depthStages, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		ShadowAtlasBarrier(commandBuffer, shadowAtlasImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		std::vector<VkImageCopy> regions;
+		regions.reserve(shadowMapDraws.size());
+		for (auto& draw : shadowMapDraws) {
+			VkImageCopy region {};
+			region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1};
+			region.srcOffset = {(int32_t)draw.tile.x, (int32_t)draw.tile.y, 0};
+			region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1};
+			region.dstOffset = region.srcOffset;
+			region.extent = {draw.tile.size, draw.tile.size, 1};
+			regions.push_back(region);
+		}
+		renderingDevice->CmdCopyImage(commandBuffer, shadowAtlasCacheImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, shadowAtlasImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
+		ShadowAtlasBarrier(commandBuffer, shadowAtlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, depthAccess, VK_PIPELINE_STAGE_TRANSFER_BIT, depthStages);
+
+		// Dynamic casters on top, all in one pass with one viewport per tile
+		shadowPass.Begin(commandBuffer, shadowAtlasImage, clearValues);
+		renderQueue.Submit(commandBuffer, SHADOW_ATLAS_DRAW_PASS);
+		shadowPass.End(commandBuffer);
+
+		// Sampled by the lighting, or read by the prefiltering
+		ShadowAtlasBarrier(commandBuffer, shadowAtlasImage, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, depthStages, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
+
+	// All the layers of a layered shadow image in one pass (shadow cubes or cascades), their previous content is discarded
+	void RenderLayeredShadows(CommandRecorder& commandBuffer, RenderPass& pass, Image& image, DrawPass drawPass) {
+		const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		// The previous frame may still be sampling them
+		ShadowAtlasBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 0, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, depthStages);
+		pass.Begin(commandBuffer, image, clearValues);
+		renderQueue.Submit(commandBuffer, drawPass);
+		pass.End(commandBuffer);
+		ShadowAtlasBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, depthStages, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+
+	// Blurred moments of each shadow map's tile, the previous content of the moments image is discarded
+	void PrefilterShadowMaps(CommandRecorder& commandBuffer) {
+		VkImageMemoryBarrier barrier {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = shadowMomentsImage.image;
+		barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+		// The previous frame may still be sampling it
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		renderingDevice->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		// One group per block of 16x16 texels of the largest tile, smaller tiles skip the blocks they don't have
+		uint32_t largestTileSize = 0;
+		for (auto& draw : shadowMapDraws) largestTileSize = std::max(largestTileSize, draw.tile.size);
+		shadowPrefilteringShader.SetGroupCounts((largestTileSize + 15) / 16, (largestTileSize + 15) / 16, shadowMapDraws.size());
+		shadowPrefilteringShader.Execute(commandBuffer);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		renderingDevice->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void SkyboxBarrier(VkCommandBuffer commandBuffer, uint32_t baseMipLevel, uint32_t mipLevelCount, VkImageLayout oldLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask) {
+		VkImageMemoryBarrier barrier {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = skybox.image;
+		barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseMipLevel, mipLevelCount, 0, 6};
+		barrier.srcAccessMask = srcAccessMask;
+		barrier.dstAccessMask = dstAccessMask;
+		renderingDevice->CmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	// Renders the first mip level, then prefilters each following level from the previous one
+	void GenerateSkybox(CommandRecorder& commandBuffer) {
+		// Previous frames may still be sampling it, its previous content is discarded
+		SkyboxBarrier(commandBuffer, 0, skybox.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		skyboxPass.Begin(commandBuffer, skybox, clearValues);
+		skyboxShader.Execute(commandBuffer);
+		skyboxPass.End(commandBuffer);
+		SkyboxBarrier(commandBuffer, 0, 1, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		for (uint32_t mip = 1; mip < skybox.mipLevels; ++mip) {
+			uint32_t size = std::max(skybox.width >> mip, 1u);
+			SkyboxMipPushConstant pushConstant {mip};
+			skyboxPrefilteringShader.SetGroupCounts((size + 7) / 8, (size + 7) / 8, 6);
+			skyboxPrefilteringShader.Execute(commandBuffer, 1, &pushConstant);
+			SkyboxBarrier(commandBuffer, mip, 1, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		}
+
+		// Sampled by the lighting
+		SkyboxBarrier(commandBuffer, 0, skybox.mipLevels, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+
+	// Rectangle on screen that contains a light's sphere (in camera space), false if it is behind the camera or off screen.
+	// The sphere's bounding box is projected at its nearest and farthest depths, the nearest one clamped to the near plane.
+	bool MakeLightScissor(const vec3& viewPosition, float radius, VkRect2D& scissor) const {
+		double farDepth = -viewPosition.z + radius;
+		if (farDepth <= camera.znear) return false;
+		double nearDepth = glm::max(-viewPosition.z - radius, camera.znear);
+		dvec2 scale {camera.projectionMatrix[0][0], camera.projectionMatrix[1][1]};
+		dvec2 ndcMin {1}, ndcMax {-1};
+		for (double depth : {nearDepth, farDepth}) {
+			for (double side : {-1.0, 1.0}) {
+				dvec2 ndc = scale * (dvec2(viewPosition) + side * double(radius)) / depth;
+				ndcMin = glm::min(ndcMin, ndc);
+				ndcMax = glm::max(ndcMax, ndc);
+			}
+		}
+		ndcMin = glm::max(ndcMin, dvec2(-1));
+		ndcMax = glm::min(ndcMax, dvec2(1));
+		if (ndcMin.x >= ndcMax.x || ndcMin.y >= ndcMax.y) return false;
+		dvec2 extent {swapChain->extent.width, swapChain->extent.height};
+		ivec2 offset = ivec2(glm::floor((ndcMin * 0.5 + 0.5) * extent));
+		ivec2 end = ivec2(glm::ceil((ndcMax * 0.5 + 0.5) * extent));
+		scissor = {{offset.x, offset.y}, {uint32_t(end.x - offset.x), uint32_t(end.y - offset.y)}};
+		return scissor.extent.width > 0 && scissor.extent.height > 0;
+	}
+
+	void RunLightClustering(CommandRecorder& commandBuffer) {
+		std::array<VkBufferMemoryBarrier, 2> barriers {};
+		for (auto& barrier : barriers) {
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+		}
+		barriers[0].buffer = clusterLightCountBuffer.buffer;
+		barriers[1].buffer = clusterLightIndexBuffer.buffer;
+
+		// The previous frame may still be reading clusters
+		for (auto& barrier : barriers) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		renderingDevice->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+
+		auto grid = MakeClusterGrid();
+		lightClusteringShader.Execute(commandBuffer, 1, &grid);
+
+		for (auto& barrier : barriers) {
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+		renderingDevice->CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+	}
+
+	// Queues one draw per batch, G-buffer batches are sorted front to back by their nearest instance
+	void QueueInstances(DrawPass pass, RasterShaderPipeline& shader, const MeshInstanceList& instanceList, uint32_t pushConstant, uint32_t viewport = RenderQueue::NONE) {
+		for (auto& batch : instanceList.batches) if (batch.instanceCount > 0) {
+			float depth = 0;
+			if (pass == GBUFFER_DRAW_PASS) {
+				depth = std::numeric_limits<float>::max();
+				for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; ++i) {
+					depth = std::min(depth, glm::length(glm::vec3(instanceList.instances[i].modelViewMatrix[3])));
 				}
-				shadowPass.End(renderingDevice, commandBuffer);
-				break; // We only support one shadow map for now, for one spot light
+			}
+			auto& lod = batch.mesh->lods[batch.lod];
+			renderQueue.Add(pass, depth, {
+				&shader,
+				pushConstant,
+				viewport,
+				batch.mesh->vertexBuffer.deviceLocalBuffer.buffer,
+				instanceBuffer.buffer,
+				batch.mesh->indexBuffer.deviceLocalBuffer.buffer,
+				lod.firstIndex,
+				lod.indexCount,
+				instanceList.baseInstance + batch.firstInstance,
+				batch.instanceCount,
+			});
+		}
+	}
+
+	// Queues the mesh draws of every pass that this frame records, then sorts them all at once
+	void QueueDraws() {
+		renderQueue.Clear();
+		QueueInstances(GBUFFER_DRAW_PASS, primitivesShader, objectInstances, renderQueue.AddPushConstant(MeshInstancePushConstant{glm::mat4(camera.projectionMatrix)}));
+		for (size_t i = 0; i < shadowMapDraws.size(); ++i) {
+			uint32_t lightPushConstant = renderQueue.AddPushConstant(MeshInstancePushConstant{shadowMapDraws[i].projectionMatrix});
+			uint32_t viewport = AddShadowMapViewport(shadowMapDraws[i].tile);
+			if (shadowMapDraws[i].updateStatic) QueueInstances(SHADOW_CACHE_DRAW_PASS, shadowMapShader, staticShadowInstances[i], lightPushConstant, viewport);
+			QueueInstances(SHADOW_ATLAS_DRAW_PASS, shadowMapShader, shadowInstances[i], lightPushConstant, viewport);
+		}
+		// Each instance of the layered passes has its own layer's projection
+		uint32_t identityPushConstant = renderQueue.AddPushConstant(MeshInstancePushConstant{});
+		if (shadowCubeCount > 0) QueueInstances(SHADOW_CUBES_DRAW_PASS, shadowCubeShader, shadowCubeInstances, identityPushConstant);
+		if (shadowCascadeCount > 0) QueueInstances(SHADOW_CASCADES_DRAW_PASS, shadowCascadeShader, shadowCascadeInstances, identityPushConstant);
+		renderQueue.Sort();
+	}
+	
+    void RunDynamicGraphics(VkCommandBuffer vkCommandBuffer, int imageIndex) override {
+		// All the binds of the frame go through it, so that those of the state already bound are skipped
+		CommandRecorder commandBuffer(renderingDevice, vkCommandBuffer);
+		gpuTimer.BeginFrame(renderingDevice, commandBuffer, currentFrameInFlight);
+		QueueDraws();
+		cameraUBO.Update(renderingDevice, commandBuffer);
+		UpdateInstanceBuffer(commandBuffer);
+		UpdateLightBuffer(commandBuffer);
+
+		// Render primitives
+		rasterizationPass.Begin(commandBuffer, gBuffer_albedo, clearValues);
+		renderQueue.Submit(commandBuffer, GBUFFER_DRAW_PASS);
+		rasterizationPass.End(commandBuffer);
+
+		// Shadow maps
+		if (!shadowMapDraws.empty() || shadowCubeCount > 0 || shadowCascadeCount > 0) {
+			gpuTimer.Start(renderingDevice, commandBuffer, "shadows");
+			if (!shadowMapDraws.empty()) RenderShadowMaps(commandBuffer);
+			if (shadowCubeCount > 0) RenderLayeredShadows(commandBuffer, shadowCubePass, shadowCubesImage, SHADOW_CUBES_DRAW_PASS);
+			if (shadowCascadeCount > 0) RenderLayeredShadows(commandBuffer, shadowCascadePass, shadowCascadesImage, SHADOW_CASCADES_DRAW_PASS);
+			gpuTimer.Stop(renderingDevice, commandBuffer, "shadows");
+			if (IsShadowFilterPrefiltered() && !shadowMapDraws.empty()) {
+				gpuTimer.Start(renderingDevice, commandBuffer, "shadow prefiltering");
+				PrefilterShadowMaps(commandBuffer);
+				gpuTimer.Stop(renderingDevice, commandBuffer, "shadow prefiltering");
 			}
 		}
 
 		// Generate Skybox
-		skyboxPass.Begin(renderingDevice, commandBuffer, skybox, clearValues);
-		skyboxShader.Execute(renderingDevice, commandBuffer);
-		skyboxPass.End(renderingDevice, commandBuffer);
+		if (skyboxDirty) {
+			gpuTimer.Start(renderingDevice, commandBuffer, "skybox");
+			GenerateSkybox(commandBuffer);
+			gpuTimer.Stop(renderingDevice, commandBuffer, "skybox");
+			skyboxDirty = false;
+		}
 
 		// Lighting
-		lightingPass.Begin(renderingDevice, commandBuffer, swapChain, clearValues, imageIndex);
-		for (auto& lightSource : lightSources) {
-			auto pushConstant = lightSource.MakePushConstantFromCamera(camera);
-			lightingShader.Execute(renderingDevice, commandBuffer, 1, &pushConstant);
+		gpuTimer.Start(renderingDevice, commandBuffer, "lighting");
+		if (clusteredLightCount > 0) {
+			RunLightClustering(commandBuffer);
+		}
+		lightingPass.Begin(commandBuffer, swapChain, clearValues, imageIndex);
+		for (auto& lightBatch : lightBatches) {
+			commandBuffer.SetScissor(lightBatch.scissor);
+			lightingShader.SetPermutation(lightBatch.permutation);
+			lightingShader.Execute(commandBuffer, 1, &lightBatch.batch);
+		}
+		if (!lightBatches.empty()) {
+			// Back to the whole screen for the volumes and the clustered lights
+			VkRect2D screenRect {{0, 0}, swapChain->extent};
+			commandBuffer.SetScissor(screenRect);
 		}
-		lightingPass.End(renderingDevice, commandBuffer);
+		if (deviceFeatures.depthBounds) {
+			// One draw per light, to set its depth bounds
+			for (auto& lightVolume : lightVolumes) {
+				lightVolumeShader.SetData(&lightVolume.volume->vertexBuffer.deviceLocalBuffer, &lightVolume.volume->indexBuffer.deviceLocalBuffer);
+				lightVolumeShader.SetInstanceData(nullptr, lightVolume.light);
+				lightVolumeShader.SetPermutation(lightVolume.permutation);
+				renderingDevice->CmdSetDepthBounds(commandBuffer, lightVolume.minDepth, lightVolume.maxDepth);
+				lightVolumeShader.Execute(commandBuffer);
+			}
+		} else {
+			// One instanced draw per volume mesh and light type, lights using the same mesh are contiguous unless some were skipped
+			for (size_t i = 0; i < lightVolumes.size();) {
+				uint32_t count = 1;
+				while (i + count < lightVolumes.size() && lightVolumes[i + count].volume == lightVolumes[i].volume && lightVolumes[i + count].permutation == lightVolumes[i].permutation && lightVolumes[i + count].light == lightVolumes[i].light + count) count++;
+				lightVolumeShader.SetData(&lightVolumes[i].volume->vertexBuffer.deviceLocalBuffer, &lightVolumes[i].volume->indexBuffer.deviceLocalBuffer);
+				lightVolumeShader.SetInstanceData(nullptr, lightVolumes[i].light);
+				lightVolumeShader.SetPermutation(lightVolumes[i].permutation);
+				lightVolumeShader.Execute(commandBuffer, count, nullptr);
+				i += count;
+			}
+		}
+		if (clusteredLightCount > 0) {
+			auto grid = MakeClusterGrid();
+			clusteredLightingShader.Execute(commandBuffer, 1, &grid);
+		}
+		lightingPass.End(commandBuffer);
+		gpuTimer.Stop(renderingDevice, commandBuffer, "lighting");
+		commandStats = commandBuffer.GetStats();
 	}
 	
 public: // Scene configuration
 	
 	void ReadShaders() override {
-		primitivesShader.ReadShaders();
-		shadowMapShader.ReadShaders();
-		skyboxShader.ReadShaders();
-		lightingShader.ReadShaders();
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::string> files;
+		for (auto* pipeline : GetShaderPipelines()) {
+			for (auto& file : pipeline->GetShaderFiles()) {
+				if (std::find(files.begin(), files.end(), file) == files.end()) files.push_back(file);
+			}
+		}
+		// Shaders that are not in the cache are all compiled at once, in parallel, otherwise they are all mapped from one archive
+		if (shaderCompiler) {
+			shaderCompiler->CompileAll(files, threadPool);
+		} else {
+			OpenShaderArchive(files);
+		}
+		auto prepared = std::chrono::high_resolution_clock::now();
+		primitivesShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		shadowMapShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		shadowCubeShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		shadowCascadeShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		skyboxShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		lightingShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		lightClusteringShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		clusteredLightingShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		lightVolumeShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		shadowPrefilteringShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		skyboxPrefilteringShader.ReadShaders(shaderCompiler.get(), shaderArchive);
+		auto end = std::chrono::high_resolution_clock::now();
+		auto milliseconds = [](auto from, auto to){return std::chrono::duration<double, std::milli>(to - from).count();};
+		LOG("Shaders : " << files.size() << " files read in " << milliseconds(start, end) << " ms, "
+			<< (shaderCompiler? "compiling " : shaderArchive? "mapping the archive " : "no archive ") << milliseconds(start, prepared) << " ms, "
+			<< "reading and reflecting " << milliseconds(prepared, end) << " ms")
+	}
+	
+	std::vector<ShaderPipeline*> GetShaderPipelines() override {
+		return {
+			&primitivesShader,
+			&shadowMapShader,
+			&shadowCubeShader,
+			&shadowCascadeShader,
+			&skyboxShader,
+			&lightingShader,
+			&lightClusteringShader,
+			&clusteredLightingShader,
+			&lightVolumeShader,
+			&shadowPrefilteringShader,
+			&skyboxPrefilteringShader,
+		};
+	}
+	
+	void ShaderPipelinesReloaded(const std::vector<ShaderPipeline*>& pipelines) override {
+		for (auto* pipeline : pipelines) {
+			if (pipeline == &skyboxShader || pipeline == &skyboxPrefilteringShader) InvalidateSkybox();
+			if (pipeline == &shadowMapShader) InvalidateShadowCaches();
+		}
 	}
 	
 	void LoadScene() override {
 		// Light Sources
 		lightSources.push_back({AMBIENT_SKYBOX, {0,0,0}, /*color*/{1,1,1}, /*intensity*/0.02});
-		lightSources.push_back({POINT_LIGHT, /*position*/{ -8,-4, 10}, /*color*/{1,0,0}, /*intensity*/0.5});
-		lightSources.push_back({POINT_LIGHT, /*position*/{ 18, 4,  2}, /*color*/{0,1,0}, /*intensity*/0.5});
-		lightSources.push_back({POINT_LIGHT, /*position*/{-12, 0,  5}, /*color*/{0,0,1}, /*intensity*/0.5});
-		lightSources.push_back({SPOT_LIGHT,  /*position*/{  0, 0, 20}, /*color*/{1,1,1}, /*intensity*/1.0, /*direction*/{-0.1,0.1,-1}, /*inner angle*/20, /*outer angle*/30});
+		lightSources.push_back({POINT_LIGHT, /*position*/{ -8,-4, 10}, /*color*/{1,0,0}, /*intensity*/0.5, /*direction*/{1,1,1}, 0, 0, /*radius*/LightSource::MakeRadius(0.5)});
+		lightSources.push_back({POINT_LIGHT, /*position*/{ 18, 4,  2}, /*color*/{0,1,0}, /*intensity*/0.5, /*direction*/{1,1,1}, 0, 0, /*radius*/LightSource::MakeRadius(0.5)});
+		lightSources.push_back({POINT_LIGHT, /*position*/{-12, 0,  5}, /*color*/{0,0,1}, /*intensity*/0.5, /*direction*/{1,1,1}, 0, 0, /*radius*/LightSource::MakeRadius(0.5)});
+		lightSources.push_back({SPOT_LIGHT,  /*position*/{  0, 0, 20}, /*color*/{1,1,1}, /*intensity*/1.0, /*direction*/{-0.1,0.1,-1}, /*inner angle*/20, /*outer angle*/30, /*radius*/LightSource::MakeRadius(1.0)});
+		lightSources.push_back({DIRECTIONAL_LIGHT, /*position*/{0, 0, 0}, /*color*/{1,0.95,0.9}, /*intensity*/0.2, /*direction*/{0.3,0.2,-1}});
 
 		// Multicolor Triangle
-		sceneObjects.push_back({
-			// position
-			{0, 5, 0},
+		auto triangle = AddMesh(
 			{ // Vertices
 				{/*pos*/{-1, 0,-1}, /*normal*/{0,-1,0}, /*color*/{1,0,0}},
 				{/*pos*/{ 1, 0,-1}, /*normal*/{0,-1,0}, /*color*/{0,1,0}},
@@ -465,13 +1701,11 @@ public: // Scene configuration
 			{ // Indices
 				0,1,2,
 			}
-		});
+		);
+		sceneObjects.push_back({/*position*/{0, 5, 0}, triangle});
 
 		// Gray Cube
-		sceneObjects.push_back({
-			// position
-			{3, 5, -2},
-
+		auto cube = AddMesh(
 			{ // Vertices
 
 				// front
@@ -519,12 +1753,11 @@ public: // Scene configuration
 				16,17,18, 18,19,16, // top
 				20,22,21, 20,23,22, // bottom
 			}
-		});
+		);
+		sceneObjects.push_back({/*position*/{3, 5, -2}, cube});
 
 		// Greenish Plane
-		sceneObjects.push_back({
-			// position
-			{0, 0, -6},
+		auto plane = AddMesh(
 			{ // Vertices
 				{/*pos*/{-1000,-1000,0}, /*normal*/{0,0,1}, /*color*/{0.4,0.5,0.1}},
 				{/*pos*/{ 1000,-1000,0}, /*normal*/{0,0,1}, /*color*/{0.4,0.5,0.1}},
@@ -534,25 +1767,188 @@ public: // Scene configuration
 			{ // Indices
 				0,1,2, 2,3,0
 			}
-		});
+		);
+		sceneObjects.push_back({/*position*/{0, 0, -6}, plane});
 
+		IndexSceneObjects();
 	}
 	
 	void UnloadScene() override {
 		lightSources.clear();
+		sceneTree.Clear();
 		sceneObjects.clear();
+		meshes.clear();
+		meshStreamer.Clear();
+	}
+	
+	std::shared_ptr<Mesh> AddMesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices) {
+		auto mesh = meshes.emplace_back(std::make_shared<Mesh>(vertices, indices));
+		mesh->GenerateLods();
+		return mesh;
+	}
+
+	// Loads a .v4dmesh file (see tools/MeshConverter), its data is uploaded straight from the file mapping
+	std::shared_ptr<Mesh> LoadMesh(const std::string& filePath) {
+		return meshes.emplace_back(Mesh::FromFile(filePath));
+	}
+
+	// Registers a .v4dmesh file to be streamed in the background, objects using it appear once it is resident
+	std::shared_ptr<Mesh> StreamMesh(const std::string& filePath) {
+		return meshStreamer.AddMesh(filePath);
+	}
+
+	// (Re)builds the spatial index, must be called whenever objects are added to or removed from sceneObjects
+	void IndexSceneObjects() {
+		sceneTree.Clear();
+		for (uint32_t i = 0; i < sceneObjects.size(); ++i) {
+			sceneObjects[i].spatialProxy = sceneTree.CreateProxy(sceneObjects[i].GetWorldBounds(), i);
+		}
+		InvalidateShadowCaches();
+	}
+
+	// Objects must be moved through here to keep the spatial index up to date
+	void MoveObject(PrimitiveGeometry& obj, vec3 position) {
+		vec3 displacement = position - obj.position;
+		if (obj.isStatic) InvalidateShadowCaches(obj.GetWorldBounds());
+		obj.position = position;
+		if (obj.isStatic) InvalidateShadowCaches(obj.GetWorldBounds());
+		if (obj.spatialProxy != DynamicAabbTree::nullNode) {
+			sceneTree.MoveProxy(obj.spatialProxy, obj.GetWorldBounds(), displacement);
+		}
 	}
 	
 public: // Update
 
+	// Selects a level of detail from the object's projected size on screen
+	uint32_t SelectLod(const PrimitiveGeometry& obj, double maxPixelError, int bias = 0) {
+		Aabb bounds = obj.GetWorldBounds();
+		double distance = glm::distance(camera.worldPosition, dvec3(bounds.GetCenter())) - bounds.GetRadius();
+		return obj.mesh->SelectLod(camera.GetPixelsPerUnit(distance, swapChain->extent.height), maxPixelError, bias);
+	}
+
     void FrameUpdate(uint) override {
 		// Update camera
 		camera.RefreshProjectionMatrix((double) swapChain->extent.width / swapChain->extent.height);
 		camera.RefreshViewMatrix();
 
-		// Update objects matrices
-		for (auto& obj : sceneObjects) {
-			obj.SetMvpForCamera(camera);
+		// Streaming, meshes that become resident here are drawn in this frame
+		sceneTree.Query(BoundingSphere{camera.worldPosition, streamingDistance}, [this](uint32_t objectIndex){
+			auto& obj = sceneObjects[objectIndex];
+			if (obj.mesh) meshStreamer.RequestResidency(obj.mesh.get(), glm::distance(camera.worldPosition, dvec3(obj.position)));
+		});
+		meshStreamer.Update();
+		// Static casters may have appeared or disappeared from cached shadow maps, only around the objects using these meshes
+		const auto& changedMeshes = meshStreamer.GetChangedMeshes();
+		if (!changedMeshes.empty()) {
+			for (auto& obj : sceneObjects) {
+				if (obj.isStatic && obj.mesh && std::find(changedMeshes.begin(), changedMeshes.end(), obj.mesh.get()) != changedMeshes.end()) {
+					InvalidateShadowCaches(obj.GetWorldBounds());
+				}
+			}
+		}
+
+		// Frustum culling
+		visibleObjects.clear();
+		sceneTree.Query(camera.GetFrustum(), [this](uint32_t objectIndex){
+			visibleObjects.push_back(&sceneObjects[objectIndex]);
+		});
+
+		// Group objects by mesh and compute their per-instance matrices, relative to the camera
+		glm::mat4 viewRotation = glm::mat4(glm::mat3(camera.viewMatrix));
+		objectInstances.Build(visibleObjects, [this, &viewRotation](const PrimitiveGeometry& obj){
+			MeshInstance instance;
+			instance.SetTransform(viewRotation, glm::translate(glm::mat4(1), glm::vec3(dvec3(obj.position) - camera.worldPosition)));
+			return instance;
+		}, [this](const PrimitiveGeometry& obj){
+			return SelectLod(obj, lodMaxPixelError);
+		}, &threadPool);
+
+		// Shadow maps
+		Frustum cameraFrustum = camera.GetFrustum();
+		UpdateShadowMaps(cameraFrustum);
+		UpdateShadowCubes(cameraFrustum);
+		UpdateShadowCascades();
+
+		// Lights, the ambient and directional lights are always drawn full screen
+		for (auto& group : lightGroups) group.clear();
+		lightCullingStats.lights = 0;
+		lightCullingStats.culled = 0;
+		lightCullingStats.scissored = 0;
+		lightCullingStats.pixelsSaved = 0;
+		for (auto& lightSource : lightSources) {
+			if (float influenceRadius = lightSource.GetInfluenceRadius(); influenceRadius > 0) {
+				lightCullingStats.lights++;
+				if (cameraFrustum.Test(BoundingSphere{lightSource.worldPosition, influenceRadius}) == OUTSIDE) {
+					lightCullingStats.culled++;
+					continue;
+				}
+			}
+			if (lightingMode == LIGHTING_VOLUMES && lightSource.radius > 0 && (lightSource.type == POINT_LIGHT || (lightSource.type == SPOT_LIGHT && lightSource.outerAngle <= maxSpotLightVolumeAngle))) {
+				lightGroups[lightSource.type == SPOT_LIGHT? LIGHT_GROUP_CONE_VOLUME : LIGHT_GROUP_SPHERE_VOLUME].push_back(&lightSource);
+			} else if (lightingMode != LIGHTING_CLUSTERED || lightSource.type == AMBIENT_SKYBOX || lightSource.type == DIRECTIONAL_LIGHT) {
+				lightGroups[LIGHT_GROUP_FULL_SCREEN_POINT + lightSource.type].push_back(&lightSource);
+			} else {
+				lightGroups[LIGHT_GROUP_CLUSTERED].push_back(&lightSource);
+			}
+		}
+
+		// Fill the lights buffer group by group, the camera's matrices are computed once for all lights
+		frameLights.clear();
+		lightBatches.clear();
+		lightVolumes.clear();
+		mat3 normalMatrix = transpose(inverse(mat3(camera.viewMatrix)));
+		clusteredLightCount = 0;
+		VkRect2D screenRect {{0, 0}, swapChain->extent};
+		uint64_t screenPixels = uint64_t(screenRect.extent.width) * screenRect.extent.height;
+		auto depthAt = [this](double distance){
+			return glm::clamp(float((camera.projectionMatrix[2][2] * -distance + camera.projectionMatrix[3][2]) / distance), 0.0f, 1.0f);
+		};
+		for (int group = 0; group < LIGHT_GROUP_COUNT; ++group) {
+			uint32_t firstLight = frameLights.size();
+			for (auto* lightSource : lightGroups[group]) {
+				if (frameLights.size() == maxLights) break;
+				frameLights.push_back(lightSource->MakeBufferData(camera.viewMatrix, normalMatrix, lightShadowMaps[lightSource - lightSources.data()]));
+			}
+			uint32_t lightCount = frameLights.size() - firstLight;
+			if (lightCount == 0) continue;
+			switch (group) {
+				case LIGHT_GROUP_CLUSTERED:
+					clusteredLightCount = lightCount;
+				break;
+				case LIGHT_GROUP_FULL_SCREEN_POINT:
+				case LIGHT_GROUP_FULL_SCREEN_SPOT:
+				case LIGHT_GROUP_FULL_SCREEN_AMBIENT:
+				case LIGHT_GROUP_FULL_SCREEN_DIRECTIONAL:
+					// Consecutive lights that cover the whole screen share a draw
+					for (uint32_t i = firstLight, groupFirstBatch = lightBatches.size(); i < firstLight + lightCount; ++i) {
+						VkRect2D scissor = screenRect;
+						if (float influenceRadius = lightGroups[group][i - firstLight]->GetInfluenceRadius(); influenceRadius > 0) {
+							if (!MakeLightScissor(frameLights[i].viewPosition, influenceRadius, scissor)) {
+								lightCullingStats.culled++;
+								continue;
+							}
+							lightCullingStats.scissored++;
+							lightCullingStats.pixelsSaved += screenPixels - uint64_t(scissor.extent.width) * scissor.extent.height;
+						}
+						bool fullScreen = scissor.extent.width == screenRect.extent.width && scissor.extent.height == screenRect.extent.height;
+						if (fullScreen && lightBatches.size() > groupFirstBatch && lightBatches.back().scissor.extent.width == screenRect.extent.width && lightBatches.back().scissor.extent.height == screenRect.extent.height && lightBatches.back().batch.firstLight + lightBatches.back().batch.lightCount == i) {
+							lightBatches.back().batch.lightCount++;
+						} else {
+							lightBatches.push_back({{i, 1}, scissor, lightingPermutations[frameLights[i].type]});
+						}
+					}
+				break;
+				case LIGHT_GROUP_SPHERE_VOLUME:
+				case LIGHT_GROUP_CONE_VOLUME:
+					for (uint32_t i = firstLight; i < firstLight + lightCount; ++i) {
+						// Depth range of the light's bounding sphere, reversed so the far end has the smallest depth
+						double distance = -frameLights[i].viewPosition.z;
+						double radius = frameLights[i].radius;
+						if (distance + radius <= camera.znear) continue;
+						lightVolumes.push_back({i, group == LIGHT_GROUP_CONE_VOLUME? lightVolumeCone.get() : lightVolumeSphere.get(), depthAt(distance + radius), depthAt(glm::max(distance - radius, camera.znear)), lightVolumePermutations[frameLights[i].type]});
+					}
+				break;
+			}
 		}
 	}
 	
@@ -17,6 +17,7 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 SOURCES += \
     libs/v4d/graphics/vulkan/Buffer.cpp \
+    libs/v4d/graphics/vulkan/CommandRecorder.cpp \
     libs/v4d/graphics/vulkan/ComputeShaderPipeline.cpp \
     libs/v4d/graphics/vulkan/DescriptorSet.cpp \
     libs/v4d/graphics/vulkan/Device.cpp \
@@ -25,23 +26,51 @@ SOURCES += \
     libs/v4d/graphics/vulkan/Loader.cpp \
     libs/v4d/graphics/vulkan/PhysicalDevice.cpp \
     libs/v4d/graphics/vulkan/PipelineLayout.cpp \
+    libs/v4d/graphics/vulkan/PipelineScheduler.cpp \
     libs/v4d/graphics/vulkan/RasterShaderPipeline.cpp \
     libs/v4d/graphics/vulkan/RenderPass.cpp \
     libs/v4d/graphics/vulkan/Shader.cpp \
+    libs/v4d/graphics/vulkan/ShaderArchive.cpp \
+    libs/v4d/graphics/vulkan/ShaderCompiler.cpp \
     libs/v4d/graphics/vulkan/ShaderPipeline.cpp \
     libs/v4d/graphics/vulkan/ShaderProgram.cpp \
+    libs/v4d/graphics/vulkan/ShaderReflection.cpp \
     libs/v4d/graphics/vulkan/SwapChain.cpp \
+    libs/v4d/graphics/DynamicAabbTree.cpp \
+    libs/v4d/graphics/GpuTimer.cpp \
+    libs/v4d/graphics/MeshFile.cpp \
+    libs/v4d/graphics/MeshSimplifier.cpp \
+    libs/v4d/graphics/MeshStreamer.cpp \
+    libs/v4d/graphics/RenderQueue.cpp \
     libs/v4d/graphics/Renderer.cpp \
+    libs/v4d/graphics/ShaderWatcher.cpp \
+    libs/v4d/utilities/ThreadPool.cpp \
     main.cpp \
     mainwindow.cpp
 
 HEADERS += \
     DeferredRenderer.hpp \
     libs/v4d/common.h \
+    libs/v4d/core.h \
+    libs/v4d/graphics/Bounds.hpp \
     libs/v4d/graphics/Camera.hpp \
+    libs/v4d/graphics/DynamicAabbTree.h \
+    libs/v4d/graphics/GpuTimer.h \
     libs/v4d/graphics/LightSource.hpp \
+    libs/v4d/graphics/LightVolume.hpp \
+    libs/v4d/graphics/Mesh.hpp \
+    libs/v4d/graphics/MeshData.h \
+    libs/v4d/graphics/MeshFile.h \
+    libs/v4d/graphics/MeshInstancing.hpp \
+    libs/v4d/graphics/MeshSimplifier.h \
+    libs/v4d/graphics/MeshStreamer.h \
     libs/v4d/graphics/PrimitiveGeometry.hpp \
+    libs/v4d/graphics/RenderQueue.h \
+    libs/v4d/graphics/ShadowAtlas.hpp \
+    libs/v4d/graphics/ShadowCascades.hpp \
+    libs/v4d/graphics/ShaderWatcher.h \
     libs/v4d/graphics/vulkan/Buffer.h \
+    libs/v4d/graphics/vulkan/CommandRecorder.h \
     libs/v4d/graphics/vulkan/ComputeShaderPipeline.h \
     libs/v4d/graphics/vulkan/DescriptorSet.h \
     libs/v4d/graphics/vulkan/Device.h \
@@ -50,15 +79,27 @@ HEADERS += \
     libs/v4d/graphics/vulkan/Loader.h \
     libs/v4d/graphics/vulkan/PhysicalDevice.h \
     libs/v4d/graphics/vulkan/PipelineLayout.h \
+    libs/v4d/graphics/vulkan/PipelineScheduler.h \
     libs/v4d/graphics/vulkan/RasterShaderPipeline.h \
     libs/v4d/graphics/vulkan/RenderPass.h \
     libs/v4d/graphics/vulkan/Shader.h \
+    libs/v4d/graphics/vulkan/ShaderArchive.h \
+    libs/v4d/graphics/vulkan/ShaderCompiler.h \
     libs/v4d/graphics/vulkan/ShaderPipeline.h \
     libs/v4d/graphics/vulkan/ShaderProgram.h \
+    libs/v4d/graphics/vulkan/ShaderReflection.h \
+    libs/v4d/graphics/vulkan/SpecializationConstants.h \
     libs/v4d/graphics/vulkan/SwapChain.h \
     libs/v4d/graphics/Renderer.h \
+    libs/v4d/utilities/ThreadPool.h \
     mainwindow.h
 
+# Runtime shader compilation (--compile-shaders) uses the shaderc library with CONFIG+=shaderc, otherwise it runs glslangValidator
+shaderc {
+  DEFINES += V4D_SHADERC
+  LIBS += -lshaderc_combined
+}
+
 INCLUDEPATH += libs/xvk
 INCLUDEPATH += libs/xvk/glm
 
@@ -67,17 +108,27 @@ qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
-# Shaders
+# Shaders, compiled to .spv by the build (the .spv files are not tracked)
 DISTFILES += \
     shaders/lighting.vert \
     shaders/lighting.frag \
+    shaders/lighting.clustered.frag \
+    shaders/lighting.volume.vert \
+    shaders/lighting.clusters.comp \
     shaders/primitives.vert \
     shaders/primitives.frag \
     shaders/primitives.shadow.vert \
     shaders/primitives.shadow.frag \
+    shaders/primitives.shadow.layered.vert \
+    shaders/primitives.shadow.layered.geom \
+    shaders/shadows.prefilter.comp \
     shaders/skybox.frag \
     shaders/skybox.geom \
+    shaders/skybox.prefilter.comp \
     shaders/skybox.vert
+# Shader code included by the shaders above, not compiled on its own
+OTHER_FILES += \
+    shaders/lighting.glsl
 linux {
   shaders.commands = for s in $${DISTFILES} ; \
     do glslangValidator -V ../$${TARGET}/\"\$\$s\" -o ../$${TARGET}/\"\$\$s\".spv ; \
@@ -90,7 +141,7 @@ win32 {
   QMAKE_POST_LINK += $(MKDIR) $$quote(.\\shaders\\) $$escape_expand(\\n\\t)
   for (FILE, DISTFILES) {
     win32:FILE ~= s,/,\\,g
-    QMAKE_POST_LINK += $$QMAKE_COPY $$quote(..\\$${TARGET}\\$${FILE}.spv) $$quote(.\\shaders\\) $$escape_expand(\\n\\t)
+    QMAKE_POST_LINK += glslangValidator -V $$quote(..\\$${TARGET}\\$${FILE}) -o $$quote(.\\$${FILE}.spv) $$escape_expand(\\n\\t)
   }
 }
 
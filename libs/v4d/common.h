@@ -1,39 +1,7 @@
 #pragma once
 
-// std
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <chrono>
-#include <mutex>
-#include <string>
-#include <algorithm>
-#include <functional>
-#include <atomic>
-#include <unordered_map>
-#include <map>
-#include <thread>
-#include <queue>
-#include <cstring>
-#include <stdexcept>
-#include <cstdint>
-#include <stdio.h>
-#include <regex>
-#include <vector>
-
-#ifdef _WIN32
-	#include <windows.h>
-	#include <io.h>
-#else
-    #include <dlfcn.h>
-    #include <sys/types.h>
-    #include <unistd.h>
-#endif
-
-// Logging
-#define LOG(msg) std::cout << " " << msg << std::endl;
-#define LOG_WARN(msg) std::cout << "WARNING: " << msg << std::endl;
-#define LOG_ERROR(msg) std::cerr << "ERROR: " << msg << std::endl;
+// std, logging and GLM (everything that does not depend on Vulkan)
+#include "core.h"
 
 // v4d/graphics/vulkan
 #include "graphics/vulkan/Loader.h"
@@ -43,21 +11,20 @@
 #include "graphics/vulkan/Image.h"
 #include "graphics/vulkan/SwapChain.h"
 #include "graphics/vulkan/Buffer.h"
+#include "graphics/vulkan/CommandRecorder.h"
 #include "graphics/vulkan/DescriptorSet.h"
+#include "graphics/vulkan/ShaderReflection.h"
 #include "graphics/vulkan/PipelineLayout.h"
+#include "graphics/vulkan/ShaderArchive.h"
 #include "graphics/vulkan/Shader.h"
+#include "graphics/vulkan/ShaderCompiler.h"
+#include "graphics/vulkan/SpecializationConstants.h"
 #include "graphics/vulkan/ShaderProgram.h"
 #include "graphics/vulkan/RenderPass.h"
 #include "graphics/vulkan/ShaderPipeline.h"
 #include "graphics/vulkan/ComputeShaderPipeline.h"
 #include "graphics/vulkan/RasterShaderPipeline.h"
+#include "graphics/vulkan/PipelineScheduler.h"
 
 // v4d/graphics
 #include "graphics/Renderer.h"
-
-// GLM
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/hash.hpp>
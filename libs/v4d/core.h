@@ -0,0 +1,43 @@
+#pragma once
+
+// std
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <unordered_map>
+#include <map>
+#include <thread>
+#include <queue>
+#include <cstring>
+#include <stdexcept>
+#include <cstdint>
+#include <stdio.h>
+#include <vector>
+#include <memory>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <io.h>
+#else
+    #include <dlfcn.h>
+    #include <sys/types.h>
+    #include <unistd.h>
+#endif
+
+// Logging
+#define LOG(msg) std::cout << " " << msg << std::endl;
+#define LOG_WARN(msg) std::cout << "WARNING: " << msg << std::endl;
+#define LOG_ERROR(msg) std::cerr << "ERROR: " << msg << std::endl;
+
+// GLM
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/hash.hpp>
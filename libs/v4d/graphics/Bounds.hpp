@@ -0,0 +1,140 @@
+#pragma once
+#include "../core.h"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    // Axis-aligned bounding box
+    struct Aabb {
+        vec3 min {0};
+        vec3 max {0};
+
+        vec3 GetCenter() const {
+            return (min + max) * 0.5f;
+        }
+
+        float GetRadius() const {
+            return glm::length(max - min) * 0.5f;
+        }
+
+        float GetSurfaceArea() const {
+            vec3 d = max - min;
+            return 2.0f * (d.x*d.y + d.y*d.z + d.z*d.x);
+        }
+
+        bool Contains(const Aabb& other) const {
+            return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+        }
+
+        Aabb Translated(vec3 offset) const {
+            return {min + offset, max + offset};
+        }
+
+        Aabb Expanded(float margin) const {
+            return {min - vec3(margin), max + vec3(margin)};
+        }
+
+        static Aabb Union(const Aabb& a, const Aabb& b) {
+            return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+        }
+
+        static Aabb FromPoints(const vec3* points, size_t count, size_t stride = sizeof(vec3)) {
+            if (count == 0) return {};
+            Aabb aabb {*points, *points};
+            for (size_t i = 1; i < count; ++i) {
+                const vec3& p = *(const vec3*)((const char*)points + i * stride);
+                aabb.min = glm::min(aabb.min, p);
+                aabb.max = glm::max(aabb.max, p);
+            }
+            return aabb;
+        }
+    };
+
+    enum BoundsTestResult : int {
+        OUTSIDE = 0,
+        INTERSECTS = 1,
+        INSIDE = 2,
+    };
+
+    struct BoundingSphere {
+        dvec3 center;
+        double radius;
+
+        BoundsTestResult Test(const Aabb& aabb) const {
+            // Squared distance between the center and the box
+            dvec3 closest = glm::clamp(center, dvec3(aabb.min), dvec3(aabb.max));
+            dvec3 d = closest - center;
+            if (glm::dot(d, d) > radius*radius) return OUTSIDE;
+            // Box is inside if its farthest corner is inside
+            dvec3 farthest = glm::max(glm::abs(dvec3(aabb.min) - center), glm::abs(dvec3(aabb.max) - center));
+            return glm::dot(farthest, farthest) <= radius*radius ? INSIDE : INTERSECTS;
+        }
+    };
+
+    struct BoundingCone {
+        dvec3 apex;
+        dvec3 direction; // normalized
+        double range;
+        double angle; // half-angle in radians
+
+        BoundsTestResult Test(const Aabb& aabb) const {
+            // Conservative test using the bounding sphere of the box
+            dvec3 center = aabb.GetCenter();
+            double radius = aabb.GetRadius();
+            dvec3 v = center - apex;
+            double vLenSq = glm::dot(v, v);
+            double v1Len = glm::dot(v, direction);
+            if (v1Len > radius + range) return OUTSIDE; // beyond range
+            if (v1Len < -radius) return OUTSIDE; // behind apex
+            double distanceToCone = glm::cos(angle) * glm::sqrt(glm::max(0.0, vLenSq - v1Len*v1Len)) - v1Len * glm::sin(angle);
+            if (distanceToCone > radius) return OUTSIDE;
+            return INTERSECTS;
+        }
+    };
+
+    struct Frustum {
+        dvec4 planes[6]; // xyz = normal pointing inside, w = distance
+
+        // Extracts the planes of a view-projection matrix (works with any depth range or reversed depth)
+        static Frustum FromMatrix(const dmat4& m) {
+            Frustum frustum;
+            dvec4 row0 {m[0][0], m[1][0], m[2][0], m[3][0]};
+            dvec4 row1 {m[0][1], m[1][1], m[2][1], m[3][1]};
+            dvec4 row2 {m[0][2], m[1][2], m[2][2], m[3][2]};
+            dvec4 row3 {m[0][3], m[1][3], m[2][3], m[3][3]};
+            frustum.planes[0] = row3 + row0; // left
+            frustum.planes[1] = row3 - row0; // right
+            frustum.planes[2] = row3 + row1; // bottom
+            frustum.planes[3] = row3 - row1; // top
+            frustum.planes[4] = row2; // z >= 0
+            frustum.planes[5] = row3 - row2; // z <= w
+            for (auto& plane : frustum.planes) {
+                plane /= glm::length(dvec3(plane));
+            }
+            return frustum;
+        }
+
+        BoundsTestResult Test(const Aabb& aabb) const {
+            dvec3 center = aabb.GetCenter();
+            dvec3 extent = dvec3(aabb.max) - center;
+            BoundsTestResult result = INSIDE;
+            for (auto& plane : planes) {
+                double distance = glm::dot(dvec3(plane), center) + plane.w;
+                double projectedExtent = glm::dot(extent, glm::abs(dvec3(plane)));
+                if (distance < -projectedExtent) return OUTSIDE;
+                if (distance < projectedExtent) result = INTERSECTS;
+            }
+            return result;
+        }
+
+        BoundsTestResult Test(const BoundingSphere& sphere) const {
+            BoundsTestResult result = INSIDE;
+            for (auto& plane : planes) {
+                double distance = glm::dot(dvec3(plane), sphere.center) + plane.w;
+                if (distance < -sphere.radius) return OUTSIDE;
+                if (distance < sphere.radius) result = INTERSECTS;
+            }
+            return result;
+        }
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "../common.h"
+#include "Bounds.hpp"
 
 namespace v4d::graphics {
     using namespace glm;
@@ -30,6 +31,15 @@ namespace v4d::graphics {
             proj[1][1] *= -1;
             return proj;
         }
+
+        // Projected size in pixels of one world unit at the given distance from the camera
+        double GetPixelsPerUnit(double distance, double viewportHeight) const {
+            return viewportHeight / (2.0 * glm::max(distance, znear) * tan(radians(fov) / 2.0));
+        }
+
+        Frustum GetFrustum() const {
+            return Frustum::FromMatrix(projectionMatrix * viewMatrix);
+        }
         
     };
 }
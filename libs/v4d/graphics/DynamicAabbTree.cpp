@@ -0,0 +1,270 @@
+#include "libs/v4d/common.h"
+#include "DynamicAabbTree.h"
+
+using namespace v4d::graphics;
+
+int DynamicAabbTree::CreateProxy(const Aabb& aabb, uint32_t userData) {
+	int proxyId = AllocateNode();
+	nodes[proxyId].aabb = aabb.Expanded(fatMargin);
+	nodes[proxyId].userData = userData;
+	nodes[proxyId].height = 0;
+	InsertLeaf(proxyId);
+	proxyCount++;
+	return proxyId;
+}
+
+void DynamicAabbTree::DestroyProxy(int proxyId) {
+	if (proxyId < 0 || proxyId >= (int)nodes.size() || !nodes[proxyId].IsLeaf()) {
+		LOG_ERROR("DynamicAabbTree::DestroyProxy : invalid proxy " << proxyId)
+		return;
+	}
+	RemoveLeaf(proxyId);
+	FreeNode(proxyId);
+	proxyCount--;
+}
+
+bool DynamicAabbTree::MoveProxy(int proxyId, const Aabb& aabb, const vec3& displacement) {
+	if (nodes[proxyId].aabb.Contains(aabb)) return false;
+
+	RemoveLeaf(proxyId);
+
+	Aabb fatAabb = aabb.Expanded(fatMargin);
+	vec3 d = displacement * displacementMultiplier;
+	fatAabb.min += glm::min(d, vec3(0));
+	fatAabb.max += glm::max(d, vec3(0));
+	nodes[proxyId].aabb = fatAabb;
+
+	InsertLeaf(proxyId);
+	return true;
+}
+
+void DynamicAabbTree::Clear() {
+	nodes.clear();
+	root = nullNode;
+	freeList = nullNode;
+	proxyCount = 0;
+}
+
+int DynamicAabbTree::AllocateNode() {
+	int node;
+	if (freeList != nullNode) {
+		node = freeList;
+		freeList = nodes[node].next;
+	} else {
+		node = (int)nodes.size();
+		nodes.emplace_back();
+	}
+	nodes[node].parent = nullNode;
+	nodes[node].child1 = nullNode;
+	nodes[node].child2 = nullNode;
+	nodes[node].next = nullNode;
+	nodes[node].height = 0;
+	nodes[node].userData = 0;
+	return node;
+}
+
+void DynamicAabbTree::FreeNode(int node) {
+	nodes[node].next = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+void DynamicAabbTree::InsertLeaf(int leaf) {
+	if (root == nullNode) {
+		root = leaf;
+		nodes[root].parent = nullNode;
+		return;
+	}
+
+	// Find the best sibling using the surface area heuristic
+	Aabb leafAabb = nodes[leaf].aabb;
+	int index = root;
+	while (!nodes[index].IsLeaf()) {
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		float area = nodes[index].aabb.GetSurfaceArea();
+		float combinedArea = Aabb::Union(nodes[index].aabb, leafAabb).GetSurfaceArea();
+
+		// Cost of creating a new parent for this node and the new leaf
+		float cost = 2.0f * combinedArea;
+
+		// Minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](int child){
+			float newArea = Aabb::Union(leafAabb, nodes[child].aabb).GetSurfaceArea();
+			if (nodes[child].IsLeaf()) return newArea + inheritanceCost;
+			return (newArea - nodes[child].aabb.GetSurfaceArea()) + inheritanceCost;
+		};
+		float cost1 = descendCost(child1);
+		float cost2 = descendCost(child2);
+
+		if (cost < cost1 && cost < cost2) break;
+
+		index = cost1 < cost2 ? child1 : child2;
+	}
+	int sibling = index;
+
+	// Create a new parent
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].aabb = Aabb::Union(leafAabb, nodes[sibling].aabb);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent != nullNode) {
+		if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+		else nodes[oldParent].child2 = newParent;
+	} else {
+		root = newParent;
+	}
+
+	// Walk back up the tree fixing heights and AABBs
+	index = nodes[leaf].parent;
+	while (index != nullNode) {
+		index = Balance(index);
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+		nodes[index].aabb = Aabb::Union(nodes[child1].aabb, nodes[child2].aabb);
+		index = nodes[index].parent;
+	}
+}
+
+void DynamicAabbTree::RemoveLeaf(int leaf) {
+	if (leaf == root) {
+		root = nullNode;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent != nullNode) {
+		// Destroy parent and connect sibling to grandParent
+		if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+		else nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		// Adjust ancestor bounds
+		int index = grandParent;
+		while (index != nullNode) {
+			index = Balance(index);
+			int child1 = nodes[index].child1;
+			int child2 = nodes[index].child2;
+			nodes[index].aabb = Aabb::Union(nodes[child1].aabb, nodes[child2].aabb);
+			nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+			index = nodes[index].parent;
+		}
+	} else {
+		root = sibling;
+		nodes[sibling].parent = nullNode;
+		FreeNode(parent);
+	}
+}
+
+// Performs a left or right rotation if node A is imbalanced, returns the new root of this subtree
+int DynamicAabbTree::Balance(int iA) {
+	Node* A = &nodes[iA];
+	if (A->IsLeaf() || A->height < 2) return iA;
+
+	int iB = A->child1;
+	int iC = A->child2;
+	Node* B = &nodes[iB];
+	Node* C = &nodes[iC];
+
+	int balance = C->height - B->height;
+
+	// Rotate C up
+	if (balance > 1) {
+		int iF = C->child1;
+		int iG = C->child2;
+		Node* F = &nodes[iF];
+		Node* G = &nodes[iG];
+
+		// Swap A and C
+		C->child1 = iA;
+		C->parent = A->parent;
+		A->parent = iC;
+
+		// A's old parent should point to C
+		if (C->parent != nullNode) {
+			if (nodes[C->parent].child1 == iA) nodes[C->parent].child1 = iC;
+			else nodes[C->parent].child2 = iC;
+		} else {
+			root = iC;
+		}
+
+		// Rotate
+		if (F->height > G->height) {
+			C->child2 = iF;
+			A->child2 = iG;
+			G->parent = iA;
+			A->aabb = Aabb::Union(B->aabb, G->aabb);
+			C->aabb = Aabb::Union(A->aabb, F->aabb);
+			A->height = 1 + std::max(B->height, G->height);
+			C->height = 1 + std::max(A->height, F->height);
+		} else {
+			C->child2 = iG;
+			A->child2 = iF;
+			F->parent = iA;
+			A->aabb = Aabb::Union(B->aabb, F->aabb);
+			C->aabb = Aabb::Union(A->aabb, G->aabb);
+			A->height = 1 + std::max(B->height, F->height);
+			C->height = 1 + std::max(A->height, G->height);
+		}
+
+		return iC;
+	}
+
+	// Rotate B up
+	if (balance < -1) {
+		int iD = B->child1;
+		int iE = B->child2;
+		Node* D = &nodes[iD];
+		Node* E = &nodes[iE];
+
+		// Swap A and B
+		B->child1 = iA;
+		B->parent = A->parent;
+		A->parent = iB;
+
+		// A's old parent should point to B
+		if (B->parent != nullNode) {
+			if (nodes[B->parent].child1 == iA) nodes[B->parent].child1 = iB;
+			else nodes[B->parent].child2 = iB;
+		} else {
+			root = iB;
+		}
+
+		// Rotate
+		if (D->height > E->height) {
+			B->child2 = iD;
+			A->child1 = iE;
+			E->parent = iA;
+			A->aabb = Aabb::Union(C->aabb, E->aabb);
+			B->aabb = Aabb::Union(A->aabb, D->aabb);
+			A->height = 1 + std::max(C->height, E->height);
+			B->height = 1 + std::max(A->height, D->height);
+		} else {
+			B->child2 = iE;
+			A->child1 = iD;
+			D->parent = iA;
+			A->aabb = Aabb::Union(C->aabb, D->aabb);
+			B->aabb = Aabb::Union(A->aabb, E->aabb);
+			A->height = 1 + std::max(C->height, D->height);
+			B->height = 1 + std::max(A->height, E->height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
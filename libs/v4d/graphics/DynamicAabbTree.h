@@ -0,0 +1,106 @@
+#pragma once
+#include "libs/v4d/common.h"
+#include "Bounds.hpp"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    // Incremental bounding volume hierarchy of scene objects.
+    // Leaves store fat AABBs so that small moves only need a containment check instead of a re-insertion,
+    // and the tree is kept balanced with AVL-like rotations so that queries stay O(log n) as objects come and go.
+    class DynamicAabbTree {
+    public:
+        static const int nullNode = -1;
+
+        float fatMargin = 0.1f; // leaves are enlarged by this much in every direction
+        float displacementMultiplier = 2.0f; // leaves are also enlarged in the direction of movement, predicting where the object goes next
+
+        int CreateProxy(const Aabb& aabb, uint32_t userData);
+        void DestroyProxy(int proxyId);
+
+        // Returns true if the proxy had to be re-inserted, false if its fat AABB still contains the new one
+        bool MoveProxy(int proxyId, const Aabb& aabb, const vec3& displacement = vec3{0});
+
+        void Clear();
+
+        uint32_t GetUserData(int proxyId) const {return nodes[proxyId].userData;}
+        const Aabb& GetFatAabb(int proxyId) const {return nodes[proxyId].aabb;}
+        int GetProxyCount() const {return proxyCount;}
+        int GetHeight() const {return root == nullNode? 0 : nodes[root].height;}
+
+        // callback(uint32_t userData) is called for every proxy whose fat AABB intersects the given volume
+        template<class Callback> void Query(const Frustum& frustum, Callback&& callback) const {
+            QueryTree([&frustum](const Aabb& aabb){return frustum.Test(aabb);}, callback);
+        }
+        template<class Callback> void Query(const BoundingSphere& sphere, Callback&& callback) const {
+            QueryTree([&sphere](const Aabb& aabb){return sphere.Test(aabb);}, callback);
+        }
+        template<class Callback> void Query(const BoundingCone& cone, Callback&& callback) const {
+            QueryTree([&cone](const Aabb& aabb){return cone.Test(aabb);}, callback);
+        }
+
+    private:
+        struct Node {
+            Aabb aabb;
+            uint32_t userData;
+            int parent;
+            int child1;
+            int child2;
+            int next; // free list
+            int height; // 0 for leaves, -1 for free nodes
+
+            bool IsLeaf() const {return child1 == nullNode;}
+        };
+
+        std::vector<Node> nodes {};
+        int root = nullNode;
+        int freeList = nullNode;
+        int proxyCount = 0;
+
+        int AllocateNode();
+        void FreeNode(int node);
+        void InsertLeaf(int leaf);
+        void RemoveLeaf(int leaf);
+        int Balance(int node);
+
+        template<class Test, class Callback>
+        void QueryTree(Test&& test, Callback& callback) const {
+            if (root == nullNode) return;
+            std::vector<int> stack;
+            stack.reserve(64);
+            stack.push_back(root);
+            while (!stack.empty()) {
+                int index = stack.back();
+                stack.pop_back();
+                const Node& node = nodes[index];
+                switch (test(node.aabb)) {
+                    case OUTSIDE:
+                        break;
+                    case INSIDE:
+                        // The whole subtree is inside, no need to test its children
+                        ReportSubtree(index, callback);
+                        break;
+                    case INTERSECTS:
+                        if (node.IsLeaf()) {
+                            callback(node.userData);
+                        } else {
+                            stack.push_back(node.child1);
+                            stack.push_back(node.child2);
+                        }
+                        break;
+                }
+            }
+        }
+
+        template<class Callback>
+        void ReportSubtree(int index, Callback& callback) const {
+            const Node& node = nodes[index];
+            if (node.IsLeaf()) {
+                callback(node.userData);
+            } else {
+                ReportSubtree(node.child1, callback);
+                ReportSubtree(node.child2, callback);
+            }
+        }
+    };
+}
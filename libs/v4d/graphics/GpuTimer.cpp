@@ -0,0 +1,73 @@
+#include "libs/v4d/common.h"
+#include "GpuTimer.h"
+
+using namespace v4d::graphics;
+
+void GpuTimer::Create(Device* device, int framesInFlight, uint32_t maxSectionsPerFrame) {
+	auto limits = device->GetPhysicalDevice()->GetProperties().limits;
+	supported = limits.timestampComputeAndGraphics;
+	if (!supported) {
+		LOG_WARN("Timestamp queries are not supported, GPU timings will not be available")
+		return;
+	}
+	timestampPeriod = limits.timestampPeriod;
+	queriesPerFrame = maxSectionsPerFrame * 2;
+	frameSections.clear();
+	frameSections.resize(framesInFlight);
+	currentFrame = -1;
+
+	VkQueryPoolCreateInfo createInfo {};
+	createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	createInfo.queryCount = queriesPerFrame * framesInFlight;
+	if (device->CreateQueryPool(&createInfo, nullptr, &queryPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create query pool");
+}
+
+void GpuTimer::Destroy(Device* device) {
+	if (queryPool == VK_NULL_HANDLE) return;
+	device->DestroyQueryPool(queryPool, nullptr);
+	queryPool = VK_NULL_HANDLE;
+	frameSections.clear();
+}
+
+void GpuTimer::BeginFrame(Device* device, VkCommandBuffer commandBuffer, int frameInFlight) {
+	if (!supported) return;
+	currentFrame = frameInFlight;
+	auto& sections = frameSections[currentFrame];
+	uint32_t firstQuery = queriesPerFrame * currentFrame;
+
+	// Read back the previous use of this frame
+	for (auto& section : sections) if (section.stopped) {
+		uint64_t timestamps[2];
+		if (device->GetQueryPoolResults(queryPool, firstQuery + section.firstQuery, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+			timings[section.name] = double(timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0;
+		}
+	}
+	sections.clear();
+
+	device->CmdResetQueryPool(commandBuffer, queryPool, firstQuery, queriesPerFrame);
+}
+
+void GpuTimer::Start(Device* device, VkCommandBuffer commandBuffer, const std::string& section) {
+	if (!supported || currentFrame == -1) return;
+	auto& sections = frameSections[currentFrame];
+	if (sections.size() * 2 >= queriesPerFrame) return;
+	uint32_t query = sections.size() * 2;
+	sections.push_back({section, query, false});
+	device->CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, queriesPerFrame * currentFrame + query);
+}
+
+void GpuTimer::Stop(Device* device, VkCommandBuffer commandBuffer, const std::string& section) {
+	if (!supported || currentFrame == -1) return;
+	for (auto& s : frameSections[currentFrame]) if (s.name == section && !s.stopped) {
+		s.stopped = true;
+		device->CmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, queriesPerFrame * currentFrame + s.firstQuery + 1);
+		return;
+	}
+}
+
+double GpuTimer::GetMilliseconds(const std::string& section) const {
+	auto it = timings.find(section);
+	return it == timings.end() ? 0 : it->second;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "libs/v4d/common.h"
+
+namespace v4d::graphics {
+
+    // Measures the GPU time of named sections of the frame's command buffer with timestamp queries.
+    // Each frame in flight has its own queries, they are read back when the same frame is recorded again (its fence was waited on by then).
+    class GpuTimer {
+    public:
+        void Create(Device* device, int framesInFlight, uint32_t maxSectionsPerFrame = 16);
+        void Destroy(Device* device);
+
+        // Must be recorded before any section of the frame, outside of a render pass
+        void BeginFrame(Device* device, VkCommandBuffer commandBuffer, int frameInFlight);
+
+        void Start(Device* device, VkCommandBuffer commandBuffer, const std::string& section);
+        void Stop(Device* device, VkCommandBuffer commandBuffer, const std::string& section);
+
+        // Latest measured duration of a section in milliseconds, 0 if it was not measured yet
+        double GetMilliseconds(const std::string& section) const;
+        const std::map<std::string, double>& GetTimings() const {return timings;}
+
+    private:
+        struct Section {
+            std::string name;
+            uint32_t firstQuery;
+            bool stopped;
+        };
+
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        uint32_t queriesPerFrame = 0;
+        double timestampPeriod = 1; // nanoseconds per tick
+        bool supported = false;
+        int currentFrame = -1;
+        std::vector<std::vector<Section>> frameSections {};
+        std::map<std::string, double> timings {};
+    };
+
+}
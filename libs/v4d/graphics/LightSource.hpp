@@ -9,20 +9,54 @@ namespace v4d::graphics {
         POINT_LIGHT = 0,
         SPOT_LIGHT = 1,
         AMBIENT_SKYBOX = 2,
+        DIRECTIONAL_LIGHT = 3, // lights the whole scene from worldDirection, its position is unused
     };
 
-    struct LightSourcePushConstant {
-        alignas(4)	LightSourceType type;
+    // One light in the lights storage buffer (std430), which holds all the lights of a frame in camera space
+    struct LightSourceBufferData {
+        alignas(16)	vec3 viewPosition;
+        alignas(4)	float radius;
         alignas(16)	vec3 color;
         alignas(4)	float intensity;
-        alignas(16)	vec3 viewPosition;
-        alignas(4)	float innerAngle;
         alignas(16)	vec3 viewDirection;
+        alignas(4)	LightSourceType type;
+        alignas(4)	float innerAngle;
         alignas(4)	float outerAngle;
-        alignas(64) mat4 cameraViewToShadowMapMatrix {1};
+        alignas(4)	int32_t shadowMap; // index in the shadow maps storage buffer, -1 if the light casts no shadow
+    };
+    static_assert(sizeof(LightSourceBufferData) == 64);
+
+    // One shadow map in the shadow maps storage buffer (std430)
+    struct ShadowMapBufferData {
+        alignas(16)	mat4 cameraViewToShadowMapMatrix; // for point lights, to the light's position with the world's axes
+        alignas(16)	vec4 atlasRect; // offset and size in the shadow atlas, in uv coordinates (spot lights)
+        alignas(8)	vec2 cubeDepthProjection; // projection[2][2] and [3][2] of the cube's faces, to get the depth of a distance (point lights)
+        alignas(4)	int32_t layer; // index in the shadow cube array (point lights), or layer of the cascades image (directional light)
+        alignas(4)	float cascadeEnd; // distance from the camera along its view direction, up to which this cascade is used (directional light)
+        alignas(4)	int32_t cascadeCount; // the light's cascades are consecutive shadow maps (directional light)
+    };
+    static_assert(sizeof(ShadowMapBufferData) == 112);
+
+    // A range of lights in the lights storage buffer, shaded by lighting.frag in a single draw
+    struct LightBatchPushConstant {
+        alignas(4)	uint32_t firstLight;
+        alignas(4)	uint32_t lightCount;
     };
 
-    struct LightSource { // used as push constant, so maximum size is 128 bytes
+    // Screen tiles and depth slices that lights are binned into, shared by the clustering compute shader and the clustered lighting shader
+    struct LightClusterGridPushConstant {
+        alignas(8)	uvec2 screenSize;
+        alignas(4)	uint32_t tileSize; // in pixels
+        alignas(4)	uint32_t depthSlices; // exponentially distributed between zNear and zFar
+        alignas(4)	float zNear;
+        alignas(4)	float zFar;
+        alignas(4)	float projectionScaleX; // projectionMatrix[0][0]
+        alignas(4)	float projectionScaleY; // projectionMatrix[1][1]
+        alignas(4)	uint32_t lightCount;
+        alignas(4)	uint32_t maxLightsPerCluster;
+    };
+
+    struct LightSource {
         LightSourceType type;
         dvec3 worldPosition;
         vec3 color;
@@ -30,6 +64,7 @@ namespace v4d::graphics {
         vec3 worldDirection;
         float innerAngle;
         float outerAngle;
+        float radius; // distance at which the light has faded out completely, 0 means that it reaches everywhere
 
         LightSource(
             LightSourceType type, 
@@ -38,7 +73,8 @@ namespace v4d::graphics {
             float intensity = 1, 
             dvec3 worldDirection = dvec3{1},
             float innerAngle = 0, 
-            float outerAngle = 0
+            float outerAngle = 0,
+            float radius = 0
         ) : 
             type(type),
             worldPosition(worldPosition), 
@@ -46,27 +82,73 @@ namespace v4d::graphics {
             intensity(intensity), 
             worldDirection{worldDirection}, 
             innerAngle(innerAngle),
-            outerAngle(max(innerAngle, outerAngle))
+            outerAngle(max(innerAngle, outerAngle)),
+            radius(radius)
         {}
 
-        mat4 MakeLightProjectionMatrix() {
-            return mat4(Camera::MakeProjectionMatrix(outerAngle*2.0, 1.0, 0.5, 100.0));
+        // Distance beyond which the light has no effect, 0 if it reaches everywhere (no radius, ambient and directional lights)
+        float GetInfluenceRadius() const {
+            return (type == POINT_LIGHT || type == SPOT_LIGHT) ? radius : 0;
+        }
+
+        // Radius for a light of this intensity: where an inverse square falloff would have dimmed it below minIntensity.
+        // The lighting shaders' falloff is windowed to reach exactly 0 at the radius, so brighter lights reach further.
+        static float MakeRadius(float intensity, float minIntensity = 1.0f / 1024) {
+            return sqrt(max(intensity, 0.0f) / minIntensity);
         }
 
-        mat4 MakeLightViewMatrix(const Camera& camera) {
-            return mat4(lookAt(worldPosition, worldPosition + dvec3(normalize(worldDirection)), camera.viewUp));
+        // Distance covered by the light's shadow map
+        double GetShadowRange() const {
+            return radius > 0 ? radius : 100.0;
         }
 
-        LightSourcePushConstant MakePushConstantFromCamera(const Camera& camera) {
+        mat4 MakeLightProjectionMatrix() const {
+            return mat4(Camera::MakeProjectionMatrix(outerAngle*2.0, 1.0, 0.5, GetShadowRange()));
+        }
+
+        // Only depends on the light, so that cached shadow maps stay valid when the camera rolls.
+        // Up is the world's z, or x when the light points straight up or down.
+        mat4 MakeLightViewMatrix() const {
+            dvec3 direction = normalize(dvec3(worldDirection));
+            dvec3 up = abs(direction.z) < 0.99 ? dvec3(0,0,1) : dvec3(1,0,0);
+            return mat4(lookAt(worldPosition, worldPosition + direction, up));
+        }
+
+        mat4 MakeCameraViewToShadowMapMatrix(const Camera& camera) const {
+            return MakeLightProjectionMatrix() * MakeLightViewMatrix() * glm::mat4(inverse(camera.viewMatrix));
+        }
+
+        // Point lights, 90 degrees per cube face. Unlike the camera's, y is not flipped, so that faces match the cube map layout.
+        mat4 MakeShadowCubeProjectionMatrix() const {
+            mat4 projection = mat4(Camera::MakeProjectionMatrix(90.0, 1.0, 0.1, GetShadowRange()));
+            projection[1][1] *= -1;
+            return projection;
+        }
+
+        // Rotation from the world's axes to a cube face's view, faces are +X -X +Y -Y +Z -Z
+        static mat4 MakeShadowCubeFaceRotation(int face) {
+            static const vec3 directions[6] {{1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}};
+            static const vec3 ups[6] {{0,-1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}, {0,-1,0}, {0,-1,0}};
+            return lookAt(vec3(0), directions[face], ups[face]);
+        }
+
+        // The direction of this vector (in world axes) selects the cube's texel, the light's position is subtracted in double precision
+        mat4 MakeCameraViewToShadowCubeMatrix(const Camera& camera) const {
+            return mat4(translate(dmat4(1), -worldPosition) * inverse(camera.viewMatrix));
+        }
+
+        // The camera's matrices are the same for all the lights of a frame, normalMatrix = transpose(inverse(mat3(viewMatrix)))
+        LightSourceBufferData MakeBufferData(const dmat4& viewMatrix, const mat3& normalMatrix, int32_t shadowMap = -1) const {
             return {
-                type,
+                vec3(viewMatrix * dvec4(worldPosition, 1)),
+                radius,
                 color,
                 intensity,
-                camera.viewMatrix * vec4(worldPosition, 1),
+                normalMatrix * normalize(worldDirection),
+                type,
                 innerAngle,
-                transpose(inverse(mat3(camera.viewMatrix))) * normalize(worldDirection),
                 outerAngle,
-                MakeLightProjectionMatrix() * MakeLightViewMatrix(camera) * glm::mat4(inverse(camera.viewMatrix))
+                shadowMap,
             };
         }
     };
@@ -0,0 +1,80 @@
+#pragma once
+#include "../common.h"
+#include "Mesh.hpp"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    // Low-poly unit meshes that enclose a light's influence, they are placed and scaled by shaders/lighting.volume.vert.
+    // Faces are counter-clockwise seen from the outside, like the scene's meshes.
+    struct LightVolume {
+
+        // Icosphere that contains the unit sphere (its faces touch it from the outside)
+        static std::shared_ptr<Mesh> MakeSphere(int subdivisions = 1) {
+            const float t = (1.0f + sqrt(5.0f)) / 2.0f;
+            std::vector<vec3> positions {
+                {-1, t, 0}, { 1, t, 0}, {-1,-t, 0}, { 1,-t, 0},
+                { 0,-1, t}, { 0, 1, t}, { 0,-1,-t}, { 0, 1,-t},
+                { t, 0,-1}, { t, 0, 1}, {-t, 0,-1}, {-t, 0, 1},
+            };
+            for (auto& p : positions) p = normalize(p);
+            std::vector<uint32_t> indices {
+                0,11,5,  0,5,1,  0,1,7,  0,7,10,  0,10,11,
+                1,5,9,  5,11,4,  11,10,2,  10,7,6,  7,1,8,
+                3,9,4,  3,4,2,  3,2,6,  3,6,8,  3,8,9,
+                4,9,5,  2,4,11,  6,2,10,  8,6,7,  9,8,1,
+            };
+
+            // Split each triangle in 4, new vertices are pushed back on the sphere
+            for (int s = 0; s < subdivisions; ++s) {
+                std::map<std::pair<uint32_t, uint32_t>, uint32_t> midpoints;
+                auto midpoint = [&](uint32_t a, uint32_t b){
+                    auto [it, inserted] = midpoints.try_emplace({std::min(a, b), std::max(a, b)}, (uint32_t)positions.size());
+                    if (inserted) positions.push_back(normalize(positions[a] + positions[b]));
+                    return it->second;
+                };
+                std::vector<uint32_t> subdivided;
+                subdivided.reserve(indices.size() * 4);
+                for (size_t i = 0; i < indices.size(); i += 3) {
+                    uint32_t a = indices[i], b = indices[i+1], c = indices[i+2];
+                    uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+                    subdivided.insert(subdivided.end(), {a,ab,ca,  b,bc,ab,  c,ca,bc,  ab,bc,ca});
+                }
+                indices = std::move(subdivided);
+            }
+
+            // Push the faces out until the closest one touches the unit sphere
+            float minFaceDistance = 1;
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                const vec3& a = positions[indices[i]];
+                vec3 normal = normalize(cross(positions[indices[i+1]] - a, positions[indices[i+2]] - a));
+                minFaceDistance = std::min(minFaceDistance, dot(normal, a));
+            }
+
+            std::vector<Vertex> vertices;
+            vertices.reserve(positions.size());
+            for (auto& p : positions) vertices.emplace_back(p / minFaceDistance, p, vec3{0});
+            return std::make_shared<Mesh>(vertices, indices);
+        }
+
+        // Cone with its apex at the origin, opening towards +z, whose base contains the unit circle at z = 1
+        static std::shared_ptr<Mesh> MakeCone(int segments = 16) {
+            const float pi = 3.14159265358979f;
+            float ringRadius = 1.0f / cos(pi / segments);
+            std::vector<Vertex> vertices {
+                {/*apex*/{0,0,0}, {0,0,-1}, vec3{0}},
+                {/*base center*/{0,0,1}, {0,0,1}, vec3{0}},
+            };
+            std::vector<uint32_t> indices;
+            for (int i = 0; i < segments; ++i) {
+                float angle = 2.0f * pi * i / segments;
+                vertices.push_back({{ringRadius * cos(angle), ringRadius * sin(angle), 1}, {cos(angle), sin(angle), 0}, vec3{0}});
+                uint32_t current = 2 + i;
+                uint32_t next = 2 + (i + 1) % segments;
+                indices.insert(indices.end(), {0, next, current,  1, current, next});
+            }
+            return std::make_shared<Mesh>(vertices, indices);
+        }
+
+    };
+}
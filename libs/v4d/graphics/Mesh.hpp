@@ -0,0 +1,88 @@
+#pragma once
+#include "../common.h"
+#include "MeshData.h"
+#include "MeshFile.h"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    inline std::vector<VertexInputAttributeDescription> Vertex::GetInputAttributes() {
+        return {
+            {0, offsetof(Vertex, pos), VK_FORMAT_R32G32B32A32_SFLOAT},
+            {1, offsetof(Vertex, normal), VK_FORMAT_R32G32B32A32_SFLOAT},
+            {2, offsetof(Vertex, color), VK_FORMAT_R32G32B32A32_SFLOAT},
+        };
+    }
+
+    // Geometry data that may be shared by many scene objects (each object referencing the same mesh is drawn as an instance of it)
+    struct Mesh : MeshData {
+        std::shared_ptr<const void> externalData = nullptr;
+        bool resident = false; // only resident meshes are drawn, buffers of other meshes must not be touched
+
+        StagedBuffer vertexBuffer {VK_BUFFER_USAGE_VERTEX_BUFFER_BIT};
+        StagedBuffer indexBuffer {VK_BUFFER_USAGE_INDEX_BUFFER_BIT};
+
+        Mesh(std::vector<Vertex> v = {}, std::vector<uint32_t> i = {})
+        : MeshData(v, i) {
+            vertexBuffer.AddSrcDataPtr(&vertices);
+            indexBuffer.AddSrcDataPtr(&indices);
+        }
+
+        // Mesh whose data lives elsewhere (ie: a memory-mapped MeshFile), buffers are uploaded straight from there.
+        // externalData keeps that memory alive for as long as the mesh exists.
+        Mesh(const Vertex* vertexData, uint32_t vertexCount, const uint32_t* indexData, uint32_t indexCount, std::vector<MeshLod> lods, Aabb bounds, std::shared_ptr<const void> externalData)
+        : externalData(externalData) {
+            this->bounds = bounds;
+            this->lods = lods;
+            vertexBuffer.AddSrcDataPtr((void*)vertexData, vertexCount * sizeof(Vertex));
+            indexBuffer.AddSrcDataPtr((void*)indexData, indexCount * sizeof(uint32_t));
+        }
+
+        // Streamed meshes only know their bounds until a MeshStreamer loads their data
+        Mesh(Aabb bounds) {
+            this->bounds = bounds;
+        }
+
+        // Returns a mesh whose buffers are uploaded straight from the file mapping, which stays alive as long as the mesh does
+        static std::shared_ptr<Mesh> FromFile(const std::string& filePath) {
+            auto file = std::make_shared<MeshFile>(filePath);
+            const auto& header = file->GetHeader();
+            return std::make_shared<Mesh>(
+                file->GetVertices(), header.vertexCount,
+                file->GetIndices(), header.indexCount,
+                std::vector<MeshLod>(file->GetLods(), file->GetLods() + header.lodCount),
+                file->GetBounds(),
+                file
+            );
+        }
+
+        // Buffers keep pointers to our vectors, so a mesh must never be copied
+        Mesh(const Mesh&) = delete;
+        Mesh& operator=(const Mesh&) = delete;
+
+        // Must be called before AllocateBuffers.
+        void GenerateLods(int lodCount = 5, float reduction = 0.5f) {
+            if (vertices.empty() || indices.empty()) return; // buffers of meshes loaded from a file keep pointing to the file
+            MeshData::GenerateLods(lodCount, reduction);
+            indexBuffer.ResetSrcData();
+            indexBuffer.AddSrcDataPtr(&indices);
+        }
+
+        void AllocateBuffers(Device* device, Queue transferQueue) {
+            vertexBuffer.Allocate(device);
+            indexBuffer.Allocate(device);
+
+            auto cmdBuffer = device->BeginSingleTimeCommands(transferQueue);
+                vertexBuffer.Update(device, cmdBuffer);
+                indexBuffer.Update(device, cmdBuffer);
+            device->EndSingleTimeCommands(transferQueue, cmdBuffer);
+            resident = true;
+        }
+
+        void FreeBuffers(Device* device) {
+            resident = false;
+            vertexBuffer.Free(device);
+            indexBuffer.Free(device);
+        }
+    };
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "../core.h"
+#include "Bounds.hpp"
+#include "MeshSimplifier.h"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    namespace vulkan {
+        struct VertexInputAttributeDescription;
+    }
+
+    struct Vertex {
+		alignas(16) vec3 pos;
+		alignas(16) vec3 normal;
+		alignas(16) vec3 color;
+
+        Vertex(vec3 p, vec3 n, vec3 c) : pos(p), normal(n), color(c) {}
+
+		// Defined in Mesh.hpp, so that the vertex layout can be used without Vulkan (ie: by offline tools)
+		static std::vector<vulkan::VertexInputAttributeDescription> GetInputAttributes();
+    };
+
+    // Range of the index buffer making up one level of detail
+    struct MeshLod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error; // maximum distance (in object units) between this level and the full detail mesh
+    };
+
+    // Geometry of a mesh in system memory, without any device resources
+    struct MeshData {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        Aabb bounds {}; // in object space
+        std::vector<MeshLod> lods {}; // lods[0] is the full detail mesh, all levels are concatenated in indices and share the same vertices
+
+        MeshData() = default;
+        MeshData(std::vector<Vertex> v, std::vector<uint32_t> i)
+        : vertices(v), indices(i) {
+            if (vertices.size()) bounds = Aabb::FromPoints(&vertices[0].pos, vertices.size(), sizeof(Vertex));
+            lods.push_back({0, (uint32_t)indices.size(), 0});
+        }
+
+        // Generates up to lodCount-1 simplified levels, each having about half the triangles of the previous one.
+        void GenerateLods(int lodCount = 5, float reduction = 0.5f) {
+            if (vertices.empty() || indices.empty()) return; // meshes loaded from a file already have their levels
+            lods.resize(1);
+            indices.resize(lods[0].indexCount);
+            float maxError = bounds.GetRadius() * 0.5f;
+            std::vector<uint32_t> lodIndices(indices);
+            for (int i = 1; i < lodCount; ++i) {
+                const MeshLod& previous = lods.back();
+                size_t targetIndexCount = size_t(previous.indexCount * reduction) / 3 * 3;
+                float error = 0;
+                lodIndices = SimplifyMesh(&vertices[0].pos, vertices.size(), sizeof(Vertex), lodIndices, targetIndexCount, maxError, &error);
+                // Stop when simplification does not give us much anymore
+                if (lodIndices.size() == 0 || lodIndices.size() > previous.indexCount * 0.9) break;
+                // Each level is simplified from the previous one, so its deviation from LOD0 is bounded by the sum of the errors of the steps
+                lods.push_back({(uint32_t)indices.size(), (uint32_t)lodIndices.size(), previous.error + error});
+                indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+            }
+        }
+
+        // Returns the coarsest level whose error stays under maxPixelError on screen, pixelsPerUnit being the projected size of one object unit at the object's distance
+        uint32_t SelectLod(double pixelsPerUnit, double maxPixelError, int bias = 0) const {
+            uint32_t lod = 0;
+            while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= maxPixelError) lod++;
+            return (uint32_t)glm::clamp((int)lod + bias, 0, (int)lods.size() - 1);
+        }
+    };
+}
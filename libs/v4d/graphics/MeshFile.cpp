@@ -0,0 +1,135 @@
+#include "libs/v4d/core.h"
+#include "MeshFile.h"
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+using namespace v4d::graphics;
+
+MeshFile::MeshFile(const std::string& filePath) {
+	#ifdef _WIN32
+		fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Failed to open mesh file " + filePath);
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(fileHandle, &fileSize);
+		mappedSize = (size_t)fileSize.QuadPart;
+		if (mappedSize > 0) {
+			mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mappingHandle) mappedData = (const std::byte*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		}
+		if (!mappedData) {
+			if (mappingHandle) CloseHandle(mappingHandle);
+			CloseHandle(fileHandle);
+			throw std::runtime_error("Failed to map mesh file " + filePath);
+		}
+	#else
+		int fd = open(filePath.c_str(), O_RDONLY);
+		if (fd == -1)
+			throw std::runtime_error("Failed to open mesh file " + filePath);
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+			mappedSize = (size_t)fileStat.st_size;
+			void* data = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED) {
+				mappedData = (const std::byte*)data;
+				// We are going to read the whole file sequentially right away
+				madvise(data, mappedSize, MADV_SEQUENTIAL);
+				madvise(data, mappedSize, MADV_WILLNEED);
+			}
+		}
+		close(fd); // the mapping stays valid
+		if (!mappedData)
+			throw std::runtime_error("Failed to map mesh file " + filePath);
+	#endif
+
+	// Validate
+	auto fail = [this, &filePath](const std::string& reason){
+		Unmap();
+		throw std::runtime_error("Invalid mesh file " + filePath + " : " + reason);
+	};
+	if (mappedSize < sizeof(MeshFileHeader)) fail("too small");
+	const auto& header = GetHeader();
+	if (memcmp(header.magic, magic, sizeof(magic)) != 0) fail("not a mesh file");
+	if (header.version != version) fail("unsupported version " + std::to_string(header.version));
+	if (header.vertexStride != sizeof(Vertex)) fail("vertex stride " + std::to_string(header.vertexStride) + " does not match " + std::to_string(sizeof(Vertex)));
+	auto blobFits = [this](uint64_t offset, uint64_t size){return offset % blobAlignment == 0 && offset <= mappedSize && size <= mappedSize - offset;};
+	if (!blobFits(header.vertexOffset, uint64_t(header.vertexCount) * sizeof(Vertex))) fail("vertex data out of bounds");
+	if (!blobFits(header.indexOffset, uint64_t(header.indexCount) * sizeof(uint32_t))) fail("index data out of bounds");
+	if (!blobFits(header.lodOffset, uint64_t(header.lodCount) * sizeof(MeshLod))) fail("lod table out of bounds");
+	if (header.lodCount == 0) fail("no level of detail");
+	for (uint32_t i = 0; i < header.lodCount; ++i) {
+		const auto& lod = GetLods()[i];
+		if (uint64_t(lod.firstIndex) + lod.indexCount > header.indexCount) fail("level of detail " + std::to_string(i) + " out of bounds");
+	}
+}
+
+MeshFile::~MeshFile() {
+	Unmap();
+}
+
+void MeshFile::Unmap() {
+	if (!mappedData) return;
+	#ifdef _WIN32
+		UnmapViewOfFile(mappedData);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+	#else
+		munmap((void*)mappedData, mappedSize);
+	#endif
+	mappedData = nullptr;
+}
+
+Aabb MeshFile::GetBounds() const {
+	const auto& header = GetHeader();
+	return {
+		{header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]},
+		{header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]},
+	};
+}
+
+void MeshFile::Write(const std::string& filePath, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const MeshLod* lods, uint32_t lodCount, const Aabb& bounds) {
+	auto align = [](uint64_t offset){return (offset + blobAlignment - 1) / blobAlignment * blobAlignment;};
+
+	MeshFileHeader header {};
+	memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.vertexStride = sizeof(Vertex);
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.lodCount = lodCount;
+	header.vertexOffset = align(sizeof(MeshFileHeader));
+	header.indexOffset = align(header.vertexOffset + uint64_t(vertexCount) * sizeof(Vertex));
+	header.lodOffset = align(header.indexOffset + uint64_t(indexCount) * sizeof(uint32_t));
+	for (int i = 0; i < 3; ++i) {
+		header.boundsMin[i] = bounds.min[i];
+		header.boundsMax[i] = bounds.max[i];
+	}
+
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open mesh file " + filePath + " for writing");
+
+	auto writeAt = [&file](uint64_t offset, const void* data, size_t size){
+		static const char padding[blobAlignment] {};
+		uint64_t position = (uint64_t)file.tellp();
+		if (offset > position) file.write(padding, offset - position);
+		file.write((const char*)data, size);
+	};
+	writeAt(0, &header, sizeof(header));
+	writeAt(header.vertexOffset, vertices, size_t(vertexCount) * sizeof(Vertex));
+	writeAt(header.indexOffset, indices, size_t(indexCount) * sizeof(uint32_t));
+	writeAt(header.lodOffset, lods, size_t(lodCount) * sizeof(MeshLod));
+
+	if (!file.good())
+		throw std::runtime_error("Failed to write mesh file " + filePath);
+}
+
+void MeshFile::Write(const std::string& filePath, const MeshData& mesh) {
+	if (mesh.vertices.empty())
+		throw std::runtime_error("Cannot write mesh file " + filePath + " : mesh has no vertex data of its own");
+	Write(filePath, mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), mesh.lods.data(), mesh.lods.size(), mesh.bounds);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "libs/v4d/core.h"
+#include "MeshData.h"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    // Binary mesh container (.v4dmesh), laid out so that loading is only a memory mapping:
+    //   MeshFileHeader
+    //   Vertex[vertexCount]   at vertexOffset, in the exact layout of the vertex buffer
+    //   uint32_t[indexCount]  at indexOffset, all levels of detail concatenated
+    //   MeshLod[lodCount]     at lodOffset
+    // Every blob starts on a multiple of blobAlignment.
+    struct MeshFileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexStride; // sizeof(Vertex) of the writer, files are rejected if it does not match ours
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t lodCount;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t lodOffset;
+        float boundsMin[3];
+        float boundsMax[3];
+        uint32_t reserved[2];
+    };
+    static_assert(sizeof(MeshFileHeader) == 80);
+    static_assert(sizeof(MeshLod) == 12);
+
+    class MeshFile {
+        const std::byte* mappedData = nullptr;
+        size_t mappedSize = 0;
+        #ifdef _WIN32
+            HANDLE fileHandle = INVALID_HANDLE_VALUE;
+            HANDLE mappingHandle = NULL;
+        #endif
+
+    public:
+        static constexpr char magic[4] = {'V','4','D','M'};
+        static const uint32_t version = 1;
+        static const size_t blobAlignment = 256;
+
+        // Maps the whole file in memory and validates it, throws on failure
+        MeshFile(const std::string& filePath);
+        ~MeshFile();
+
+        MeshFile(const MeshFile&) = delete;
+        MeshFile& operator=(const MeshFile&) = delete;
+
+        const MeshFileHeader& GetHeader() const {return *(const MeshFileHeader*)mappedData;}
+        const Vertex* GetVertices() const {return (const Vertex*)(mappedData + GetHeader().vertexOffset);}
+        const uint32_t* GetIndices() const {return (const uint32_t*)(mappedData + GetHeader().indexOffset);}
+        const MeshLod* GetLods() const {return (const MeshLod*)(mappedData + GetHeader().lodOffset);}
+        Aabb GetBounds() const;
+        size_t GetSize() const {return mappedSize;}
+
+        static void Write(const std::string& filePath, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const MeshLod* lods, uint32_t lodCount, const Aabb& bounds);
+        static void Write(const std::string& filePath, const MeshData& mesh);
+
+    private:
+        void Unmap();
+    };
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include "../common.h"
+#include "PrimitiveGeometry.hpp"
+#include "../utilities/ThreadPool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #define V4D_MESH_INSTANCING_SSE
+    #include <xmmintrin.h>
+#endif
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    // Per-instance vertex data, bound with VK_VERTEX_INPUT_RATE_INSTANCE
+    struct MeshInstance {
+        mat4 modelViewMatrix {1};
+        vec4 normalMatrix[3] {{1,0,0,0}, {0,1,0,0}, {0,0,1,0}}; // mat3 columns, padded to vec4, the first padding holds the layer (see SetLayer)
+
+		static std::vector<VertexInputAttributeDescription> GetInputAttributes() {
+			return {
+				// a mat4 attribute takes 4 consecutive locations (one per column), right after the Vertex attributes
+				{3, offsetof(MeshInstance, modelViewMatrix) + sizeof(vec4)*0, VK_FORMAT_R32G32B32A32_SFLOAT},
+				{4, offsetof(MeshInstance, modelViewMatrix) + sizeof(vec4)*1, VK_FORMAT_R32G32B32A32_SFLOAT},
+				{5, offsetof(MeshInstance, modelViewMatrix) + sizeof(vec4)*2, VK_FORMAT_R32G32B32A32_SFLOAT},
+				{6, offsetof(MeshInstance, modelViewMatrix) + sizeof(vec4)*3, VK_FORMAT_R32G32B32A32_SFLOAT},
+				{7, offsetof(MeshInstance, normalMatrix) + sizeof(vec4)*0, VK_FORMAT_R32G32B32_SFLOAT},
+				{8, offsetof(MeshInstance, normalMatrix) + sizeof(vec4)*1, VK_FORMAT_R32G32B32_SFLOAT},
+				{9, offsetof(MeshInstance, normalMatrix) + sizeof(vec4)*2, VK_FORMAT_R32G32B32_SFLOAT},
+			};
+		}
+
+		// For layered depth-only rendering, the normal matrix is replaced by the layer at location 7
+		static std::vector<VertexInputAttributeDescription> GetLayeredInputAttributes() {
+			return {
+				{3, offsetof(MeshInstance, modelViewMatrix) + sizeof(vec4)*0, VK_FORMAT_R32G32B32A32_SFLOAT},
+				{4, offsetof(MeshInstance, modelViewMatrix) + sizeof(vec4)*1, VK_FORMAT_R32G32B32A32_SFLOAT},
+				{5, offsetof(MeshInstance, modelViewMatrix) + sizeof(vec4)*2, VK_FORMAT_R32G32B32A32_SFLOAT},
+				{6, offsetof(MeshInstance, modelViewMatrix) + sizeof(vec4)*3, VK_FORMAT_R32G32B32A32_SFLOAT},
+				{7, offsetof(MeshInstance, normalMatrix) + sizeof(vec3), VK_FORMAT_R32_SFLOAT},
+			};
+		}
+
+        // Layer of a layered framebuffer that the instance is drawn to, must be set after SetTransform()
+        void SetLayer(uint32_t layer) {
+            normalMatrix[0].w = float(layer);
+        }
+
+        // viewRotation must not contain any translation and the translation of modelMatrix must be relative to the viewer,
+        // so that large world coordinates are subtracted in double precision before ever reaching single precision.
+        void SetTransform(const mat4& viewRotation, const mat4& modelMatrix) {
+            #ifdef V4D_MESH_INSTANCING_SSE
+                __m128 v0 = _mm_loadu_ps(&viewRotation[0][0]);
+                __m128 v1 = _mm_loadu_ps(&viewRotation[1][0]);
+                __m128 v2 = _mm_loadu_ps(&viewRotation[2][0]);
+                __m128 v3 = _mm_loadu_ps(&viewRotation[3][0]);
+                for (int c = 0; c < 4; ++c) {
+                    __m128 r = _mm_mul_ps(v0, _mm_set1_ps(modelMatrix[c][0]));
+                    r = _mm_add_ps(r, _mm_mul_ps(v1, _mm_set1_ps(modelMatrix[c][1])));
+                    r = _mm_add_ps(r, _mm_mul_ps(v2, _mm_set1_ps(modelMatrix[c][2])));
+                    r = _mm_add_ps(r, _mm_mul_ps(v3, _mm_set1_ps(modelMatrix[c][3])));
+                    _mm_storeu_ps(&modelViewMatrix[c][0], r);
+                }
+            #else
+                modelViewMatrix = viewRotation * modelMatrix;
+            #endif
+
+            // The inverse transpose of the upper 3x3 is its cofactor matrix divided by its determinant
+            vec3 c0(modelViewMatrix[0]), c1(modelViewMatrix[1]), c2(modelViewMatrix[2]);
+            vec3 n0 = cross(c1, c2), n1 = cross(c2, c0), n2 = cross(c0, c1);
+            float det = dot(c0, n0);
+            float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+            normalMatrix[0] = vec4(n0 * invDet, 0);
+            normalMatrix[1] = vec4(n1 * invDet, 0);
+            normalMatrix[2] = vec4(n2 * invDet, 0);
+        }
+    };
+
+    // Push constant shared by all instances of a draw
+    struct MeshInstancePushConstant {
+        mat4 projectionMatrix {1};
+    };
+
+    // One instanced draw call
+    struct MeshBatch {
+        Mesh* mesh;
+        uint32_t lod;
+        uint32_t firstInstance; // relative to MeshInstanceList::baseInstance
+        uint32_t instanceCount;
+    };
+
+    // Groups objects by mesh and level of detail so that all objects sharing a mesh are drawn with one instanced draw call per level
+    struct MeshInstanceList {
+        std::vector<MeshInstance> instances {};
+        std::vector<MeshBatch> batches {};
+        uint32_t baseInstance = 0; // index of our first instance within the instance buffer, assigned by Write()
+
+        void Clear() {
+            instances.clear();
+            batches.clear();
+        }
+
+        // makeInstance(const PrimitiveGeometry&) must return the MeshInstance for that object,
+        // or makeInstance(size_t, const PrimitiveGeometry&) with the object's index when the same object is listed more than once
+        // selectLod(const PrimitiveGeometry&) must return the level of detail to draw that object with
+        // Both are called from the threadPool's threads if one is given, so they must not modify anything shared
+        template<class InstanceFunc, class LodFunc>
+        void Build(const std::vector<PrimitiveGeometry*>& objects, InstanceFunc&& makeInstance, LodFunc&& selectLod, v4d::utilities::ThreadPool* threadPool = nullptr) {
+            Clear();
+            batchIndices.clear();
+            objectSlots.resize(objects.size());
+
+            auto forEachObject = [&objects, threadPool](auto&& func) {
+                auto run = [&objects, &func](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) func(i, *objects[i]);
+                };
+                if (threadPool) threadPool->ParallelFor(objects.size(), 256, run);
+                else run(0, objects.size());
+            };
+
+            // Select levels of detail
+            forEachObject([&](size_t i, const PrimitiveGeometry& obj){
+                objectSlots[i] = (obj.mesh && obj.mesh->resident) ? (int)std::min(selectLod(obj), (uint32_t)obj.mesh->lods.size() - 1) : -1;
+            });
+
+            // Count instances per mesh and level of detail
+            for (size_t i = 0; i < objects.size(); ++i) {
+                if (objectSlots[i] == -1) continue;
+                auto [it, inserted] = batchIndices.try_emplace({objects[i]->mesh.get(), (uint32_t)objectSlots[i]}, (uint32_t)batches.size());
+                if (inserted) batches.push_back({objects[i]->mesh.get(), (uint32_t)objectSlots[i], 0, 0});
+                batches[it->second].instanceCount++;
+                objectSlots[i] = (int)it->second;
+            }
+
+            // Assign a contiguous range of instances to each batch
+            uint32_t instanceCount = 0;
+            for (auto& batch : batches) {
+                batch.firstInstance = instanceCount;
+                instanceCount += batch.instanceCount;
+                batch.instanceCount = 0;
+            }
+
+            // Assign each object its instance slot
+            for (size_t i = 0; i < objects.size(); ++i) {
+                if (objectSlots[i] == -1) continue;
+                auto& batch = batches[objectSlots[i]];
+                objectSlots[i] = (int)(batch.firstInstance + batch.instanceCount++);
+            }
+
+            // Fill instances
+            instances.resize(instanceCount);
+            forEachObject([&](size_t i, const PrimitiveGeometry& obj){
+                if (objectSlots[i] == -1) return;
+                if constexpr (std::is_invocable_v<InstanceFunc, size_t, const PrimitiveGeometry&>) instances[objectSlots[i]] = makeInstance(i, obj);
+                else instances[objectSlots[i]] = makeInstance(obj);
+            });
+        }
+
+        // Copies our instances into a mapped instance buffer and returns how many were written (batches that do not fit are trimmed)
+        uint32_t Write(MeshInstance* dst, uint32_t baseInstance, uint32_t capacity) {
+            this->baseInstance = baseInstance;
+            uint32_t count = std::min((uint32_t)instances.size(), capacity);
+            if (count < instances.size()) {
+                LOG_WARN("Instance buffer is full, " << (instances.size() - count) << " instances will not be drawn")
+                for (auto& batch : batches) {
+                    if (batch.firstInstance >= count) batch.instanceCount = 0;
+                    else batch.instanceCount = std::min(batch.instanceCount, count - batch.firstInstance);
+                }
+            }
+            memcpy(dst, instances.data(), count * sizeof(MeshInstance));
+            return count;
+        }
+
+    private:
+        std::map<std::pair<Mesh*, uint32_t>, uint32_t> batchIndices {};
+        std::vector<int> objectSlots {};
+    };
+}
@@ -0,0 +1,183 @@
+#include "libs/v4d/core.h"
+#include "MeshSimplifier.h"
+
+#include <numeric>
+
+using namespace v4d::graphics;
+
+namespace {
+	// Symmetric 4x4 matrix, the sum of squared distances to a set of planes
+	struct Quadric {
+		double a2 = 0, b2 = 0, c2 = 0, d2 = 0, ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0;
+
+		static Quadric FromPlane(dvec3 n, double d) {
+			return {n.x*n.x, n.y*n.y, n.z*n.z, d*d, n.x*n.y, n.x*n.z, n.x*d, n.y*n.z, n.y*d, n.z*d};
+		}
+
+		Quadric& operator+=(const Quadric& q) {
+			a2 += q.a2; b2 += q.b2; c2 += q.c2; d2 += q.d2;
+			ab += q.ab; ac += q.ac; ad += q.ad;
+			bc += q.bc; bd += q.bd; cd += q.cd;
+			return *this;
+		}
+
+		Quadric operator+(const Quadric& q) const {
+			Quadric r = *this;
+			return r += q;
+		}
+
+		double Evaluate(dvec3 p) const {
+			double error = a2*p.x*p.x + b2*p.y*p.y + c2*p.z*p.z
+				+ 2.0 * (ab*p.x*p.y + ac*p.x*p.z + bc*p.y*p.z)
+				+ 2.0 * (ad*p.x + bd*p.y + cd*p.z)
+				+ d2;
+			return std::max(0.0, error);
+		}
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+}
+
+std::vector<uint32_t> v4d::graphics::SimplifyMesh(
+	const vec3* positions, size_t vertexCount, size_t stride,
+	const std::vector<uint32_t>& indices,
+	size_t targetIndexCount,
+	float maxError,
+	float* resultError
+) {
+	auto position = [positions, stride](uint32_t i) -> dvec3 {
+		return dvec3(*(const vec3*)((const char*)positions + i * stride));
+	};
+
+	std::vector<uint32_t> result = indices;
+	double resultCost = 0;
+
+	// Initial quadrics are the planes of the triangles around each vertex
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i + 2 < result.size(); i += 3) {
+		dvec3 p0 = position(result[i]), p1 = position(result[i+1]), p2 = position(result[i+2]);
+		dvec3 n = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(n);
+		if (length == 0) continue;
+		n /= length;
+		Quadric q = Quadric::FromPlane(n, -glm::dot(n, p0));
+		quadrics[result[i]] += q;
+		quadrics[result[i+1]] += q;
+		quadrics[result[i+2]] += q;
+	}
+
+	// Lock vertices on border or non-manifold edges
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<uint64_t, int> edgeCounts;
+		edgeCounts.reserve(result.size());
+		auto edgeKey = [](uint32_t a, uint32_t b){return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);};
+		for (size_t i = 0; i + 2 < result.size(); i += 3) {
+			for (int e = 0; e < 3; ++e) {
+				edgeCounts[edgeKey(result[i+e], result[i+(e+1)%3])]++;
+			}
+		}
+		for (auto [key, count] : edgeCounts) {
+			if (count != 2) {
+				locked[key >> 32] = true;
+				locked[key & 0xffffffff] = true;
+			}
+		}
+	}
+
+	double maxCost = double(maxError) * double(maxError);
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<bool> touched(vertexCount);
+
+	while (result.size() > targetIndexCount) {
+
+		// Triangles around each vertex
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t v : result) adjacencyOffsets[v + 1]++;
+		std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+		adjacency.resize(result.size());
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i) {
+				adjacency[fill[result[i]]++] = uint32_t(i / 3);
+			}
+		}
+
+		// Candidate collapses, the cheapest direction of each edge
+		collapses.clear();
+		for (size_t i = 0; i + 2 < result.size(); i += 3) {
+			for (int e = 0; e < 3; ++e) {
+				uint32_t a = result[i+e], b = result[i+(e+1)%3];
+				if (a > b) continue; // interior edges are seen from both of their triangles
+				double costAB = locked[a] ? -1 : (quadrics[a] + quadrics[b]).Evaluate(position(b));
+				double costBA = locked[b] ? -1 : (quadrics[a] + quadrics[b]).Evaluate(position(a));
+				if (costAB >= 0 && (costBA < 0 || costAB <= costBA)) collapses.push_back({a, b, costAB});
+				else if (costBA >= 0) collapses.push_back({b, a, costBA});
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b){return a.cost < b.cost;});
+
+		// Perform as many independent collapses as possible in this pass
+		std::iota(remap.begin(), remap.end(), 0);
+		std::fill(touched.begin(), touched.end(), false);
+		size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+		size_t trianglesRemoved = 0;
+		for (auto& collapse : collapses) {
+			if (collapse.cost > maxCost) break;
+			if (touched[collapse.from] || touched[collapse.to]) continue;
+
+			// Reject collapses that would flip a triangle
+			bool flips = false;
+			size_t removed = 0;
+			dvec3 newPosition = position(collapse.to);
+			for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; ++a) {
+				const uint32_t* tri = &result[adjacency[a] * 3];
+				if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+					removed++;
+					continue;
+				}
+				dvec3 p[3] = {position(tri[0]), position(tri[1]), position(tri[2])};
+				dvec3 oldNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+				for (int k = 0; k < 3; ++k) if (tri[k] == collapse.from) p[k] = newPosition;
+				dvec3 newNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+				if (glm::dot(oldNormal, newNormal) <= 0) flips = true;
+			}
+			if (flips) continue;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to] += quadrics[collapse.from];
+			resultCost = std::max(resultCost, collapse.cost);
+
+			// Lock the neighbourhood for the rest of this pass, so that flip checks stay valid
+			for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; ++a) {
+				const uint32_t* tri = &result[adjacency[a] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+
+			trianglesRemoved += removed;
+			if (trianglesRemoved >= trianglesToRemove) break;
+		}
+		if (trianglesRemoved == 0) break;
+
+		// Apply collapses and remove degenerate triangles
+		size_t writeIndex = 0;
+		for (size_t i = 0; i + 2 < result.size(); i += 3) {
+			uint32_t a = remap[result[i]], b = remap[result[i+1]], c = remap[result[i+2]];
+			if (a == b || b == c || c == a) continue;
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+		result.resize(writeIndex);
+	}
+
+	if (resultError) *resultError = float(glm::sqrt(resultCost));
+	return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "libs/v4d/core.h"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    // Quadric error metric mesh simplification (Garland & Heckbert) using half-edge collapses.
+    // Vertices are only ever collapsed onto other existing vertices, so the resulting index list references the same vertex buffer as the input.
+    // Vertices on borders and attribute seams (edges used by a single triangle) are locked so that the silhouette and seams are preserved.
+    //   positions/stride : vertex positions, stride is the size in bytes of a vertex
+    //   targetIndexCount : stops when the index count reaches this
+    //   maxError : maximum distance (in object units) that a collapse may move the surface
+    //   resultError : if not null, receives the largest error of all collapses that were performed
+    std::vector<uint32_t> SimplifyMesh(
+        const vec3* positions, size_t vertexCount, size_t stride,
+        const std::vector<uint32_t>& indices,
+        size_t targetIndexCount,
+        float maxError,
+        float* resultError = nullptr
+    );
+}
@@ -0,0 +1,296 @@
+#include "libs/v4d/common.h"
+#include "MeshStreamer.h"
+
+using namespace v4d::graphics;
+
+MeshStreamer::~MeshStreamer() {
+	if (device) Release();
+}
+
+std::shared_ptr<Mesh> MeshStreamer::AddMesh(const std::string& filePath) {
+	MeshFileHeader header {};
+	std::ifstream file(filePath, std::ios::binary);
+	file.read((char*)&header, sizeof(header));
+	if (!file || memcmp(header.magic, MeshFile::magic, sizeof(MeshFile::magic)) != 0)
+		throw std::runtime_error("Invalid mesh file " + filePath);
+
+	auto mesh = std::make_shared<Mesh>(Aabb{
+		{header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]},
+		{header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]},
+	});
+
+	auto& streamedMesh = streamedMeshes.emplace_back(std::make_unique<StreamedMesh>());
+	streamedMesh->mesh = mesh;
+	streamedMesh->filePath = filePath;
+	streamedMesh->size = header.vertexCount * sizeof(Vertex) + header.indexCount * sizeof(uint32_t);
+	streamedMeshesByPtr[mesh.get()] = streamedMesh.get();
+	return mesh;
+}
+
+void MeshStreamer::Clear() {
+	if (device) Release();
+	streamedMeshesByPtr.clear();
+	streamedMeshes.clear();
+}
+
+void MeshStreamer::Init(Device* device, Queue transferQueue) {
+	this->device = device;
+	this->transferQueue = transferQueue;
+	device->CreateCommandPool(transferQueue.familyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &commandPool);
+}
+
+void MeshStreamer::Release() {
+	if (!device) return;
+	for (auto& streamedMesh : streamedMeshes) {
+		auto& mesh = *streamedMesh->mesh;
+		switch (streamedMesh->state) {
+			case LOADING:
+				try {
+					streamedMesh->load.get();
+				} catch (...) {} // the loader already cleaned up
+				FreeStagingBuffers(mesh);
+				break;
+			case UPLOADING:
+				device->WaitForFences(1, &streamedMesh->fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+				device->DestroyFence(streamedMesh->fence, nullptr);
+				device->FreeCommandBuffers(commandPool, 1, &streamedMesh->commandBuffer);
+				streamedMesh->fence = VK_NULL_HANDLE;
+				streamedMesh->commandBuffer = VK_NULL_HANDLE;
+				FreeStagingBuffers(mesh);
+				break;
+			default: break;
+		}
+		mesh.resident = false;
+		mesh.vertexBuffer.deviceLocalBuffer.Free(device);
+		mesh.indexBuffer.deviceLocalBuffer.Free(device);
+		if (streamedMesh->state != FAILED) streamedMesh->state = NOT_RESIDENT;
+	}
+	for (auto& pendingFree : pendingFrees) {
+		pendingFree.vertexBuffer.Free(device);
+		pendingFree.indexBuffer.Free(device);
+	}
+	pendingFrees.clear();
+	residentBytes = 0;
+	uploadingBytes = 0;
+	device->DestroyCommandPool(commandPool);
+	device = nullptr;
+}
+
+void MeshStreamer::RequestResidency(Mesh* mesh, double distance) {
+	auto it = streamedMeshesByPtr.find(mesh);
+	if (it == streamedMeshesByPtr.end()) return;
+	auto* streamedMesh = it->second;
+	if (streamedMesh->lastRequestedFrame != frame || distance < streamedMesh->distance) {
+		streamedMesh->distance = distance;
+	}
+	streamedMesh->lastRequestedFrame = frame;
+}
+
+void MeshStreamer::Update() {
+	if (!device) return;
+	stats.loadedThisFrame = 0;
+	stats.evictedThisFrame = 0;
+	changedMeshes.clear();
+
+	// Free the buffers of evicted meshes that no frame in flight uses anymore
+	pendingFrees.erase(std::remove_if(pendingFrees.begin(), pendingFrees.end(), [this](PendingFree& pendingFree){
+		if (frame < pendingFree.frame) return false;
+		pendingFree.vertexBuffer.Free(device);
+		pendingFree.indexBuffer.Free(device);
+		return true;
+	}), pendingFrees.end());
+
+	// Poll loads and upload tickets
+	for (auto& streamedMesh : streamedMeshes) {
+		if (streamedMesh->state == LOADING && streamedMesh->load.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			SubmitUpload(*streamedMesh);
+		} else if (streamedMesh->state == UPLOADING && device->GetFenceStatus(streamedMesh->fence) == VK_SUCCESS) {
+			FinishUpload(*streamedMesh);
+		}
+	}
+
+	// Evict meshes that were not needed for a while
+	for (auto& streamedMesh : streamedMeshes) {
+		if (streamedMesh->state == RESIDENT && frame - streamedMesh->lastRequestedFrame > (uint64_t)evictionDelay) {
+			Evict(*streamedMesh);
+		}
+	}
+
+	// Start loading the closest requested meshes
+	std::vector<StreamedMesh*> candidates;
+	int loadingCount = 0;
+	VkDeviceSize loadingBytes = 0;
+	for (auto& streamedMesh : streamedMeshes) {
+		if (streamedMesh->state == LOADING) {
+			loadingCount++;
+			loadingBytes += streamedMesh->size;
+		} else if (streamedMesh->state == NOT_RESIDENT && streamedMesh->lastRequestedFrame == frame) {
+			candidates.push_back(streamedMesh.get());
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](StreamedMesh* a, StreamedMesh* b){return a->distance < b->distance;});
+	for (auto* candidate : candidates) {
+		if (loadingCount >= maxConcurrentLoads) break;
+		if (candidate->size > memoryBudget) continue;
+
+		// Make room by evicting resident meshes that are not needed this frame, then those that are farther than this one
+		while (residentBytes + uploadingBytes + loadingBytes + candidate->size > memoryBudget) {
+			StreamedMesh* victim = nullptr;
+			for (auto& streamedMesh : streamedMeshes) {
+				if (streamedMesh->state != RESIDENT) continue;
+				bool needed = streamedMesh->lastRequestedFrame == frame;
+				if (needed && streamedMesh->distance <= candidate->distance) continue;
+				if (!victim) {
+					victim = streamedMesh.get();
+					continue;
+				}
+				bool victimNeeded = victim->lastRequestedFrame == frame;
+				if (needed != victimNeeded) {
+					if (!needed) victim = streamedMesh.get();
+				} else if (needed) {
+					if (streamedMesh->distance > victim->distance) victim = streamedMesh.get();
+				} else {
+					if (streamedMesh->lastRequestedFrame < victim->lastRequestedFrame) victim = streamedMesh.get();
+				}
+			}
+			if (!victim) break;
+			Evict(*victim);
+		}
+		if (residentBytes + uploadingBytes + loadingBytes + candidate->size > memoryBudget) continue;
+
+		StartLoad(*candidate);
+		loadingCount++;
+		loadingBytes += candidate->size;
+	}
+
+	// Stats
+	stats.registeredMeshes = streamedMeshes.size();
+	stats.residentMeshes = 0;
+	stats.loadingMeshes = 0;
+	stats.uploadingMeshes = 0;
+	for (auto& streamedMesh : streamedMeshes) {
+		if (streamedMesh->state == RESIDENT) stats.residentMeshes++;
+		else if (streamedMesh->state == LOADING) stats.loadingMeshes++;
+		else if (streamedMesh->state == UPLOADING) stats.uploadingMeshes++;
+	}
+	stats.residentBytes = residentBytes;
+
+	frame++;
+}
+
+void MeshStreamer::StartLoad(StreamedMesh& streamedMesh) {
+	streamedMesh.state = LOADING;
+	Mesh* mesh = streamedMesh.mesh.get();
+	Device* device = this->device;
+	std::string filePath = streamedMesh.filePath;
+
+	// The mesh's buffers belong to the loader thread until the load completes, the render thread does not touch them since the mesh is not resident
+	streamedMesh.load = threadPool.Enqueue([mesh, device, filePath]() -> std::shared_ptr<MeshFile> {
+		auto file = std::make_shared<MeshFile>(filePath);
+		const auto& header = file->GetHeader();
+
+		auto fill = [device](StagedBuffer& buffer, const void* data, VkDeviceSize size){
+			buffer.stagingBuffer.size = size;
+			buffer.deviceLocalBuffer.size = size;
+			buffer.Allocate(device);
+			// Reading from the mapping is where the disk is actually read
+			memcpy(buffer.stagingBuffer.data, data, size);
+		};
+		try {
+			fill(mesh->vertexBuffer, file->GetVertices(), header.vertexCount * sizeof(Vertex));
+			fill(mesh->indexBuffer, file->GetIndices(), header.indexCount * sizeof(uint32_t));
+		} catch (...) {
+			for (auto* buffer : {&mesh->vertexBuffer, &mesh->indexBuffer}) {
+				if (buffer->stagingBuffer.data) buffer->stagingBuffer.UnmapMemory(device);
+				buffer->stagingBuffer.Free(device);
+				buffer->deviceLocalBuffer.Free(device);
+			}
+			throw;
+		}
+		return file;
+	});
+}
+
+void MeshStreamer::SubmitUpload(StreamedMesh& streamedMesh) {
+	auto& mesh = *streamedMesh.mesh;
+	std::shared_ptr<MeshFile> file;
+	try {
+		file = streamedMesh.load.get();
+	} catch (std::exception& e) {
+		LOG_ERROR("Failed to stream mesh " << streamedMesh.filePath << " : " << e.what())
+		streamedMesh.state = FAILED;
+		return;
+	}
+
+	// The lod table is tiny and was already read while validating the file
+	const auto& header = file->GetHeader();
+	mesh.lods.assign(file->GetLods(), file->GetLods() + header.lodCount);
+	streamedMesh.size = mesh.vertexBuffer.deviceLocalBuffer.size + mesh.indexBuffer.deviceLocalBuffer.size;
+
+	VkCommandBufferAllocateInfo allocInfo {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+	device->AllocateCommandBuffers(&allocInfo, &streamedMesh.commandBuffer);
+
+	VkCommandBufferBeginInfo beginInfo {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	device->BeginCommandBuffer(streamedMesh.commandBuffer, &beginInfo);
+		Buffer::Copy(device, streamedMesh.commandBuffer, mesh.vertexBuffer.stagingBuffer, mesh.vertexBuffer.deviceLocalBuffer);
+		Buffer::Copy(device, streamedMesh.commandBuffer, mesh.indexBuffer.stagingBuffer, mesh.indexBuffer.deviceLocalBuffer);
+	device->EndCommandBuffer(streamedMesh.commandBuffer);
+
+	VkFenceCreateInfo fenceInfo {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (device->CreateFence(&fenceInfo, nullptr, &streamedMesh.fence) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create fence");
+
+	VkSubmitInfo submitInfo {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &streamedMesh.commandBuffer;
+	if (device->QueueSubmit(transferQueue.handle, 1, &submitInfo, streamedMesh.fence) != VK_SUCCESS)
+		throw std::runtime_error("Failed to submit mesh upload");
+
+	streamedMesh.state = UPLOADING;
+	uploadingBytes += streamedMesh.size;
+}
+
+void MeshStreamer::FinishUpload(StreamedMesh& streamedMesh) {
+	auto& mesh = *streamedMesh.mesh;
+	device->DestroyFence(streamedMesh.fence, nullptr);
+	device->FreeCommandBuffers(commandPool, 1, &streamedMesh.commandBuffer);
+	streamedMesh.fence = VK_NULL_HANDLE;
+	streamedMesh.commandBuffer = VK_NULL_HANDLE;
+	FreeStagingBuffers(mesh);
+
+	uploadingBytes -= streamedMesh.size;
+	residentBytes += streamedMesh.size;
+	streamedMesh.state = RESIDENT;
+	mesh.resident = true;
+	stats.loadedThisFrame++;
+	changedMeshes.push_back(&mesh);
+}
+
+void MeshStreamer::Evict(StreamedMesh& streamedMesh) {
+	auto& mesh = *streamedMesh.mesh;
+	mesh.resident = false;
+	pendingFrees.push_back({frame + framesInFlight, mesh.vertexBuffer.deviceLocalBuffer, mesh.indexBuffer.deviceLocalBuffer});
+	// The handles now belong to the pending free, the mesh may be loaded again before they are freed
+	mesh.vertexBuffer.deviceLocalBuffer.buffer = VK_NULL_HANDLE;
+	mesh.indexBuffer.deviceLocalBuffer.buffer = VK_NULL_HANDLE;
+
+	residentBytes -= streamedMesh.size;
+	streamedMesh.state = NOT_RESIDENT;
+	stats.evictedThisFrame++;
+	changedMeshes.push_back(&mesh);
+}
+
+void MeshStreamer::FreeStagingBuffers(Mesh& mesh) {
+	for (auto* buffer : {&mesh.vertexBuffer.stagingBuffer, &mesh.indexBuffer.stagingBuffer}) {
+		if (buffer->data) buffer->UnmapMemory(device);
+		buffer->Free(device);
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "libs/v4d/common.h"
+#include "Mesh.hpp"
+#include "../utilities/ThreadPool.h"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    // Loads .v4dmesh files in the background and keeps resident the meshes that are close to the camera, within a device memory budget.
+    //   Loader threads map the file and fill the mesh's staging buffers (all I/O happens there),
+    //   then the render thread submits the copy to the device-local buffers on the transfer queue (an upload ticket),
+    //   and the mesh becomes resident (drawable) once the ticket's fence is signaled.
+    // Update() never waits on anything, it only polls loads and fences.
+    class MeshStreamer {
+    public:
+        VkDeviceSize memoryBudget = 256ull * 1024 * 1024; // device memory that streamed meshes may use, in bytes
+        int maxConcurrentLoads = 4;
+        int evictionDelay = 120; // number of frames that a mesh stays resident after it was last requested, in case it comes back
+
+        struct Stats {
+            uint32_t registeredMeshes;
+            uint32_t residentMeshes;
+            uint32_t loadingMeshes;
+            uint32_t uploadingMeshes;
+            VkDeviceSize residentBytes;
+            uint32_t loadedThisFrame;
+            uint32_t evictedThisFrame;
+        };
+
+        MeshStreamer(v4d::utilities::ThreadPool& threadPool, int framesInFlight)
+        : threadPool(threadPool), framesInFlight(framesInFlight) {}
+
+        ~MeshStreamer();
+
+        // Registers a mesh to be streamed from a file, only its header is read now (for the bounds)
+        std::shared_ptr<Mesh> AddMesh(const std::string& filePath);
+
+        // Unregisters all meshes, the device must be released first
+        void Clear();
+
+        // Must be called before Update(), and Release() before the device or the queue go away
+        void Init(Device* device, Queue transferQueue);
+
+        // Waits for pending loads and uploads, frees all device memory, meshes are streamed again after the next Init()
+        void Release();
+
+        // Marks a mesh as needed for this frame, closest meshes are loaded first
+        void RequestResidency(Mesh* mesh, double distance);
+
+        // Called once per frame on the render thread, before drawing
+        void Update();
+
+        const Stats& GetStats() const {return stats;}
+
+        // Meshes that became resident or were evicted during the last Update()
+        const std::vector<Mesh*>& GetChangedMeshes() const {return changedMeshes;}
+
+    private:
+        enum State {
+            NOT_RESIDENT,
+            LOADING, // a loader thread is mapping the file and filling the staging buffers
+            UPLOADING, // the copy to device-local memory was submitted
+            RESIDENT,
+            FAILED, // will not be retried
+        };
+
+        struct StreamedMesh {
+            std::shared_ptr<Mesh> mesh;
+            std::string filePath;
+            State state = NOT_RESIDENT;
+            double distance = 0;
+            uint64_t lastRequestedFrame = 0;
+            VkDeviceSize size = 0; // device memory used when resident, from the file header
+            std::future<std::shared_ptr<MeshFile>> load {};
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+        };
+
+        // Buffers of evicted meshes are freed once no frame in flight can still use them
+        struct PendingFree {
+            uint64_t frame;
+            Buffer vertexBuffer;
+            Buffer indexBuffer;
+        };
+
+        v4d::utilities::ThreadPool& threadPool;
+        int framesInFlight;
+        Device* device = nullptr;
+        Queue transferQueue {};
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+
+        std::vector<std::unique_ptr<StreamedMesh>> streamedMeshes {};
+        std::unordered_map<Mesh*, StreamedMesh*> streamedMeshesByPtr {};
+        std::vector<PendingFree> pendingFrees {};
+        VkDeviceSize residentBytes = 0;
+        VkDeviceSize uploadingBytes = 0;
+        uint64_t frame = 1;
+        Stats stats {};
+        std::vector<Mesh*> changedMeshes {};
+
+        void StartLoad(StreamedMesh& streamedMesh);
+        void SubmitUpload(StreamedMesh& streamedMesh);
+        void FinishUpload(StreamedMesh& streamedMesh);
+        void Evict(StreamedMesh& streamedMesh);
+        void FreeStagingBuffers(Mesh& mesh);
+    };
+}
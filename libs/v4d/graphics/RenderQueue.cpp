@@ -0,0 +1,103 @@
+#include "libs/v4d/common.h"
+#include "RenderQueue.h"
+
+using namespace v4d::graphics;
+
+uint32_t RenderQueue::GetId(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t object) {
+	auto id = ids.try_emplace(object, (uint32_t)ids.size());
+	return std::min(id.first->second, 255u); // past 255, the remaining ones share a group and are only sorted by depth and mesh
+}
+
+uint32_t RenderQueue::QuantizeDepth(float depth) {
+	if (!(depth > 0)) return 0;
+	// 2^-4 to 2^17 units over 12 bits, finer near the view
+	float bucket = (std::log2(depth) + 4.0f) * (4095.0f / 21.0f);
+	return (uint32_t)std::clamp(bucket, 1.0f, 4095.0f);
+}
+
+uint32_t RenderQueue::AddPushConstant(const void* data, uint32_t size) {
+	pushConstants.emplace_back((uint32_t)pushConstantData.size(), size);
+	pushConstantData.insert(pushConstantData.end(), (const char*)data, (const char*)data + size);
+	return (uint32_t)pushConstants.size() - 1;
+}
+
+uint32_t RenderQueue::AddViewport(const VkViewport& viewport, const VkRect2D& scissor) {
+	viewports.emplace_back(viewport, scissor);
+	return (uint32_t)viewports.size() - 1;
+}
+
+void RenderQueue::Add(uint32_t pass, float depth, const DrawPacket& packet) {
+	auto* layout = packet.pipeline->GetPipelineLayout();
+	uint64_t descriptorState = (uint64_t)layout->handle;
+	for (auto set : layout->vkDescriptorSets) descriptorState = descriptorState * 31 + (uint64_t)set;
+	uint64_t key = uint64_t(std::min(pass, maxPasses - 1)) << 60
+		| uint64_t(GetId(pipelineIds, (uint64_t)(uintptr_t)packet.pipeline)) << 52
+		| uint64_t(GetId(descriptorStateIds, descriptorState)) << 44
+		| uint64_t(QuantizeDepth(depth)) << 32
+		| uint64_t((uint32_t)((uint64_t)packet.vertexBuffer ^ ((uint64_t)packet.vertexBuffer >> 32)));
+	packets.push_back(packet);
+	keys.push_back(key);
+}
+
+// Stable LSD radix sort of the keys, 8 bits per pass, the passes where all keys have the same digit are skipped
+void RenderQueue::Sort() {
+	size_t count = keys.size();
+	sortedKeys.assign(keys.begin(), keys.end());
+	scratchKeys.resize(count);
+	order.resize(count);
+	scratchOrder.resize(count);
+	for (uint32_t i = 0; i < count; ++i) order[i] = i;
+	if (count == 0) return;
+
+	for (int shift = 0; shift < 64; shift += 8) {
+		uint32_t histogram[256] {};
+		for (auto key : sortedKeys) ++histogram[(key >> shift) & 0xff];
+		if (histogram[(sortedKeys[0] >> shift) & 0xff] == count) continue;
+		uint32_t offset = 0;
+		for (auto& bucket : histogram) {
+			uint32_t size = bucket;
+			bucket = offset;
+			offset += size;
+		}
+		for (size_t i = 0; i < count; ++i) {
+			uint32_t destination = histogram[(sortedKeys[i] >> shift) & 0xff]++;
+			scratchKeys[destination] = sortedKeys[i];
+			scratchOrder[destination] = order[i];
+		}
+		std::swap(sortedKeys, scratchKeys);
+		std::swap(order, scratchOrder);
+	}
+}
+
+void RenderQueue::Submit(vulkan::CommandRecorder& commandBuffer, uint32_t pass) {
+	pass = std::min(pass, maxPasses - 1);
+	auto first = std::lower_bound(sortedKeys.begin(), sortedKeys.end(), uint64_t(pass) << 60);
+	auto last = pass == maxPasses - 1? sortedKeys.end() : std::lower_bound(first, sortedKeys.end(), uint64_t(pass + 1) << 60);
+
+	for (auto it = first; it != last; ++it) {
+		auto& packet = packets[order[it - sortedKeys.begin()]];
+		auto* layout = packet.pipeline->GetPipelineLayout();
+		commandBuffer.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline->GetCurrentPipeline(), layout->handle);
+		layout->Bind(commandBuffer);
+		if (packet.pushConstant != NONE) layout->PushConstants(commandBuffer, pushConstantData.data() + pushConstants[packet.pushConstant].first);
+		if (packet.viewport != NONE) {
+			commandBuffer.SetViewport(viewports[packet.viewport].first);
+			commandBuffer.SetScissor(viewports[packet.viewport].second);
+		}
+		VkBuffer buffers[] = {packet.vertexBuffer, packet.instanceBuffer};
+		VkDeviceSize offsets[] = {0, 0};
+		commandBuffer.BindVertexBuffers(0, packet.instanceBuffer? 2:1, buffers, offsets);
+		commandBuffer.BindIndexBuffer(packet.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		commandBuffer.DrawIndexed(packet.indexCount, packet.instanceCount, packet.firstIndex, 0, packet.firstInstance);
+	}
+}
+
+void RenderQueue::Clear() {
+	packets.clear();
+	keys.clear();
+	sortedKeys.clear();
+	order.clear();
+	pushConstantData.clear();
+	pushConstants.clear();
+	viewports.clear();
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "libs/v4d/common.h"
+
+namespace v4d::graphics {
+
+    // Indexed draws of a whole frame, queued before recording, sorted once by a 64-bit key so that consecutive draws share as many binds as possible,
+    // then recorded one pass at a time.
+    // Key fields, from the most significant bits :
+    //   pass (4)                 render pass of the draw, the draws of a pass are contiguous and recorded by Submit(pass)
+    //   pipeline (8)             draws of a pipeline are contiguous
+    //   descriptor state (8)     pipeline layout and descriptor sets, so that pipelines sharing them do not rebind them
+    //   depth (12)               logarithmic distance from the view, front to back within the same state (0 for draws that are not depth sorted)
+    //   mesh (32)                draws of the same vertex buffer are next to each other (the levels of detail of a mesh keep it bound)
+    // The sort is stable, draws with the same key keep the order they were queued in.
+    // The push constant and the viewport are not in the key (the draws of a mesh for each light of a shadow pass only change them).
+    // Draws are recorded through a CommandRecorder, which skips the binds of the state that is already bound, also across submits.
+    class RenderQueue {
+    public:
+        static const uint32_t NONE = ~0u;
+
+        struct DrawPacket {
+            vulkan::RasterShaderPipeline* pipeline;
+            uint32_t pushConstant; // from AddPushConstant(), first push constant struct of the pipeline layout, NONE for none
+            uint32_t viewport; // from AddViewport(), NONE to keep the viewport and scissor that are set (by the render pass)
+            VkBuffer vertexBuffer;
+            VkBuffer instanceBuffer; // second vertex binding, VK_NULL_HANDLE for none
+            VkBuffer indexBuffer; // 32-bit indices, bound at offset 0
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            uint32_t firstInstance;
+            uint32_t instanceCount;
+        };
+
+        static const uint32_t maxPasses = 16;
+
+        // Copied into the queue until Clear(), the returned index is given to the packets that use it
+        uint32_t AddPushConstant(const void* data, uint32_t size);
+        template<class T>
+        uint32_t AddPushConstant(const T& pushConstant) {
+            return AddPushConstant(&pushConstant, sizeof(T));
+        }
+        uint32_t AddViewport(const VkViewport& viewport, const VkRect2D& scissor);
+
+        // depth : distance from the view for front to back sorting, 0 to only group by state
+        void Add(uint32_t pass, float depth, const DrawPacket& packet);
+
+        // Sorts the queued draws of every pass, once all of them are added
+        void Sort();
+
+        // Records the sorted draws of a pass, in its render pass
+        void Submit(vulkan::CommandRecorder& commandBuffer, uint32_t pass);
+
+        // Empties the queue for the next frame
+        void Clear();
+
+    private:
+        std::vector<DrawPacket> packets {};
+        std::vector<uint64_t> keys {};
+        std::vector<char> pushConstantData {};
+        std::vector<std::pair<uint32_t, uint32_t>> pushConstants {}; // offset and size in pushConstantData
+        std::vector<std::pair<VkViewport, VkRect2D>> viewports {};
+        // radix sort buffers, kept to avoid allocating them every frame
+        std::vector<uint64_t> sortedKeys {};
+        std::vector<uint64_t> scratchKeys {};
+        std::vector<uint32_t> order {};
+        std::vector<uint32_t> scratchOrder {};
+
+        // small stable ids of the pipelines and descriptor states, in the order they are first queued
+        std::unordered_map<uint64_t, uint32_t> pipelineIds {};
+        std::unordered_map<uint64_t, uint32_t> descriptorStateIds {};
+
+        static uint32_t GetId(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t object);
+        static uint32_t QuantizeDepth(float depth);
+    };
+
+}
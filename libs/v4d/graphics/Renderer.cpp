@@ -104,9 +104,12 @@ void Renderer::CreateDevices() {
 	if (presentQueue.handle == nullptr) {
 		throw std::runtime_error("Failed to get Presentation Queue for surface");
 	}
+	
+	pipelineScheduler.CreatePipelineCache(renderingDevice, pipelineCacheFile);
 }
 
 void Renderer::DestroyDevices() {
+	pipelineScheduler.DestroyPipelineCache(renderingDevice);
 	delete renderingDevice;
 }
 
@@ -158,6 +161,29 @@ void Renderer::DestroyCommandPools() {
 	renderingDevice->DestroyCommandPool(transferQueue.commandPool);
 }
 
+void Renderer::ReflectLayouts() {
+	// Merged per pipeline layout, the programs that share one may each read a part of it
+	std::map<PipelineLayout*, ShaderReflection> layoutReflections;
+	for (auto* pipeline : GetShaderPipelines()) {
+		layoutReflections[pipeline->GetPipelineLayout()].Merge(pipeline->GetReflection());
+	}
+	
+	// A descriptor set may be in several pipeline layouts, at other set numbers, its bindings get the stages of all of them
+	std::map<DescriptorBinding*, VkShaderStageFlags> bindingStages;
+	for (auto&[layout, reflection] : layoutReflections) {
+		for (auto& reflected : reflection.bindings) {
+			if (reflected.set >= layout->descriptorSets.size()) continue; // the pipeline fails to be created with the details
+			auto& bindings = layout->descriptorSets[reflected.set]->GetBindings();
+			auto binding = bindings.find(reflected.binding);
+			if (binding != bindings.end()) bindingStages[&binding->second] |= reflected.stageFlags;
+		}
+		layout->SetReflectedPushConstants(reflection.pushConstants);
+	}
+	for (auto&[binding, stages] : bindingStages) {
+		binding->stageFlags = stages;
+	}
+}
+
 void Renderer::CreateDescriptorSets() {
 	for (auto* set : descriptorSets) {
 		set->CreateDescriptorSetLayout(renderingDevice);
@@ -680,14 +706,19 @@ void Renderer::GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t widt
 void Renderer::RecreateSwapChains() {
 	std::scoped_lock lock(renderingMutex, lowPriorityRenderingMutex);
 	
+	// The pipelines do not depend on the size of the swap chain
 	if (graphicsLoadedToDevice)
-		UnloadGraphicsFromDevice();
+		UnloadGraphicsFromDevice(true);
 	
 	// Re-Create the SwapChain
 	if (!CreateSwapChain()) {
 		return;
 	}
 	
+	// but some of them render to its images
+	if (swapChain->format.format != pipelinesSwapChainFormat)
+		UnloadPipelinesFromDevice();
+	
 	LoadGraphicsToDevice();
 }
 
@@ -714,6 +745,7 @@ void Renderer::UnloadRenderer() {
 	
 	if (graphicsLoadedToDevice)
 		UnloadGraphicsFromDevice();
+	UnloadPipelinesFromDevice(); // kept by a swap chain recreation that could not complete
 	
 	DestroySwapChain();
 	DestroySyncObjects();
@@ -734,6 +766,7 @@ void Renderer::ReloadRenderer() {
 	
 	if (graphicsLoadedToDevice)
 		UnloadGraphicsFromDevice();
+	UnloadPipelinesFromDevice();
 	
 	DestroySwapChain();
 	DestroySyncObjects();
@@ -751,24 +784,121 @@ void Renderer::ReloadRenderer() {
 	LoadGraphicsToDevice();
 }
 
+void Renderer::EnableShaderHotReload(const std::string& sourceDirectory, const std::string& outputDirectory) {
+	if (shaderCompiler) {
+		// Compiled into the cache on the watcher's thread, the pipelines then find them there
+		shaderWatcher = std::make_unique<ShaderWatcher>(sourceDirectory, outputDirectory, [this](const std::string& filepath){
+			try {
+				shaderCompiler->GetSpirv(filepath);
+				return true;
+			} catch (std::exception& e) {
+				LOG_ERROR(e.what())
+				return false;
+			}
+		});
+	} else {
+		shaderWatcher = std::make_unique<ShaderWatcher>(sourceDirectory, outputDirectory);
+	}
+	if (!shaderWatcher->IsWatching()) shaderWatcher.reset();
+}
+
+void Renderer::EnableShaderCompiler(const std::string& sourceDirectory, const std::string& cacheDirectory) {
+	shaderCompiler = std::make_unique<ShaderCompiler>(sourceDirectory, cacheDirectory);
+}
+
+void Renderer::OpenShaderArchive(const std::vector<std::string>& filepaths) {
+	shaderArchive.reset(); // stays mapped as long as shaders use it
+	if (shaderArchiveFile.empty()) return;
+	try {
+		try {
+			shaderArchive = std::make_shared<ShaderArchive>(shaderArchiveFile);
+		} catch (std::exception&) {} // missing, or from another version, packed again below
+		if (!shaderArchive || !shaderArchive->IsUpToDate(filepaths)) {
+			shaderArchive.reset();
+			ShaderArchive::Pack(shaderArchiveFile, filepaths);
+			shaderArchive = std::make_shared<ShaderArchive>(shaderArchiveFile);
+			LOG("Packed " << filepaths.size() << " shaders into " << shaderArchiveFile)
+		}
+	} catch (std::exception& e) {
+		shaderArchive.reset();
+		LOG_WARN("Shader archive not used : " << e.what())
+	}
+}
+
+void Renderer::DisableShaderHotReload() {
+	shaderWatcher.reset();
+}
+
+void Renderer::ReloadChangedShaders() {
+	auto changedFiles = shaderWatcher->TakeCompiledShaders();
+	if (changedFiles.empty()) return;
+	
+	std::vector<ShaderPipeline*> pipelines;
+	for (auto* pipeline : GetShaderPipelines()) {
+		for (auto& file : changedFiles) {
+			if (pipeline->UsesShaderFile(file)) {
+				pipelines.push_back(pipeline);
+				break;
+			}
+		}
+	}
+	if (pipelines.empty()) return;
+	
+	std::scoped_lock lock(renderingMutex, lowPriorityRenderingMutex);
+	
+	// The pipelines may still be in use by the frames in flight, or have permutations being created
+	renderingDevice->DeviceWaitIdle();
+	pipelineScheduler.Wait();
+	
+	size_t reloaded = 0;
+	for (auto* pipeline : pipelines) {
+		auto start = std::chrono::high_resolution_clock::now();
+		bool success = pipeline->Reload(renderingDevice, shaderCompiler.get());
+		if (success) reloaded++;
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		auto files = pipeline->GetShaderFiles();
+		std::ostringstream name;
+		for (size_t i = 0; i < files.size(); ++i) name << (i > 0 ? " + " : "") << files[i];
+		LOG("Shader hot reload : " << name.str() << (success? " recreated in " : " failed after ") << milliseconds << " ms")
+	}
+	
+	// The static command buffers were recorded with the previous pipelines
+	if (reloaded > 0) {
+		DestroyCommandBuffers();
+		CreateCommandBuffers();
+		ShaderPipelinesReloaded(pipelines);
+	}
+	
+	LOG("Shader hot reload : recreated " << reloaded << " of " << pipelines.size() << " pipelines")
+}
+
 void Renderer::LoadGraphicsToDevice() {
 	CreateCommandPools();
 	CreateResources();
 	AllocateBuffers();
-	CreateDescriptorSets();
-	CreatePipelines(); // shaders are assigned here
+	if (pipelinesLoadedToDevice) {
+		// Same descriptor sets, written again with the new images and buffers
+		UpdateDescriptorSets();
+	} else {
+		ReflectLayouts();
+		CreateDescriptorSets();
+		CreatePipelines(); // shaders are assigned here
+		pipelinesLoadedToDevice = true;
+		pipelinesSwapChainFormat = swapChain->format.format;
+	}
+	CreateFrameBuffers();
 	CreateCommandBuffers(); // objects are rendered here
 	
 	graphicsLoadedToDevice = true;
 }
 
-void Renderer::UnloadGraphicsFromDevice() {
+void Renderer::UnloadGraphicsFromDevice(bool keepPipelines) {
 	// Wait for renderingDevice to be idle before destroying everything
 	renderingDevice->DeviceWaitIdle(); // We can also wait for operations in a specific command queue to be finished with vkQueueWaitIdle. These functions can be used as a very rudimentary way to perform synchronization. 
 
 	DestroyCommandBuffers();
-	DestroyPipelines();
-	DestroyDescriptorSets();
+	DestroyFrameBuffers();
+	if (!keepPipelines) UnloadPipelinesFromDevice();
 	FreeBuffers();
 	DestroyResources();
 	DestroyCommandPools();
@@ -776,6 +906,15 @@ void Renderer::UnloadGraphicsFromDevice() {
 	graphicsLoadedToDevice = false;
 }
 
+void Renderer::UnloadPipelinesFromDevice() {
+	if (!pipelinesLoadedToDevice) return;
+	renderingDevice->DeviceWaitIdle();
+	pipelineScheduler.Wait();
+	DestroyPipelines();
+	DestroyDescriptorSets();
+	pipelinesLoadedToDevice = false;
+}
+
 #pragma endregion
 
 #pragma region Constructor & Destructor
@@ -815,6 +954,15 @@ void Renderer::Render() {
 		return;
 	}
 	
+	if (shaderWatcher) {
+		ReloadChangedShaders();
+	}
+	
+	// Background permutations that are ready, the base pipelines are bound until then
+	if (pipelineScheduler.IsBuilding()) {
+		pipelineScheduler.Update();
+	}
+	
 	uint64_t timeout = 1000UL * 1000 * 1000 * 30; // 30 seconds
 
 	// Get an image from the swapchain
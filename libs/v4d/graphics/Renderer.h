@@ -1,5 +1,6 @@
 #pragma once
 #include "libs/v4d/common.h"
+#include "ShaderWatcher.h"
 
 #ifdef XVK_USE_QT_VULKAN_LOADER
     #include <QWindow>
@@ -39,8 +40,13 @@ namespace v4d::graphics {
         std::recursive_mutex renderingMutex, lowPriorityRenderingMutex;
         bool mustReload = false;
         bool graphicsLoadedToDevice = false;
+        bool pipelinesLoadedToDevice = false;
+        VkFormat pipelinesSwapChainFormat = VK_FORMAT_UNDEFINED;
         std::thread::id renderThreadId = std::this_thread::get_id();
 
+        // Pipelines are created by CreatePipelines() through this scheduler, with a pipeline cache that lives as long as the device
+        PipelineScheduler pipelineScheduler {};
+
         // Descriptor sets
         VkDescriptorPool descriptorPool;
         std::vector<DescriptorSet*> descriptorSets {};
@@ -56,6 +62,8 @@ namespace v4d::graphics {
             {VK_FORMAT_R32G32B32A32_SFLOAT, VK_COLOR_SPACE_HDR10_HLG_EXT},
             {VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
         };
+        std::string pipelineCacheFile = "shaders/cache/pipelines.bin"; // loaded when the device is created and saved when it is destroyed, empty to not save it
+        std::string shaderArchiveFile = "shaders/shaders.pak"; // all the .spv files packed and mapped at once, packed again when one of them changes, empty to read each .spv file
 
     private: // Device Extensions and features
         std::vector<const char*> requiredDeviceExtensions { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
@@ -89,10 +97,14 @@ namespace v4d::graphics {
         virtual void UnloadScene() = 0;
         virtual void ReadShaders() = 0;
 
-        // Pipelines
+        // Pipelines, with their render passes and layouts, kept when the swap chain is recreated unless its format changed
         virtual void CreatePipelines() = 0;
         virtual void DestroyPipelines() = 0;
 
+        // Frame buffers and whatever else depends on the size of the swap chain, recreated with it
+        virtual void CreateFrameBuffers() = 0;
+        virtual void DestroyFrameBuffers() = 0;
+
         // Update
         virtual void FrameUpdate(uint imageIndex) = 0;
 
@@ -100,6 +112,11 @@ namespace v4d::graphics {
         virtual void RecordGraphicsCommandBuffer(VkCommandBuffer, int imageIndex) = 0;
         virtual void RunDynamicGraphics(VkCommandBuffer, int imageIndex) = 0;
 
+        // The pipelines whose layouts are derived from their shaders' reflection, also recreated by the shader hot reload when one of their shader files is recompiled
+        virtual std::vector<ShaderPipeline*> GetShaderPipelines() {return {};}
+        // Called after these pipelines were recreated, for what was rendered with them and is kept across frames
+        virtual void ShaderPipelinesReloaded(const std::vector<ShaderPipeline*>&) {}
+
     protected: // Create/Destroy
 
         void CreateDevices();
@@ -111,6 +128,10 @@ namespace v4d::graphics {
         void CreateCommandPools();
         void DestroyCommandPools();
 
+        // Stage flags of the descriptor bindings and push constant ranges of the pipeline layouts, from what the shaders of GetShaderPipelines() read.
+        // Bindings that no shader reads keep the stage flags they are declared with. The shaders must have been read.
+        void ReflectLayouts();
+
         void CreateDescriptorSets();
         void DestroyDescriptorSets();
 
@@ -156,9 +177,34 @@ namespace v4d::graphics {
         void UnloadRenderer();
         void ReloadRenderer();
 
+    public: // Shader hot reload
+        // Recompiles the GLSL files of sourceDirectory into outputDirectory when they change, on a background thread,
+        // then at the next frame only recreates the pipelines that use them (instead of reloading the whole renderer)
+        void EnableShaderHotReload(const std::string& sourceDirectory, const std::string& outputDirectory = "shaders");
+        void DisableShaderHotReload();
+
+    private:
+        std::unique_ptr<ShaderWatcher> shaderWatcher = nullptr;
+        void ReloadChangedShaders();
+
+    public: // Runtime shader compilation
+        // Shaders are compiled from the GLSL files of sourceDirectory instead of being read from the prebuilt .spv files,
+        // the SPIR-V is cached in cacheDirectory. Takes effect the next time the shaders are read.
+        void EnableShaderCompiler(const std::string& sourceDirectory, const std::string& cacheDirectory = "shaders/cache");
+
+    protected:
+        std::unique_ptr<ShaderCompiler> shaderCompiler = nullptr;
+        std::shared_ptr<ShaderArchive> shaderArchive = nullptr;
+        
+        // Maps shaderArchiveFile for the next ReadShaders() calls, packing it first if it is missing or outdated.
+        // On failure the shaders are read from their .spv files, shaderArchive is then null.
+        void OpenShaderArchive(const std::vector<std::string>& filepaths);
+
     protected:
         void LoadGraphicsToDevice();
-        void UnloadGraphicsFromDevice();
+        // keepPipelines when only the size of the swap chain changes
+        void UnloadGraphicsFromDevice(bool keepPipelines = false);
+        void UnloadPipelinesFromDevice();
 
     public:
 
@@ -0,0 +1,141 @@
+#include "libs/v4d/common.h"
+#include "ShaderWatcher.h"
+
+#ifdef __linux__
+	#include <dirent.h>
+	#include <poll.h>
+	#include <sys/inotify.h>
+#endif
+
+using namespace v4d::graphics;
+
+ShaderWatcher::ShaderWatcher(const std::string& sourceDirectory, const std::string& outputDirectory, const std::string& compiler)
+: sourceDirectory(sourceDirectory), outputDirectory(outputDirectory), compiler(compiler) {
+	Start();
+}
+
+ShaderWatcher::ShaderWatcher(const std::string& sourceDirectory, const std::string& outputDirectory, std::function<bool(const std::string& filepath)> compile)
+: sourceDirectory(sourceDirectory), outputDirectory(outputDirectory), compile(compile) {
+	Start();
+}
+
+void ShaderWatcher::Start() {
+	#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotifyFd < 0) {
+			LOG_WARN("Shader hot reload : failed to initialize inotify")
+			return;
+		}
+		// Editors either write the file in place or write a temporary file and rename it
+		if (inotify_add_watch(inotifyFd, sourceDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			LOG_WARN("Shader hot reload : cannot watch directory '" << sourceDirectory << "'")
+			close(inotifyFd);
+			inotifyFd = -1;
+			return;
+		}
+		watching = true;
+		thread = std::thread(&ShaderWatcher::Watch, this);
+		LOG("Shader hot reload : watching '" << sourceDirectory << "'")
+	#else
+		LOG_WARN("Shader hot reload is only supported on Linux")
+	#endif
+}
+
+ShaderWatcher::~ShaderWatcher() {
+	stopping = true;
+	if (thread.joinable()) thread.join();
+	if (inotifyFd >= 0) close(inotifyFd);
+}
+
+std::vector<std::string> ShaderWatcher::TakeCompiledShaders() {
+	std::vector<std::string> files;
+	std::lock_guard lock(compiledMutex);
+	files.swap(compiled);
+	return files;
+}
+
+void ShaderWatcher::Watch() {
+	#ifdef __linux__
+		alignas(inotify_event) char buffer[4096];
+		while (!stopping) {
+			// Wakes up regularly to check whether it is stopping
+			pollfd fd {inotifyFd, POLLIN, 0};
+			if (poll(&fd, 1, 200) <= 0) continue;
+
+			// An editor's save may produce several events for the same file, each file is compiled once
+			std::vector<std::string> changedFiles;
+			ssize_t length;
+			while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+				for (char* ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(ptr)->len) {
+					auto* event = reinterpret_cast<inotify_event*>(ptr);
+					if (event->len == 0) continue;
+					std::string fileName = event->name;
+					auto extension = fileName.find_last_of('.');
+					if (extension == std::string::npos) continue;
+					// Included files are not compiled on their own, the shaders that include them are
+					std::vector<std::string> files;
+					if (fileName.substr(extension + 1) == "glsl") files = FindIncludingShaders(fileName);
+					else if (SHADER_TYPES.count(fileName.substr(extension + 1))) files.push_back(fileName);
+					for (auto& file : files) {
+						if (std::find(changedFiles.begin(), changedFiles.end(), file) == changedFiles.end()) changedFiles.push_back(file);
+					}
+				}
+			}
+
+			for (auto& fileName : changedFiles) {
+				if (Compile(fileName)) {
+					std::lock_guard lock(compiledMutex);
+					compiled.push_back(outputDirectory + "/" + fileName);
+				}
+			}
+		}
+	#endif
+}
+
+std::vector<std::string> ShaderWatcher::FindIncludingShaders(const std::string& includeName) {
+	std::vector<std::string> files;
+	#ifdef __linux__
+		DIR* dir = opendir(sourceDirectory.c_str());
+		if (!dir) return files;
+		std::string directive = "#include \"" + includeName + "\"";
+		while (dirent* entry = readdir(dir)) {
+			std::string fileName = entry->d_name;
+			auto extension = fileName.find_last_of('.');
+			if (extension == std::string::npos || !SHADER_TYPES.count(fileName.substr(extension + 1))) continue;
+			std::ifstream file(sourceDirectory + "/" + fileName);
+			std::string line;
+			while (std::getline(file, line)) {
+				if (line.find(directive) != std::string::npos) {
+					files.push_back(fileName);
+					break;
+				}
+			}
+		}
+		closedir(dir);
+	#endif
+	return files;
+}
+
+bool ShaderWatcher::Compile(const std::string& fileName) {
+	if (compile) {
+		LOG("Shader hot reload : compiling " << fileName)
+		return compile(outputDirectory + "/" + fileName);
+	}
+	std::string source = sourceDirectory + "/" + fileName;
+	std::string output = outputDirectory + "/" + fileName + ".spv";
+	// Compiled to a temporary file, then renamed, so that the previous .spv is never left half written
+	std::string temporary = output + ".tmp";
+	std::string command = compiler + " -V \"" + source + "\" -o \"" + temporary + "\"";
+	LOG("Shader hot reload : compiling " << fileName)
+	if (std::system(command.c_str()) != 0) {
+		LOG_WARN("Shader hot reload : " << fileName << " failed to compile, its pipelines are unchanged")
+		std::remove(temporary.c_str());
+		return false;
+	}
+	if (std::rename(temporary.c_str(), output.c_str()) != 0) {
+		LOG_WARN("Shader hot reload : failed to write '" << output << "'")
+		std::remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
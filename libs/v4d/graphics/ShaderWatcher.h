@@ -0,0 +1,49 @@
+#pragma once
+#include "libs/v4d/common.h"
+
+namespace v4d::graphics {
+
+    // Watches a directory of GLSL sources with inotify and compiles the files that change into SPIR-V on its own thread,
+    // with the same command as the build (glslangValidator -V), or with a given function (the renderer's ShaderCompiler).
+    // A file that fails to compile keeps its previous SPIR-V, the compiler's output is printed.
+    // Saving an included .glsl file recompiles the shaders that include it directly.
+    // The renderer takes the list of compiled files at a frame boundary.
+    class ShaderWatcher {
+    public:
+        // sourceDirectory holds the GLSL files, their .spv are written to outputDirectory (where the pipelines read them)
+        ShaderWatcher(const std::string& sourceDirectory, const std::string& outputDirectory, const std::string& compiler = "glslangValidator");
+        // compile takes the file's path like a ShaderInfo's filepath, and returns false if it failed
+        ShaderWatcher(const std::string& sourceDirectory, const std::string& outputDirectory, std::function<bool(const std::string& filepath)> compile);
+        ~ShaderWatcher();
+
+        ShaderWatcher(const ShaderWatcher&) = delete;
+        ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+        // false if the directory cannot be watched (or inotify is not available on this platform)
+        bool IsWatching() const {return watching;}
+
+        // Shader files successfully compiled since the last call, as outputDirectory + "/" + file name (without .spv), like a ShaderInfo's filepath
+        std::vector<std::string> TakeCompiledShaders();
+
+    private:
+        std::string sourceDirectory;
+        std::string outputDirectory;
+        std::string compiler;
+        std::function<bool(const std::string& filepath)> compile = nullptr;
+
+        int inotifyFd = -1;
+        bool watching = false;
+        std::atomic<bool> stopping {false};
+        std::thread thread;
+
+        std::mutex compiledMutex;
+        std::vector<std::string> compiled {};
+
+        void Start();
+        void Watch();
+        // Shaders of the source directory with an #include "includeName" directive
+        std::vector<std::string> FindIncludingShaders(const std::string& includeName);
+        bool Compile(const std::string& fileName);
+    };
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "../common.h"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    // Packs the square shadow maps of many lights into a single depth image, so that they are all rendered in one render pass.
+    // Tile sizes are powers of two, placed from the largest to the smallest along a Z-order curve :
+    // each tile then starts at a multiple of its own area, which leaves no gap and no overlap.
+    struct ShadowAtlas {
+        uint32_t size = 4096; // width and height of the atlas image, in texels
+        uint32_t minTileSize = 128;
+        uint32_t maxTileSize = 1024;
+
+        struct Tile {
+            uint32_t x, y, size; // in texels, size is 0 when the tile did not fit
+        };
+
+        // Tile size for a light that covers the given number of pixels on screen (its bounding sphere's diameter)
+        uint32_t GetTileSize(double screenCoverage) const {
+            uint32_t tileSize = minTileSize;
+            while (tileSize < maxTileSize && tileSize < screenCoverage) tileSize *= 2;
+            return tileSize;
+        }
+
+        // requestedSizes are from GetTileSize(), sorted from the most important light to the least important one.
+        // A tile that does not fit is halved until it does, tiles that still do not fit at minTileSize have a size of 0.
+        std::vector<Tile> Allocate(const std::vector<uint32_t>& requestedSizes) const {
+            std::vector<Tile> tiles;
+            tiles.reserve(requestedSizes.size());
+            uint32_t cellsPerSide = size / minTileSize;
+            uint64_t totalCells = uint64_t(cellsPerSide) * cellsPerSide;
+            uint64_t nextCell = 0;
+            uint32_t previousSize = maxTileSize;
+            for (uint32_t requestedSize : requestedSizes) {
+                // Sizes must not increase, otherwise the next tile would not be aligned on its own area
+                uint32_t tileSize = std::min(requestedSize, previousSize);
+                uint64_t cells = 0;
+                for (;;) {
+                    cells = uint64_t(tileSize / minTileSize) * (tileSize / minTileSize);
+                    if (nextCell + cells <= totalCells || tileSize <= minTileSize) break;
+                    tileSize /= 2;
+                }
+                if (nextCell + cells > totalCells) {
+                    tiles.push_back({0, 0, 0});
+                    continue;
+                }
+                uvec2 cell = DecodeMorton(nextCell);
+                tiles.push_back({cell.x * minTileSize, cell.y * minTileSize, tileSize});
+                nextCell += cells;
+                previousSize = tileSize;
+            }
+            return tiles;
+        }
+
+    private:
+        static uvec2 DecodeMorton(uint64_t code) {
+            uvec2 cell {0};
+            for (int bit = 0; bit < 32; ++bit) {
+                cell.x |= uint32_t((code >> (2 * bit)) & 1) << bit;
+                cell.y |= uint32_t((code >> (2 * bit + 1)) & 1) << bit;
+            }
+            return cell;
+        }
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "../common.h"
+#include "Camera.hpp"
+
+namespace v4d::graphics {
+    using namespace glm;
+
+    // Splits the camera's frustum into slices along its view direction, each one covered by an orthographic shadow map of a directional light.
+    // A cascade is fitted to the bounding sphere of its slice, whose size does not change when the camera turns,
+    // and its center is snapped to the shadow map's texels, so that the edges of the shadows do not shimmer when the camera moves.
+    struct ShadowCascades {
+        static constexpr uint32_t maxCount = 4;
+        uint32_t count = 4; // 1 to maxCount
+        uint32_t size = 2048; // width and height of each cascade's shadow map, in texels
+        double distance = 200; // from the camera along its view direction, where the last cascade ends
+        double splitLambda = 0.75; // 0 = uniform splits, 1 = logarithmic splits
+        double casterDistance = 100; // casters this far from a cascade's slice towards the light still cast shadows into it
+
+        struct Cascade {
+            double end; // distance from the camera along its view direction, where the next cascade starts
+            dvec3 eye; // world position of the cascade's view, behind its slice towards the light
+            dmat4 viewMatrix;
+            dmat4 projectionMatrix; // orthographic with reversed depth, y is not flipped
+        };
+
+        std::vector<Cascade> Fit(const Camera& camera, double aspectRatio, const dvec3& lightDirection) const {
+            dvec3 direction = normalize(lightDirection);
+            // The light's rotation only depends on its direction, so that the texel grid stays put when the camera turns or rolls.
+            // Up is the world's z, or x when the light points straight up or down.
+            dvec3 up = abs(direction.z) < 0.99 ? dvec3(0,0,1) : dvec3(1,0,0);
+            dmat3 rotation = dmat3(lookAt(dvec3(0), direction, up));
+            dvec3 forward = normalize(camera.lookDirection);
+            double tanHalfFov = tan(radians(camera.fov) / 2.0);
+            double k2 = tanHalfFov * tanHalfFov * (1.0 + aspectRatio * aspectRatio); // squared slope of the frustum's corners
+            double zNear = camera.znear;
+            double zFar = glm::max(distance, zNear);
+            uint32_t cascadeCount = std::clamp(count, 1u, maxCount);
+
+            auto split = [&](uint32_t i){
+                double t = double(i) / cascadeCount;
+                return splitLambda * zNear * pow(zFar / zNear, t) + (1.0 - splitLambda) * (zNear + (zFar - zNear) * t);
+            };
+
+            std::vector<Cascade> cascades;
+            cascades.reserve(cascadeCount);
+            for (uint32_t i = 0; i < cascadeCount; ++i) {
+                double n = split(i), f = split(i + 1);
+                // Center of the sphere through the corners of both ends of the slice, or at the far end when the slice is wider than deep
+                double c = glm::min((n + f) * (1.0 + k2) / 2.0, f);
+                double radius = sqrt((f - c) * (f - c) + f * f * k2);
+
+                // Snap the center to the texels, in the light's axes
+                double texelSize = 2.0 * radius / size;
+                dvec3 center = rotation * (camera.worldPosition + forward * c);
+                center.x = floor(center.x / texelSize) * texelSize;
+                center.y = floor(center.y / texelSize) * texelSize;
+                center = transpose(rotation) * center;
+
+                Cascade cascade;
+                cascade.end = f;
+                cascade.eye = center - direction * (radius + casterDistance);
+                cascade.viewMatrix = lookAt(cascade.eye, cascade.eye + direction, up);
+                // zNear and zFar are swapped for the reversed depth, like the camera's
+                cascade.projectionMatrix = ortho(-radius, radius, -radius, radius, 2.0 * radius + casterDistance, 0.0);
+                cascades.push_back(cascade);
+            }
+            return cascades;
+        }
+    };
+}
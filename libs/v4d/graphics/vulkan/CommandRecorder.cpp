@@ -0,0 +1,155 @@
+#include "../../common.h"
+
+using namespace v4d::graphics::vulkan;
+
+CommandRecorder::Counter CommandRecorder::Stats::GetTotal() const {
+	Counter total {};
+	for (auto* counter : {&pipelines, &descriptorSets, &pushConstants, &vertexBuffers, &indexBuffers, &viewports, &scissors}) {
+		total.issued += counter->issued;
+		total.elided += counter->elided;
+	}
+	return total;
+}
+
+CommandRecorder::CommandRecorder(Device* device, VkCommandBuffer commandBuffer) : device(device), commandBuffer(commandBuffer) {}
+
+CommandRecorder::BindPointState& CommandRecorder::GetBindPoint(VkPipelineBindPoint bindPoint) {
+	return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? compute : graphics;
+}
+
+void CommandRecorder::SetPushConstantsLayout(VkPipelineLayout layout) {
+	if (layout == pushConstantsLayout) return;
+	pushConstantsLayout = layout;
+	pushConstants.clear();
+	pushConstantsKnown.clear();
+}
+
+void CommandRecorder::BindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline, VkPipelineLayout layout) {
+	auto& state = GetBindPoint(bindPoint);
+	if (pipeline == state.pipeline) {
+		++stats.pipelines.elided;
+		return;
+	}
+	device->CmdBindPipeline(commandBuffer, bindPoint, pipeline);
+	state.pipeline = pipeline;
+	state.pipelineLayout = layout;
+	SetPushConstantsLayout(layout);
+	++stats.pipelines.issued;
+}
+
+void CommandRecorder::BindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* descriptorSets) {
+	if (setCount == 0) return;
+	auto& state = GetBindPoint(bindPoint);
+	if (layout != state.descriptorSetsLayout) {
+		state.descriptorSetsLayout = layout;
+		state.descriptorSets.clear();
+	}
+	if (state.descriptorSets.size() >= firstSet + setCount && std::equal(descriptorSets, descriptorSets + setCount, state.descriptorSets.begin() + firstSet)) {
+		++stats.descriptorSets.elided;
+		return;
+	}
+	device->CmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, setCount, descriptorSets, 0, nullptr);
+	if (state.descriptorSets.size() < firstSet + setCount) state.descriptorSets.resize(firstSet + setCount, VK_NULL_HANDLE);
+	std::copy(descriptorSets, descriptorSets + setCount, state.descriptorSets.begin() + firstSet);
+	++stats.descriptorSets.issued;
+}
+
+void CommandRecorder::PushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* values) {
+	SetPushConstantsLayout(layout);
+	const char* bytes = (const char*)values;
+	if (pushConstants.size() >= offset + size
+		&& std::all_of(pushConstantsKnown.begin() + offset, pushConstantsKnown.begin() + offset + size, [](bool known){return known;})
+		&& memcmp(pushConstants.data() + offset, bytes, size) == 0
+	) {
+		++stats.pushConstants.elided;
+		return;
+	}
+	device->CmdPushConstants(commandBuffer, layout, stageFlags, offset, size, values);
+	if (pushConstants.size() < offset + size) {
+		pushConstants.resize(offset + size);
+		pushConstantsKnown.resize(offset + size, false);
+	}
+	memcpy(pushConstants.data() + offset, bytes, size);
+	std::fill(pushConstantsKnown.begin() + offset, pushConstantsKnown.begin() + offset + size, true);
+	++stats.pushConstants.issued;
+}
+
+void CommandRecorder::BindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets) {
+	if (vertexBuffers.size() >= firstBinding + bindingCount
+		&& std::equal(buffers, buffers + bindingCount, vertexBuffers.begin() + firstBinding)
+		&& std::equal(offsets, offsets + bindingCount, vertexBufferOffsets.begin() + firstBinding)
+	) {
+		++stats.vertexBuffers.elided;
+		return;
+	}
+	device->CmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, buffers, offsets);
+	if (vertexBuffers.size() < firstBinding + bindingCount) {
+		vertexBuffers.resize(firstBinding + bindingCount, VK_NULL_HANDLE);
+		vertexBufferOffsets.resize(firstBinding + bindingCount, 0);
+	}
+	std::copy(buffers, buffers + bindingCount, vertexBuffers.begin() + firstBinding);
+	std::copy(offsets, offsets + bindingCount, vertexBufferOffsets.begin() + firstBinding);
+	++stats.vertexBuffers.issued;
+}
+
+void CommandRecorder::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType type) {
+	if (buffer == indexBuffer && offset == indexBufferOffset && type == indexType) {
+		++stats.indexBuffers.elided;
+		return;
+	}
+	device->CmdBindIndexBuffer(commandBuffer, buffer, offset, type);
+	indexBuffer = buffer;
+	indexBufferOffset = offset;
+	indexType = type;
+	++stats.indexBuffers.issued;
+}
+
+void CommandRecorder::SetViewport(const VkViewport& newViewport) {
+	if (viewportKnown && memcmp(&viewport, &newViewport, sizeof(VkViewport)) == 0) {
+		++stats.viewports.elided;
+		return;
+	}
+	device->CmdSetViewport(commandBuffer, 0, 1, &newViewport);
+	viewport = newViewport;
+	viewportKnown = true;
+	++stats.viewports.issued;
+}
+
+void CommandRecorder::SetScissor(const VkRect2D& newScissor) {
+	if (scissorKnown && memcmp(&scissor, &newScissor, sizeof(VkRect2D)) == 0) {
+		++stats.scissors.elided;
+		return;
+	}
+	device->CmdSetScissor(commandBuffer, 0, 1, &newScissor);
+	scissor = newScissor;
+	scissorKnown = true;
+	++stats.scissors.issued;
+}
+
+void CommandRecorder::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+	device->CmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+	++stats.draws;
+}
+
+void CommandRecorder::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+	device->CmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+	++stats.draws;
+}
+
+void CommandRecorder::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+	device->CmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+	++stats.dispatches;
+}
+
+void CommandRecorder::Invalidate() {
+	graphics = {};
+	compute = {};
+	pushConstantsLayout = VK_NULL_HANDLE;
+	pushConstants.clear();
+	pushConstantsKnown.clear();
+	vertexBuffers.clear();
+	vertexBufferOffsets.clear();
+	indexBuffer = VK_NULL_HANDLE;
+	viewportKnown = false;
+	scissorKnown = false;
+}
@@ -0,0 +1,97 @@
+/*
+ * Command buffer recording with state tracking
+ * Part of the Vulkan4D open-source game engine under the LGPL license - https://github.com/Vulkan4D
+ *
+ * Wraps a VkCommandBuffer being recorded and remembers what is bound in it : pipelines and descriptor sets of each bind point,
+ * push constants, vertex and index buffers, viewport and scissor. Binds of the state that is already bound are not recorded.
+ * Other commands are recorded with the Device as usual, the recorder converts to its VkCommandBuffer.
+ * Anything bound directly in the command buffer must be followed by Invalidate().
+ */
+#pragma once
+#include "../../common.h"
+
+namespace v4d::graphics::vulkan {
+
+	class CommandRecorder {
+	public:
+		struct Counter {
+			uint32_t issued = 0;
+			uint32_t elided = 0;
+		};
+		struct Stats {
+			Counter pipelines {};
+			Counter descriptorSets {};
+			Counter pushConstants {};
+			Counter vertexBuffers {};
+			Counter indexBuffers {};
+			Counter viewports {};
+			Counter scissors {};
+			uint32_t draws = 0;
+			uint32_t dispatches = 0;
+
+			Counter GetTotal() const;
+		};
+
+		CommandRecorder(Device* device, VkCommandBuffer commandBuffer);
+
+		Device* GetDevice() const {return device;}
+		VkCommandBuffer GetCommandBuffer() const {return commandBuffer;}
+		operator VkCommandBuffer() const {return commandBuffer;}
+
+		// layout : the pipeline's layout, push constants are forgotten when it changes
+		void BindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline, VkPipelineLayout layout);
+		// Sets that were bound with another layout are forgotten, even if it is compatible
+		void BindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* descriptorSets);
+		void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* values);
+		void BindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets);
+		void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+		// Viewport 0 and scissor 0, all raster pipelines have them dynamic
+		void SetViewport(const VkViewport& viewport);
+		void SetScissor(const VkRect2D& scissor);
+
+		void Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+		void DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+		void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+
+		// Forgets everything that is bound, the next binds are all recorded
+		void Invalidate();
+
+		const Stats& GetStats() const {return stats;}
+		void ResetStats() {stats = {};}
+
+	private:
+		Device* device;
+		VkCommandBuffer commandBuffer;
+
+		struct BindPointState {
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkPipelineLayout descriptorSetsLayout = VK_NULL_HANDLE;
+			std::vector<VkDescriptorSet> descriptorSets {}; // by set number, VK_NULL_HANDLE when unknown
+		};
+		BindPointState graphics {};
+		BindPointState compute {};
+
+		VkPipelineLayout pushConstantsLayout = VK_NULL_HANDLE;
+		std::vector<char> pushConstants {}; // by offset
+		std::vector<bool> pushConstantsKnown {};
+
+		std::vector<VkBuffer> vertexBuffers {}; // by binding, VK_NULL_HANDLE when unknown
+		std::vector<VkDeviceSize> vertexBufferOffsets {};
+
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		VkDeviceSize indexBufferOffset = 0;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+		bool viewportKnown = false;
+		VkViewport viewport {};
+		bool scissorKnown = false;
+		VkRect2D scissor {};
+
+		Stats stats {};
+
+		BindPointState& GetBindPoint(VkPipelineBindPoint bindPoint);
+		void SetPushConstantsLayout(VkPipelineLayout layout);
+	};
+
+}
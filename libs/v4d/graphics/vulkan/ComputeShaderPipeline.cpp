@@ -11,23 +11,47 @@ ComputeShaderPipeline::~ComputeShaderPipeline() {
 	
 }
 
-void ComputeShaderPipeline::CreatePipeline(Device* device) {
-	CreateShaderStages(device);
-	VkComputePipelineCreateInfo computeCreateInfo {
+VkComputePipelineCreateInfo ComputeShaderPipeline::MakeCreateInfo() const {
+	return {
 		VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,// VkStructureType sType
 		nullptr,// const void* pNext
-		0,// VkPipelineCreateFlags flags
-		GetStages()->at(0),// VkPipelineShaderStageCreateInfo stage
+		permutations.size() > 0 ? (VkPipelineCreateFlags)VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT : 0,// VkPipelineCreateFlags flags
+		stages.at(0),// VkPipelineShaderStageCreateInfo stage
 		GetPipelineLayout()->handle,// VkPipelineLayout layout
 		VK_NULL_HANDLE,// VkPipeline basePipelineHandle
-		0// int32_t basePipelineIndex
+		-1// int32_t basePipelineIndex
 	};
-	device->CreateComputePipelines(VK_NULL_HANDLE, 1, &computeCreateInfo, nullptr, &pipeline);
+}
+
+void ComputeShaderPipeline::CreateBasePipeline(Device* device) {
+	CreateShaderStages(device);
+	VkComputePipelineCreateInfo computeCreateInfo = MakeCreateInfo();
+	if (device->CreateComputePipelines(pipelineCache, 1, &computeCreateInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		pipeline = VK_NULL_HANDLE;
+		throw std::runtime_error("Failed to create Compute Pipeline");
+	}
+}
+
+VkPipeline ComputeShaderPipeline::CreatePermutationPipeline(Device* device, uint32_t permutation) const {
+	std::vector<MergedSpecialization> specializations;
+	VkComputePipelineCreateInfo permutationCreateInfo = MakeCreateInfo();
+	permutationCreateInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+	permutationCreateInfo.stage = MakePermutationStages(permutations.at(permutation - 1), specializations).at(0);
+	permutationCreateInfo.basePipelineHandle = pipeline;
+	VkPipeline permutationPipeline = VK_NULL_HANDLE;
+	if (device->CreateComputePipelines(pipelineCache, 1, &permutationCreateInfo, nullptr, &permutationPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Compute Pipeline permutation");
+	}
+	return permutationPipeline;
 }
 
 void ComputeShaderPipeline::DestroyPipeline(Device* device) {
+	DestroyPermutationPipelines(device);
 	device->DestroyPipeline(pipeline, nullptr);
 	DestroyShaderStages(device);
+	permutations.clear();
+	permutationCache.clear();
+	currentPermutation = 0;
 }
 
 void ComputeShaderPipeline::SetGroupCounts(uint32_t x, uint32_t y, uint32_t z) {
@@ -36,11 +60,11 @@ void ComputeShaderPipeline::SetGroupCounts(uint32_t x, uint32_t y, uint32_t z) {
 	groupCountZ = z;
 }
 
-void ComputeShaderPipeline::Bind(Device* device, VkCommandBuffer cmdBuffer) {
-	device->CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
-	device->CmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, GetPipelineLayout()->handle, 0, GetPipelineLayout()->vkDescriptorSets.size(), GetPipelineLayout()->vkDescriptorSets.data(), 0, nullptr);
+void ComputeShaderPipeline::Bind(CommandRecorder& commandBuffer) {
+	commandBuffer.BindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, GetCurrentPipeline(), GetPipelineLayout()->handle);
+	GetPipelineLayout()->Bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE);
 }
 
-void ComputeShaderPipeline::Render(Device* device, VkCommandBuffer cmdBuffer, uint32_t /*unused_arg*/) {
-	device->CmdDispatch(cmdBuffer, groupCountX, groupCountY, groupCountZ);
+void ComputeShaderPipeline::Render(CommandRecorder& commandBuffer, uint32_t /*unused_arg*/) {
+	commandBuffer.Dispatch(groupCountX, groupCountY, groupCountZ);
 }
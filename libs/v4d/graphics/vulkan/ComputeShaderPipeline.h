@@ -17,15 +17,18 @@ namespace v4d::graphics::vulkan {
 		ComputeShaderPipeline(PipelineLayout& pipelineLayout, ShaderInfo shaderInfo);
 		virtual ~ComputeShaderPipeline();
 		
-		virtual void CreatePipeline(Device* device) override;
+		virtual void CreateBasePipeline(Device* device) override;
+		virtual VkPipeline CreatePermutationPipeline(Device* device, uint32_t permutation) const override;
 		virtual void DestroyPipeline(Device* device) override;
 		
 		void SetGroupCounts(uint32_t x, uint32_t y, uint32_t z);
 		
 	protected:
+		VkComputePipelineCreateInfo MakeCreateInfo() const;
+		
 		// these two methods are called automatically by Execute() from the parent class
-		virtual void Bind(Device* device, VkCommandBuffer cmdBuffer) override;
-		virtual void Render(Device* device, VkCommandBuffer cmdBuffer, uint32_t _unused_arg_ = 0) override;
+		virtual void Bind(CommandRecorder& commandBuffer) override;
+		virtual void Render(CommandRecorder& commandBuffer, uint32_t _unused_arg_ = 0) override;
 	};
 	
 }
@@ -12,6 +12,8 @@ DescriptorBinding::~DescriptorBinding() {
 				delete (VkDescriptorBufferInfo*)writeInfo;
 			break;
 			case IMAGE_VIEW:
+				delete[] (VkDescriptorImageInfo*)writeInfo;
+			break;
 			case COMBINED_IMAGE_SAMPLER:
 			case INPUT_ATTACHMENT:
 			case INPUT_ATTACHMENT_DEPTH_STENCIL:
@@ -32,6 +34,9 @@ bool DescriptorBinding::IsWriteDescriptorSetValid() const {
 			return ((Buffer*)data)->buffer != VK_NULL_HANDLE;
 		break;
 		case IMAGE_VIEW:
+			for (uint32_t i = 0; i < descriptorCount; ++i) if (((VkImageView*)data)[i] == VK_NULL_HANDLE) return false;
+			return true;
+		break;
 		case INPUT_ATTACHMENT:
 		case INPUT_ATTACHMENT_DEPTH_STENCIL:
 			return *(VkImageView*)data != VK_NULL_HANDLE;
@@ -73,12 +78,15 @@ VkWriteDescriptorSet DescriptorBinding::GetWriteDescriptorSet(VkDescriptorSet de
 			};
 			descriptorWrite.pBufferInfo = (VkDescriptorBufferInfo*)writeInfo;
 		break;
-		case IMAGE_VIEW:
-			writeInfo = new VkDescriptorImageInfo {
-				VK_NULL_HANDLE,// VkSampler sampler
-				*(VkImageView*)data,// VkImageView imageView
-				VK_IMAGE_LAYOUT_GENERAL,// VkImageLayout imageLayout
-			};
+		case IMAGE_VIEW: // data may point to an array of descriptorCount image views
+			writeInfo = new VkDescriptorImageInfo[descriptorCount];
+			for (uint32_t i = 0; i < descriptorCount; ++i) {
+				((VkDescriptorImageInfo*)writeInfo)[i] = {
+					VK_NULL_HANDLE,// VkSampler sampler
+					((VkImageView*)data)[i],// VkImageView imageView
+					VK_IMAGE_LAYOUT_GENERAL,// VkImageLayout imageLayout
+				};
+			}
 			descriptorWrite.pImageInfo = (VkDescriptorImageInfo*)writeInfo;
 		break;
 		case COMBINED_IMAGE_SAMPLER:
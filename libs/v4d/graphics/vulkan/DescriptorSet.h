@@ -73,6 +73,8 @@ namespace v4d::graphics::vulkan {
 		void* data = nullptr;
 		void* writeInfo = nullptr;
 		
+		uint32_t bufferSize = 0; // C++ struct of a buffer, checked against the shaders that use it (0 = not checked)
+		
 		~DescriptorBinding();
 		
 		VkWriteDescriptorSet GetWriteDescriptorSet(VkDescriptorSet descriptorSet);
@@ -97,6 +99,13 @@ namespace v4d::graphics::vulkan {
 		void CreateDescriptorSetLayout(Device* device);
 		void DestroyDescriptorSetLayout(Device* device);
 		
+		// The C++ struct of a buffer binding, or of one element when the shader's block ends with a runtime array,
+		// its size must match the block of every shader that uses this binding when their pipelines are created
+		template<class T>
+		void SetBufferType(uint32_t binding) {
+			bindings.at(binding).bufferSize = sizeof(T);
+		}
+		
 		__V4D_DESCRIPTOR_SET_DEFINE_BINDINGS
 	};
 }
@@ -114,10 +114,35 @@ DepthImage::DepthImage(VkImageUsageFlags usage, const std::vector<VkFormat>& for
 }
 DepthImage::~DepthImage() {}
 
-CubeMapImage::CubeMapImage(VkImageUsageFlags usage, const std::vector<VkFormat>& formats)
+DepthArrayImage::DepthArrayImage(VkImageUsageFlags usage, uint32_t layers, const std::vector<VkFormat>& formats)
 : Image(
 	usage,
 	1,
+	layers,
+	formats
+) {
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+DepthArrayImage::~DepthArrayImage() {}
+
+DepthCubeMapImage::DepthCubeMapImage(VkImageUsageFlags usage, uint32_t cubeCount, const std::vector<VkFormat>& formats)
+: Image(
+	usage,
+	1,
+	6 * cubeCount,
+	formats
+) {
+	imageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+	viewInfo.viewType = cubeCount > 1 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+DepthCubeMapImage::~DepthCubeMapImage() {}
+
+CubeMapImage::CubeMapImage(VkImageUsageFlags usage, const std::vector<VkFormat>& formats, uint32_t mipLevels)
+: Image(
+	usage,
+	std::min(mipLevels, maxMipLevels),
 	6,
 	formats
 ) {
@@ -126,3 +151,25 @@ CubeMapImage::CubeMapImage(VkImageUsageFlags usage, const std::vector<VkFormat>&
 }
 
 CubeMapImage::~CubeMapImage() {}
+
+void CubeMapImage::Create(Device* device, uint32_t width, uint32_t height, const std::vector<VkFormat>& tryFormats, int additionalFormatFeatures) {
+	Image::Create(device, width, height, tryFormats, additionalFormatFeatures);
+	VkImageViewCreateInfo mipViewInfo = viewInfo;
+	mipViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	mipViewInfo.subresourceRange.levelCount = 1;
+	for (uint32_t mip = 0; mip < mipLevels; ++mip) {
+		mipViewInfo.subresourceRange.baseMipLevel = mip;
+		if (device->CreateImageView(&mipViewInfo, nullptr, &mipViews[mip]) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create image view");
+	}
+}
+
+void CubeMapImage::Destroy(Device* device) {
+	for (auto& mipView : mipViews) {
+		if (mipView != VK_NULL_HANDLE) {
+			device->DestroyImageView(mipView, nullptr);
+			mipView = VK_NULL_HANDLE;
+		}
+	}
+	Image::Destroy(device);
+}
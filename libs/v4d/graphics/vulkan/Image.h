@@ -123,13 +123,44 @@ namespace v4d::graphics::vulkan {
 		virtual ~DepthImage();
 	};
 	
+	// Layered depth image sampled as a 2D array, for the cascades of directional light shadows
+	class DepthArrayImage : public Image {
+	public:
+		DepthArrayImage(
+			VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			uint32_t layers = 1,
+			const std::vector<VkFormat>& formats = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT}
+		);
+		virtual ~DepthArrayImage();
+	};
+	
+	// Depth cube maps of omnidirectional shadows, rendered as a layered framebuffer (6 layers per cube, +X -X +Y -Y +Z -Z)
+	class DepthCubeMapImage : public Image {
+	public:
+		DepthCubeMapImage(
+			VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			uint32_t cubeCount = 1,
+			const std::vector<VkFormat>& formats = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT}
+		);
+		virtual ~DepthCubeMapImage();
+	};
+	
 	class CubeMapImage : public Image {
 	public:
+		static constexpr uint32_t maxMipLevels = 16;
+		
+		// After Create(), one 2D array view (6 layers) per mip level, for layered framebuffers and storage writes
+		std::array<VkImageView, maxMipLevels> mipViews {};
+		
 		CubeMapImage(
 			VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			const std::vector<VkFormat>& formats = {VK_FORMAT_R32G32B32A32_SFLOAT}
+			const std::vector<VkFormat>& formats = {VK_FORMAT_R32G32B32A32_SFLOAT},
+			uint32_t mipLevels = 1
 		);
 		virtual ~CubeMapImage();
+		
+		virtual void Create(Device* device, uint32_t width, uint32_t height, const std::vector<VkFormat>& tryFormats = {}, int additionalFormatFeatures = 0) override;
+		virtual void Destroy(Device* device) override;
 	};
 	
 }
@@ -2,6 +2,16 @@
 
 using namespace v4d::graphics::vulkan;
 
+namespace {
+	// Pipeline layouts with the same descriptor set layouts and push constant ranges share one VkPipelineLayout, released with its last user
+	struct SharedPipelineLayout {
+		VkPipelineLayout handle;
+		uint32_t users;
+	};
+	std::mutex sharedPipelineLayoutsMutex;
+	std::map<std::pair<Device*, std::string>, SharedPipelineLayout> sharedPipelineLayouts;
+}
+
 std::vector<VkDescriptorSetLayout>* PipelineLayout::GetDescriptorSetLayouts() {
 	return &layouts;
 }
@@ -14,10 +24,53 @@ void PipelineLayout::AddPushConstant(const VkPushConstantRange& pushConstant) {
 	pushConstants.push_back(pushConstant);
 }
 
+void PipelineLayout::SetReflectedPushConstants(const std::vector<ShaderReflection::PushConstantBlock>& blocks) {
+	pushConstantRanges.clear();
+	if (blocks.empty()) return;
+	// End of each stage's block, the largest one when several programs use this layout
+	std::map<VkShaderStageFlags, uint32_t> stageEnds;
+	for (auto& block : blocks) {
+		stageEnds[block.stageFlags] = std::max(stageEnds[block.stageFlags], block.size);
+	}
+	std::map<uint32_t, VkShaderStageFlags> endStages;
+	for (auto&[stage, end] : stageEnds) {
+		endStages[end] |= stage;
+	}
+	for (auto&[end, stages] : endStages) {
+		pushConstantRanges.push_back({stages, 0, end});
+	}
+}
+
 void PipelineLayout::Create(Device* device) {
 	for (auto* set : descriptorSets) {
 		layouts.push_back(set->GetDescriptorSetLayout());
 	}
+	if (pushConstantRanges.empty()) pushConstantRanges = pushConstants;
+	
+	// Push constant updates, each byte of a struct goes to all the stages whose range has it, and only to them
+	pushConstantUpdates.clear();
+	for (auto& pushConstant : pushConstants) {
+		auto& updates = pushConstantUpdates.emplace_back();
+		std::vector<uint32_t> bounds {pushConstant.offset, pushConstant.offset + pushConstant.size};
+		for (auto& range : pushConstantRanges) {
+			bounds.push_back(std::clamp(range.offset, pushConstant.offset, pushConstant.offset + pushConstant.size));
+			bounds.push_back(std::clamp(range.offset + range.size, pushConstant.offset, pushConstant.offset + pushConstant.size));
+		}
+		std::sort(bounds.begin(), bounds.end());
+		bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+		for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+			VkShaderStageFlags stages = 0;
+			for (auto& range : pushConstantRanges) {
+				if (range.offset <= bounds[i] && bounds[i+1] <= range.offset + range.size) stages |= range.stageFlags;
+			}
+			if (stages == 0) continue;
+			if (!updates.empty() && updates.back().stageFlags == stages && updates.back().offset + updates.back().size == bounds[i]) {
+				updates.back().size += bounds[i+1] - bounds[i];
+			} else {
+				updates.push_back({stages, bounds[i], bounds[i+1] - bounds[i]});
+			}
+		}
+	}
 	
 	// Pipeline Layout
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
@@ -30,13 +83,23 @@ void PipelineLayout::Create(Device* device) {
 	}
 
 	// Push constants
-	if (pushConstants.size() > 0) {
-		pipelineLayoutInfo.pushConstantRangeCount = pushConstants.size();
-		pipelineLayoutInfo.pPushConstantRanges = pushConstants.data();
+	if (pushConstantRanges.size() > 0) {
+		pipelineLayoutInfo.pushConstantRangeCount = pushConstantRanges.size();
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
 	}
 
-	if (device->CreatePipelineLayout(&pipelineLayoutInfo, nullptr, &handle) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create pipeline layout");
+	sharedKey.assign(reinterpret_cast<const char*>(layouts.data()), layouts.size() * sizeof(VkDescriptorSetLayout));
+	sharedKey.append(reinterpret_cast<const char*>(pushConstantRanges.data()), pushConstantRanges.size() * sizeof(VkPushConstantRange));
+	std::lock_guard lock(sharedPipelineLayoutsMutex);
+	auto shared = sharedPipelineLayouts.find({device, sharedKey});
+	if (shared != sharedPipelineLayouts.end()) {
+		handle = shared->second.handle;
+		shared->second.users++;
+	} else {
+		if (device->CreatePipelineLayout(&pipelineLayoutInfo, nullptr, &handle) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline layout");
+		}
+		sharedPipelineLayouts[{device, sharedKey}] = {handle, 1};
 	}
 	
 	// Descriptor sets array
@@ -48,8 +111,18 @@ void PipelineLayout::Create(Device* device) {
 
 void PipelineLayout::Destroy(Device* device) {
 	vkDescriptorSets.clear();
-	device->DestroyPipelineLayout(handle, nullptr);
+	{
+		std::lock_guard lock(sharedPipelineLayoutsMutex);
+		auto shared = sharedPipelineLayouts.find({device, sharedKey});
+		if (shared != sharedPipelineLayouts.end() && --shared->second.users == 0) {
+			device->DestroyPipelineLayout(handle, nullptr);
+			sharedPipelineLayouts.erase(shared);
+		}
+	}
+	handle = VK_NULL_HANDLE;
 	layouts.clear();
+	pushConstantRanges.clear();
+	pushConstantUpdates.clear();
 }
 
 void PipelineLayout::Bind(Device* device, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint) {
@@ -57,7 +130,24 @@ void PipelineLayout::Bind(Device* device, VkCommandBuffer commandBuffer, VkPipel
 		device->CmdBindDescriptorSets(commandBuffer, bindPoint, handle, 0, (uint)vkDescriptorSets.size(), vkDescriptorSets.data(), 0, nullptr);
 }
 
+void PipelineLayout::Bind(CommandRecorder& commandBuffer, VkPipelineBindPoint bindPoint) {
+	commandBuffer.BindDescriptorSets(bindPoint, handle, 0, (uint)vkDescriptorSets.size(), vkDescriptorSets.data());
+}
+
+void PipelineLayout::PushConstants(Device* device, VkCommandBuffer commandBuffer, const void* data, int pushConstantIndex) {
+	for (auto& update : pushConstantUpdates[pushConstantIndex]) {
+		device->CmdPushConstants(commandBuffer, handle, update.stageFlags, update.offset, update.size, static_cast<const char*>(data) + (update.offset - pushConstants[pushConstantIndex].offset));
+	}
+}
+
+void PipelineLayout::PushConstants(CommandRecorder& commandBuffer, const void* data, int pushConstantIndex) {
+	for (auto& update : pushConstantUpdates[pushConstantIndex]) {
+		commandBuffer.PushConstants(handle, update.stageFlags, update.offset, update.size, static_cast<const char*>(data) + (update.offset - pushConstants[pushConstantIndex].offset));
+	}
+}
+
 void PipelineLayout::Reset() {
 	descriptorSets.clear();
 	pushConstants.clear();
+	pushConstantRanges.clear();
 }
@@ -13,9 +13,11 @@ namespace v4d::graphics::vulkan {
 		std::vector<DescriptorSet*> descriptorSets {};
 		std::vector<VkDescriptorSetLayout> layouts {};
 		std::vector<VkDescriptorSet> vkDescriptorSets {};
-		std::vector<VkPushConstantRange> pushConstants {};
+		std::vector<VkPushConstantRange> pushConstants {}; // C++ structs, by index, with the stages they are declared for
+		std::vector<VkPushConstantRange> pushConstantRanges {}; // of the VkPipelineLayout, per stage from the reflection, or the declared ones
 
-		VkPipelineLayout handle = VK_NULL_HANDLE;
+		VkPipelineLayout handle = VK_NULL_HANDLE; // shared with the other pipeline layouts that have the same sets and push constants
+		std::string sharedKey {};
 		
 		std::vector<VkDescriptorSetLayout>* GetDescriptorSetLayouts();
 
@@ -25,15 +27,29 @@ namespace v4d::graphics::vulkan {
 		void AddDescriptorSet(DescriptorSet* descriptorSet);
 		
 		void AddPushConstant(const VkPushConstantRange&);
+		// the stage flags are only used until SetReflectedPushConstants() replaces them with the stages that read it
 		template<class T>
-		void AddPushConstant(VkShaderStageFlags flags) {
+		void AddPushConstant(VkShaderStageFlags flags = VK_SHADER_STAGE_ALL) {
 			AddPushConstant({flags, 0, sizeof(T)});
 		}
 		
+		// Push constant ranges from the blocks that the shaders using this layout declare, to be called before Create().
+		// Each stage gets a range from the start up to the end of its own block, stages ending at the same byte share it.
+		// Without any block, the declared ranges are used.
+		void SetReflectedPushConstants(const std::vector<ShaderReflection::PushConstantBlock>& blocks);
+		
 		// clears descriptor sets and push constants
 		void Reset();
 		
 		void Bind(Device* device, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+		void Bind(CommandRecorder& commandBuffer, VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+		
+		// Records the C++ struct of a push constant, split where the stages that read it change, the bytes that no stage reads are not sent
+		void PushConstants(Device* device, VkCommandBuffer commandBuffer, const void* data, int pushConstantIndex = 0);
+		void PushConstants(CommandRecorder& commandBuffer, const void* data, int pushConstantIndex = 0);
+		
+	private:
+		std::vector<std::vector<VkPushConstantRange>> pushConstantUpdates {}; // per C++ struct, made by Create()
 		
 	};
 }
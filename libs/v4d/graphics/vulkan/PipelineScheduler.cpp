@@ -0,0 +1,152 @@
+#include "../../common.h"
+#include "../../utilities/ThreadPool.h"
+
+#include <filesystem>
+
+using namespace v4d::graphics::vulkan;
+
+namespace {
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+void PipelineScheduler::CreatePipelineCache(Device* device, const std::string& filepath) {
+	pipelineCacheFile = filepath;
+	std::vector<char> data;
+	if (!filepath.empty()) {
+		std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+		if (file.is_open()) {
+			data.resize((size_t)file.tellg());
+			file.seekg(0);
+			file.read(data.data(), data.size());
+			if (!file) data.clear();
+		}
+	}
+	VkPipelineCacheCreateInfo createInfo {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+	if (device->CreatePipelineCache(&createInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+		// Data that the driver rejects, start with an empty cache
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		if (device->CreatePipelineCache(&createInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+			LOG_WARN("Failed to create pipeline cache, pipelines are created without it")
+			pipelineCache = VK_NULL_HANDLE;
+		}
+	}
+}
+
+void PipelineScheduler::DestroyPipelineCache(Device* device) {
+	if (pipelineCache == VK_NULL_HANDLE) return;
+	Wait();
+	if (!pipelineCacheFile.empty()) {
+		size_t size = 0;
+		if (device->GetPipelineCacheData(pipelineCache, &size, nullptr) == VK_SUCCESS && size > 0) {
+			std::vector<char> data(size);
+			if (device->GetPipelineCacheData(pipelineCache, &size, data.data()) == VK_SUCCESS) {
+				std::error_code error;
+				auto directory = std::filesystem::path(pipelineCacheFile).parent_path();
+				if (!directory.empty()) std::filesystem::create_directories(directory, error);
+				std::ofstream file(pipelineCacheFile, std::ios::binary | std::ios::trunc);
+				file.write(data.data(), size);
+				if (!file) LOG_WARN("Failed to write pipeline cache '" << pipelineCacheFile << "'")
+			}
+		}
+	}
+	device->DestroyPipelineCache(pipelineCache, nullptr);
+	pipelineCache = VK_NULL_HANDLE;
+}
+
+void PipelineScheduler::Add(ShaderPipeline* pipeline, const std::string& name, bool backgroundPermutations) {
+	jobs.push_back({pipeline, name, backgroundPermutations});
+}
+
+void PipelineScheduler::Build(Device* device, v4d::utilities::ThreadPool& threadPool) {
+	auto start = std::chrono::high_resolution_clock::now();
+	
+	// Pipelines with the most permutations to create first, the others fill in around them
+	std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b){
+		return (a.backgroundPermutations? 1 : a.pipeline->GetPermutationCount()) > (b.backgroundPermutations? 1 : b.pipeline->GetPermutationCount());
+	});
+	
+	std::vector<double> milliseconds(jobs.size(), 0);
+	std::vector<std::exception_ptr> errors(jobs.size());
+	threadPool.ParallelFor(jobs.size(), 1, [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; ++i) {
+			auto jobStart = std::chrono::high_resolution_clock::now();
+			try {
+				jobs[i].pipeline->pipelineCache = pipelineCache;
+				if (jobs[i].backgroundPermutations) {
+					jobs[i].pipeline->CreateBasePipeline(device);
+				} else {
+					jobs[i].pipeline->CreatePipeline(device);
+				}
+			} catch (...) {
+				errors[i] = std::current_exception();
+			}
+			milliseconds[i] = MillisecondsSince(jobStart);
+		}
+	});
+	
+	timings.clear();
+	std::ostringstream report;
+	double total = 0;
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		timings[jobs[i].name] += milliseconds[i];
+		total += milliseconds[i];
+		report << (i > 0 ? ", " : "") << jobs[i].name << " " << milliseconds[i];
+	}
+	LOG("Pipelines : " << jobs.size() << " created in " << MillisecondsSince(start) << " ms (" << total << " ms on " << (threadPool.GetThreadCount() + 1) << " threads) : " << report.str())
+	
+	std::vector<Job> built = std::move(jobs);
+	jobs.clear();
+	for (auto& error : errors) {
+		if (error) std::rethrow_exception(error);
+	}
+	
+	// Derived from the base pipelines that exist now
+	for (auto& job : built) {
+		if (!job.backgroundPermutations) continue;
+		for (uint32_t permutation = 1; permutation < job.pipeline->GetPermutationCount(); ++permutation) {
+			ShaderPipeline* pipeline = job.pipeline;
+			pending.push_back({pipeline, job.name, permutation, threadPool.Enqueue([pipeline, device, permutation]{
+				auto permutationStart = std::chrono::high_resolution_clock::now();
+				VkPipeline permutationPipeline = pipeline->CreatePermutationPipeline(device, permutation);
+				return PermutationResult{permutationPipeline, MillisecondsSince(permutationStart)};
+			})});
+		}
+	}
+}
+
+size_t PipelineScheduler::Update() {
+	size_t ready = 0;
+	for (auto it = pending.begin(); it != pending.end();) {
+		if (it->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++it;
+			continue;
+		}
+		try {
+			auto result = it->result.get();
+			it->pipeline->SetPermutationPipeline(it->permutation, result.pipeline);
+			timings[it->name] += result.milliseconds;
+			ready++;
+		} catch (std::exception& e) {
+			// The base pipeline stays in its place
+			LOG_ERROR("Pipeline '" << it->name << "' permutation " << it->permutation << " : " << e.what())
+		}
+		it = pending.erase(it);
+		if (pending.empty()) {
+			LOG("Pipelines : background permutations ready")
+		}
+	}
+	return ready;
+}
+
+void PipelineScheduler::Wait() {
+	for (auto& permutation : pending) {
+		permutation.result.wait();
+	}
+	Update();
+}
@@ -0,0 +1,74 @@
+/*
+ * Vulkan pipeline build scheduler
+ * Part of the Vulkan4D open-source game engine under the LGPL license - https://github.com/Vulkan4D
+ *
+ * Creates the pipelines of a renderer concurrently on a thread pool, with one VkPipelineCache shared by all of them.
+ * Permutations that are not needed for the first frames may be created in the background, the base pipeline is bound in their place until they are ready.
+ */
+#pragma once
+#include "../../common.h"
+
+#include <future>
+
+namespace v4d::utilities {
+	class ThreadPool;
+}
+
+namespace v4d::graphics::vulkan {
+
+	class PipelineScheduler {
+	public:
+		PipelineScheduler() = default;
+		PipelineScheduler(const PipelineScheduler&) = delete;
+		PipelineScheduler& operator=(const PipelineScheduler&) = delete;
+		
+		// The cache's data is loaded from filepath if it exists (the driver ignores data from another device or driver version),
+		// and saved there when the cache is destroyed. An empty filepath keeps the cache in memory only.
+		void CreatePipelineCache(Device* device, const std::string& filepath = "");
+		void DestroyPipelineCache(Device* device);
+		VkPipelineCache GetPipelineCache() const {return pipelineCache;}
+		
+		// Pipelines are configured on the calling thread, then added here instead of calling their CreatePipeline().
+		// With backgroundPermutations, Build() returns as soon as the base pipeline exists and its permutations are created in the background.
+		void Add(ShaderPipeline* pipeline, const std::string& name, bool backgroundPermutations = false);
+		
+		// Creates the added pipelines concurrently on the thread pool and the calling thread, then queues their background permutations.
+		// Throws the first error once all of them are done.
+		void Build(Device* device, v4d::utilities::ThreadPool& threadPool);
+		
+		// On the thread that renders, gives the background permutations that are ready to their pipeline. Returns how many were given.
+		size_t Update();
+		
+		// Waits for all the background permutations then gives them to their pipeline, before the pipelines are destroyed or recreated
+		void Wait();
+		
+		bool IsBuilding() const {return !pending.empty();}
+		
+		// Creation time in milliseconds of each pipeline of the last Build(), its background permutations are added when they are ready
+		const std::map<std::string, double>& GetTimings() const {return timings;}
+		
+	private:
+		struct Job {
+			ShaderPipeline* pipeline;
+			std::string name;
+			bool backgroundPermutations;
+		};
+		struct PermutationResult {
+			VkPipeline pipeline;
+			double milliseconds;
+		};
+		struct PendingPermutation {
+			ShaderPipeline* pipeline;
+			std::string name;
+			uint32_t permutation;
+			std::future<PermutationResult> result;
+		};
+		
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		std::string pipelineCacheFile {};
+		std::vector<Job> jobs {};
+		std::vector<PendingPermutation> pending {};
+		std::map<std::string, double> timings {};
+	};
+	
+}
@@ -76,27 +76,16 @@ void RasterShaderPipeline::SetData(uint32_t vertexCount) {
 	this->indexOffset = 0;
 }
 
-void RasterShaderPipeline::CreatePipeline(Device* device) {
+void RasterShaderPipeline::SetInstanceData(Buffer* instanceBuffer, uint32_t firstInstance) {
+	this->instanceBuffer = instanceBuffer;
+	this->firstInstance = firstInstance;
+}
+
+void RasterShaderPipeline::CreateBasePipeline(Device* device) {
 	CreateShaderStages(device);
 	
-	VkPipelineViewportStateCreateInfo viewportState {};
-	VkViewport viewport {};
-	VkRect2D scissor {};
 	if (pipelineCreateInfo.pViewportState == nullptr) {
-		viewport.x = 0;
-		viewport.y = 0;
-		viewport.width = (float) renderTarget->width;
-		viewport.height = (float) renderTarget->height;
-		viewport.minDepth = 0;
-		viewport.maxDepth = renderTarget->imageInfo.extent.depth;
-		scissor.offset = {0, 0};
-		scissor.extent = {renderTarget->width, renderTarget->height};
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.scissorCount = 1;
-		viewportState.pViewports = &viewport;
-		viewportState.pScissors = &scissor;
-		pipelineCreateInfo.pViewportState = &viewportState;
+		pipelineCreateInfo.pViewportState = &dynamicViewportState;
 	}
 	
 	// Bindings and Attributes
@@ -106,13 +95,15 @@ void RasterShaderPipeline::CreatePipeline(Device* device) {
 	vertexInputInfo.pVertexAttributeDescriptions = GetAttributes()->data();
 
 	// Dynamic states
-	if (dynamicStates.size() > 0) {
-		dynamicStateCreateInfo.dynamicStateCount = (uint)dynamicStates.size();
-		dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
-		pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
-	} else {
-		pipelineCreateInfo.pDynamicState = nullptr;
+	pipelineDynamicStates = dynamicStates;
+	for (auto state : {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR}) {
+		if (std::find(pipelineDynamicStates.begin(), pipelineDynamicStates.end(), state) == pipelineDynamicStates.end()) {
+			pipelineDynamicStates.push_back(state);
+		}
 	}
+	dynamicStateCreateInfo.dynamicStateCount = (uint)pipelineDynamicStates.size();
+	dynamicStateCreateInfo.pDynamicStates = pipelineDynamicStates.data();
+	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
 	
 	pipelineCreateInfo.layout = GetPipelineLayout()->handle;
 
@@ -129,16 +120,37 @@ void RasterShaderPipeline::CreatePipeline(Device* device) {
 	pipelineCreateInfo.stageCount = GetStages()->size();
 	pipelineCreateInfo.pStages = GetStages()->data();
 	
-	// Create the actual pipeline
-	if (device->CreateGraphicsPipelines(VK_NULL_HANDLE/*pipelineCache*/, 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	// Create the actual pipeline, permutations are derived from it
+	pipelineCreateInfo.flags = permutations.size() > 0 ? VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT : 0;
+	if (device->CreateGraphicsPipelines(pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		pipeline = VK_NULL_HANDLE;
 		throw std::runtime_error("Failed to create Graphics Pipeline");
 	}
 }
 
+VkPipeline RasterShaderPipeline::CreatePermutationPipeline(Device* device, uint32_t permutation) const {
+	std::vector<MergedSpecialization> specializations;
+	auto permutationStages = MakePermutationStages(permutations.at(permutation - 1), specializations);
+	VkGraphicsPipelineCreateInfo permutationCreateInfo = pipelineCreateInfo;
+	permutationCreateInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+	permutationCreateInfo.basePipelineHandle = pipeline;
+	permutationCreateInfo.basePipelineIndex = -1;
+	permutationCreateInfo.pStages = permutationStages.data();
+	VkPipeline permutationPipeline = VK_NULL_HANDLE;
+	if (device->CreateGraphicsPipelines(pipelineCache, 1, &permutationCreateInfo, nullptr, &permutationPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Graphics Pipeline permutation");
+	}
+	return permutationPipeline;
+}
+
 void RasterShaderPipeline::DestroyPipeline(Device* device) {
+	DestroyPermutationPipelines(device);
 	device->DestroyPipeline(pipeline, nullptr);
 	DestroyShaderStages(device);
 	colorBlendAttachments.clear();
+	permutations.clear();
+	permutationCache.clear();
+	currentPermutation = 0;
 }
 
 void RasterShaderPipeline::SetRenderPass(VkPipelineViewportStateCreateInfo* viewportState, VkRenderPass renderPass, uint32_t subpass) {
@@ -147,8 +159,8 @@ void RasterShaderPipeline::SetRenderPass(VkPipelineViewportStateCreateInfo* view
 	pipelineCreateInfo.subpass = subpass;
 }
 
-void RasterShaderPipeline::SetRenderPass(SwapChain* swapChain, VkRenderPass renderPass, uint32_t subpass) {
-	pipelineCreateInfo.pViewportState = &swapChain->viewportState;
+void RasterShaderPipeline::SetRenderPass(SwapChain*, VkRenderPass renderPass, uint32_t subpass) {
+	pipelineCreateInfo.pViewportState = nullptr;
 	pipelineCreateInfo.renderPass = renderPass;
 	pipelineCreateInfo.subpass = subpass;
 }
@@ -182,38 +194,44 @@ void RasterShaderPipeline::AddColorBlendAttachmentState(
 	});
 }
 
-void RasterShaderPipeline::Bind(Device* device, VkCommandBuffer cmdBuffer) {
-	device->CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-	GetPipelineLayout()->Bind(device, cmdBuffer);
+void RasterShaderPipeline::Bind(CommandRecorder& commandBuffer) {
+	commandBuffer.BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, GetCurrentPipeline(), GetPipelineLayout()->handle);
+	GetPipelineLayout()->Bind(commandBuffer);
 }
 
-void RasterShaderPipeline::Render(Device* device, VkCommandBuffer cmdBuffer, uint32_t instanceCount) {
+void RasterShaderPipeline::Render(CommandRecorder& commandBuffer, uint32_t instanceCount) {
 	if (vertexBuffer == nullptr) {
-		device->CmdDraw(cmdBuffer,
+		commandBuffer.Draw(
 			vertexCount, // vertexCount
 			instanceCount, // instanceCount
 			0, // firstVertex (defines the lowest value of gl_VertexIndex)
-			0  // firstInstance (defines the lowest value of gl_InstanceIndex)
+			firstInstance  // firstInstance (defines the lowest value of gl_InstanceIndex)
 		);
 	} else {
-		device->CmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexBuffer->buffer, &vertexOffset);
+		if (instanceBuffer) {
+			VkBuffer buffers[] {vertexBuffer->buffer, instanceBuffer->buffer};
+			VkDeviceSize offsets[] {vertexOffset, 0};
+			commandBuffer.BindVertexBuffers(0, 2, buffers, offsets);
+		} else {
+			commandBuffer.BindVertexBuffers(0, 1, &vertexBuffer->buffer, &vertexOffset);
+		}
 		if (indexBuffer == nullptr) {
 			// Draw vertices
-			device->CmdDraw(cmdBuffer,
+			commandBuffer.Draw(
 				vertexCount, // vertexCount
 				instanceCount, // instanceCount
 				0, // firstVertex (defines the lowest value of gl_VertexIndex)
-				0  // firstInstance (defines the lowest value of gl_InstanceIndex)
+				firstInstance  // firstInstance (defines the lowest value of gl_InstanceIndex)
 			);
 		} else {
 			// Draw indices
-			device->CmdBindIndexBuffer(cmdBuffer, indexBuffer->buffer, indexOffset, VK_INDEX_TYPE_UINT32);
-			device->CmdDrawIndexed(cmdBuffer,
+			commandBuffer.BindIndexBuffer(indexBuffer->buffer, indexOffset, VK_INDEX_TYPE_UINT32);
+			commandBuffer.DrawIndexed(
 				indexCount, // indexCount
 				instanceCount, // instanceCount
 				0, // firstIndex
 				0, // vertexOffset (0 because we are already taking an offseted vertex buffer)
-				0  // firstInstance (defines the lowest value of gl_InstanceIndex)
+				firstInstance  // firstInstance (defines the lowest value of gl_InstanceIndex)
 			);
 		}
 	}
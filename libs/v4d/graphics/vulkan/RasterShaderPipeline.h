@@ -13,6 +13,18 @@ namespace v4d::graphics::vulkan {
 	class RasterShaderPipeline : public ShaderPipeline {
 		VkGraphicsPipelineCreateInfo pipelineCreateInfo {};
 		Image* renderTarget;
+		
+		// The viewport and the scissor are always dynamic, RenderPass::Begin() sets them to the whole render area,
+		// so that the pipeline does not depend on the size of its render target and is kept when the swap chain is recreated
+		VkPipelineViewportStateCreateInfo dynamicViewportState {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			nullptr, // const void* pNext
+			0, // VkPipelineViewportStateCreateFlags flags
+			1, // uint32_t viewportCount
+			nullptr, // const VkViewport* pViewports
+			1, // uint32_t scissorCount
+			nullptr // const VkRect2D* pScissors
+		};
+		std::vector<VkDynamicState> pipelineDynamicStates {}; // dynamicStates, with the viewport and the scissor
 	public:
 		
 		// Data to draw
@@ -23,6 +35,10 @@ namespace v4d::graphics::vulkan {
 		uint32_t indexCount = 0;
 		VkDeviceSize indexOffset = 0;
 		
+		// Per-instance data (bound to the vertex input binding 1, if any)
+		Buffer* instanceBuffer = nullptr;
+		uint32_t firstInstance = 0;
+		
 		// Graphics Pipeline information
 		VkPipelineRasterizationStateCreateInfo rasterizer {VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
 			nullptr, // const void* pNext
@@ -72,7 +88,7 @@ namespace v4d::graphics::vulkan {
 		std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments {};
 		VkPipelineColorBlendStateCreateInfo colorBlending {};
 		VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo {};
-		std::vector<VkDynamicState> dynamicStates {}; // Dynamic settings that CAN be changed at runtime but preferably NOT every frame
+		std::vector<VkDynamicState> dynamicStates {}; // Dynamic settings that CAN be changed at runtime but preferably NOT every frame, in addition to the viewport and the scissor
 		
 		RasterShaderPipeline(PipelineLayout& pipelineLayout, const std::vector<ShaderInfo>& shaderInfo);
 		virtual ~RasterShaderPipeline();
@@ -83,11 +99,15 @@ namespace v4d::graphics::vulkan {
 		void SetData(Buffer* vertexBuffer, uint32_t vertexCount);
 		void SetData(Buffer* vertexBuffer, VkDeviceSize vertexOffset, uint32_t vertexCount);
 		void SetData(uint32_t vertexCount);
+		
+		// set the per-instance buffer, firstInstance is the index of the first instance to draw within that buffer
+		void SetInstanceData(Buffer* instanceBuffer, uint32_t firstInstance = 0);
 
-		virtual void CreatePipeline(Device* device) override;
+		virtual void CreateBasePipeline(Device* device) override;
+		virtual VkPipeline CreatePermutationPipeline(Device* device, uint32_t permutation) const override;
 		virtual void DestroyPipeline(Device* device) override;
 		
-		// assign render pass
+		// assign render pass, only the counts of a given viewportState are used since the viewports and scissors are dynamic
 		void SetRenderPass(VkPipelineViewportStateCreateInfo* viewportState, VkRenderPass, uint32_t subpass = 0);
 		void SetRenderPass(SwapChain*, VkRenderPass, uint32_t subpass = 0);
 		void SetRenderPass(Image* renderTarget, VkRenderPass, uint32_t subpass = 0);
@@ -105,8 +125,8 @@ namespace v4d::graphics::vulkan {
 		
 	protected:
 		// these two methods are called automatically by Execute() from the parent class
-		virtual void Bind(Device* device, VkCommandBuffer cmdBuffer) override;
-		virtual void Render(Device* device, VkCommandBuffer cmdBuffer, uint32_t instanceCount = 1) override;
+		virtual void Bind(CommandRecorder& commandBuffer) override;
+		virtual void Render(CommandRecorder& commandBuffer, uint32_t instanceCount = 1) override;
 	};
 	
 }
@@ -115,9 +115,15 @@ void RenderPass::DestroyFrameBuffers(Device* device) {
 	for (auto framebuffer : frameBuffers) {
 		device->DestroyFramebuffer(framebuffer, nullptr);
 	}
+	frameBuffers.clear();
 }
 
 void RenderPass::Begin(Device* device, VkCommandBuffer commandBuffer, VkOffset2D offset, VkExtent2D extent, const std::vector<VkClearValue>& clearValues, int imageIndex, VkSubpassContents contents) {
+	CommandRecorder recorder(device, commandBuffer);
+	Begin(recorder, offset, extent, clearValues, imageIndex, contents);
+}
+
+void RenderPass::Begin(CommandRecorder& commandBuffer, VkOffset2D offset, VkExtent2D extent, const std::vector<VkClearValue>& clearValues, int imageIndex, VkSubpassContents contents) {
 	VkRenderPassBeginInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = handle;
@@ -126,7 +132,13 @@ void RenderPass::Begin(Device* device, VkCommandBuffer commandBuffer, VkOffset2D
 	renderPassInfo.renderArea.extent = extent;
 	renderPassInfo.clearValueCount = clearValues.size();
 	renderPassInfo.pClearValues = clearValues.data();
-    device->CmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+    commandBuffer.GetDevice()->CmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+	
+	// Viewport and scissor are dynamic in all raster pipelines, secondary command buffers set their own
+	if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+		commandBuffer.SetViewport({(float)offset.x, (float)offset.y, (float)extent.width, (float)extent.height, 0, 1});
+		commandBuffer.SetScissor(renderPassInfo.renderArea);
+	}
 }
 
 void RenderPass::Begin(Device* device, VkCommandBuffer commandBuffer, SwapChain* swapChain, const std::vector<VkClearValue>& clearValues, int imageIndex, VkSubpassContents contents) {
@@ -137,6 +149,18 @@ void RenderPass::Begin(Device* device, VkCommandBuffer commandBuffer, Image& tar
 	Begin(device, commandBuffer, {0,0}, {target.width, target.height}, clearValues, imageIndex, contents);
 }
 
+void RenderPass::Begin(CommandRecorder& commandBuffer, SwapChain* swapChain, const std::vector<VkClearValue>& clearValues, int imageIndex, VkSubpassContents contents) {
+	Begin(commandBuffer, {0,0}, swapChain->extent, clearValues, imageIndex, contents);
+}
+
+void RenderPass::Begin(CommandRecorder& commandBuffer, Image& target, const std::vector<VkClearValue>& clearValues, int imageIndex, VkSubpassContents contents) {
+	Begin(commandBuffer, {0,0}, {target.width, target.height}, clearValues, imageIndex, contents);
+}
+
 void RenderPass::End(Device* device, VkCommandBuffer commandBuffer) {
 	device->CmdEndRenderPass(commandBuffer);
 }
+
+void RenderPass::End(CommandRecorder& commandBuffer) {
+	End(commandBuffer.GetDevice(), commandBuffer);
+}
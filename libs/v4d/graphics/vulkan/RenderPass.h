@@ -50,6 +50,7 @@ namespace v4d::graphics::vulkan {
 		
 		void DestroyFrameBuffers(Device* device);
 		
+		// Also sets the viewport and the scissor to the render area, for inline contents
 		void Begin(
 			Device*,
 			VkCommandBuffer,
@@ -75,8 +76,32 @@ namespace v4d::graphics::vulkan {
 			int imageIndex = 0,
 			VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE
 		);
+		// Same, with the viewport and the scissor tracked by the recorder
+		void Begin(
+			CommandRecorder&,
+			VkOffset2D,
+			VkExtent2D,
+			const std::vector<VkClearValue>&,
+			int imageIndex = 0,
+			VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE
+		);
+		void Begin(
+			CommandRecorder&,
+			SwapChain*,
+			const std::vector<VkClearValue>&,
+			int imageIndex = 0,
+			VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE
+		);
+		void Begin(
+			CommandRecorder&,
+			Image& target,
+			const std::vector<VkClearValue>& = {},
+			int imageIndex = 0,
+			VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE
+		);
 		
 		void End(Device* device, VkCommandBuffer commandBuffer);
+		void End(CommandRecorder& commandBuffer);
 		
 	};
 }
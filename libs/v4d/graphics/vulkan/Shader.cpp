@@ -5,15 +5,12 @@ using namespace v4d::graphics::vulkan;
 Shader::Shader(std::string filepath, std::string entryPoint, VkSpecializationInfo* specializationInfo)
 : filepath(filepath), entryPoint(entryPoint), specializationInfo(specializationInfo) {
 	// Automatically add .spv if not present at the end of the filepath
-	if (!std::regex_match(filepath, std::regex(R"(\.spv$)"))) {
+	if (filepath.size() < 4 || filepath.compare(filepath.size() - 4, 4, ".spv") != 0) {
 		filepath += ".spv";
 	}
 
-	// Validate filepath
-	std::regex filepathRegex{R"(^(.*/|)([^/]+)\.([^\.]+)(\.spv)$)"};
-	if (!std::regex_match(filepath, filepathRegex)) {
-		throw std::runtime_error("Invalid shader file path '" + filepath + "'");
-	}
+	ParseFilepath(filepath);
+	stage = SHADER_TYPES.at(type);
 
 	// Read the file
 	std::ifstream file(filepath, std::fstream::ate | std::fstream::binary);
@@ -22,26 +19,75 @@ Shader::Shader(std::string filepath, std::string entryPoint, VkSpecializationInf
 	}
 
 	// Parse the file
-	name = std::regex_replace(filepath, filepathRegex, "$2");
-	type = std::regex_replace(filepath, filepathRegex, "$3");
-	auto stageFlagBits = SHADER_TYPES[type];
-	if (!stageFlagBits) {
-		throw std::runtime_error("Invalid Shader Type " + type);
-	}
 	size_t fileSize = (size_t) file.tellg();
 	bytecode.resize(fileSize);
 	file.seekg(0);
 	file.read(bytecode.data(), fileSize);
 	file.close();
+	
+	Reflect();
+
+}
+
+Shader::Shader(std::string filepath, std::vector<char>&& bytecode, std::string entryPoint, VkSpecializationInfo* specializationInfo)
+: filepath(filepath), entryPoint(entryPoint), specializationInfo(specializationInfo), bytecode(std::move(bytecode)) {
+	ParseFilepath(filepath + ".spv");
+	stage = SHADER_TYPES.at(type);
+	Reflect();
+}
+
+Shader::Shader(std::string filepath, std::shared_ptr<const ShaderArchive> archive, const ShaderArchive::Entry& entry, std::string entryPoint, VkSpecializationInfo* specializationInfo)
+: filepath(filepath), entryPoint(entryPoint), specializationInfo(specializationInfo), archive(archive), mappedCode(entry.code), mappedCodeSize(entry.codeSize) {
+	ParseFilepath(filepath + ".spv");
+	stage = entry.stage;
+	Reflect();
+}
+
+void Shader::Reflect() {
+	try {
+		reflection = ShaderReflection(GetCode(), GetCodeSize(), stage);
+	} catch (std::exception& e) {
+		throw std::runtime_error("Failed to reflect shader " + name + "." + type + " : " + e.what());
+	}
+}
+
+const ShaderReflection& Shader::GetReflection() const {
+	return reflection;
+}
+
+const uint32_t* Shader::GetCode() const {
+	return mappedCode ? mappedCode : reinterpret_cast<const uint32_t*>(bytecode.data());
+}
+
+size_t Shader::GetCodeSize() const {
+	return mappedCode ? mappedCodeSize : bytecode.size();
+}
 
+VkShaderStageFlagBits Shader::GetStage() const {
+	return stage;
+}
+
+void Shader::ParseFilepath(const std::string& filepath) {
+	// directory/name.type.spv, the name may contain dots but not the type
+	size_t nameStart = filepath.find_last_of('/') + 1; // 0 without a directory
+	size_t extension = filepath.size() - 4;
+	size_t typeStart = filepath.size() > 4 ? filepath.find_last_of('.', extension - 1) : std::string::npos;
+	if (filepath.size() <= 4 || filepath.compare(extension, 4, ".spv") != 0 || typeStart == std::string::npos || typeStart <= nameStart || typeStart + 1 == extension) {
+		throw std::runtime_error("Invalid shader file path '" + filepath + "'");
+	}
+	name = filepath.substr(nameStart, typeStart - nameStart);
+	type = filepath.substr(typeStart + 1, extension - typeStart - 1);
+	if (SHADER_TYPES.find(type) == SHADER_TYPES.end()) {
+		throw std::runtime_error("Invalid Shader Type " + type);
+	}
 }
 
 VkShaderModule Shader::CreateShaderModule(Device* device, VkPipelineShaderStageCreateFlags flags) {
 	// Create the shaderModule
 	VkShaderModuleCreateInfo createInfo {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = bytecode.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(bytecode.data());
+	createInfo.codeSize = GetCodeSize();
+	createInfo.pCode = GetCode();
 	if (device->CreateShaderModule(&createInfo, nullptr, &module) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create Shader Module for shader " + name);
 	}
@@ -50,7 +96,7 @@ VkShaderModule Shader::CreateShaderModule(Device* device, VkPipelineShaderStageC
 	stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	stageInfo.pNext = nullptr;
 	stageInfo.flags = flags;
-	stageInfo.stage = SHADER_TYPES[type];
+	stageInfo.stage = stage;
 	stageInfo.module = module;
 	stageInfo.pName = entryPoint.c_str();
 	stageInfo.pSpecializationInfo = specializationInfo;
@@ -46,10 +46,22 @@ namespace v4d::graphics::vulkan {
 		
 		VkSpecializationInfo* specializationInfo;
 		
-		std::vector<char> bytecode; // contains the spv file contents
+		std::vector<char> bytecode; // contains the spv file contents, empty when the SPIR-V is in an archive
+		std::shared_ptr<const ShaderArchive> archive = nullptr; // keeps the mapped SPIR-V alive
+		const uint32_t* mappedCode = nullptr;
+		size_t mappedCodeSize = 0;
 		
+		VkShaderStageFlagBits stage;
 		VkShaderModule module = VK_NULL_HANDLE;
 		
+		ShaderReflection reflection;
+		
+		// sets name and type from the file path (ending with .spv), with plain string searches
+		void ParseFilepath(const std::string& filepath);
+		
+		// reads the descriptor bindings, push constants and vertex inputs from the bytecode
+		void Reflect();
+		
 	public:
 		std::string name; // the shader file name without directory nor extension
 		std::string type; // string key in SHADER_TYPES
@@ -57,6 +69,17 @@ namespace v4d::graphics::vulkan {
 		VkPipelineShaderStageCreateInfo stageInfo;
 
 		Shader(std::string filepath/*relative to executable*/, std::string entryPoint = "main", VkSpecializationInfo* specializationInfo = nullptr);
+		// with SPIR-V that was compiled at runtime, filepath only gives the name and type
+		Shader(std::string filepath, std::vector<char>&& bytecode, std::string entryPoint = "main", VkSpecializationInfo* specializationInfo = nullptr);
+		// with SPIR-V that stays in a mapped archive, it is handed to the device without being copied
+		Shader(std::string filepath, std::shared_ptr<const ShaderArchive> archive, const ShaderArchive::Entry& entry, std::string entryPoint = "main", VkSpecializationInfo* specializationInfo = nullptr);
+		
+		const uint32_t* GetCode() const;
+		size_t GetCodeSize() const; // in bytes
+		VkShaderStageFlagBits GetStage() const;
+		
+		// what the SPIR-V declares, read when the shader is loaded
+		const ShaderReflection& GetReflection() const;
 		
 		VkShaderModule CreateShaderModule(Device* device, VkPipelineShaderStageCreateFlags flags = 0);
 		void DestroyShaderModule(Device* device);
@@ -0,0 +1,167 @@
+#include "../../common.h"
+#include <filesystem>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+using namespace v4d::graphics::vulkan;
+
+ShaderArchive::ShaderArchive(const std::string& filePath) {
+	#ifdef _WIN32
+		fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Failed to open shader archive " + filePath);
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(fileHandle, &fileSize);
+		mappedSize = (size_t)fileSize.QuadPart;
+		if (mappedSize > 0) {
+			mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mappingHandle) mappedData = (const std::byte*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		}
+		if (!mappedData) {
+			if (mappingHandle) CloseHandle(mappingHandle);
+			CloseHandle(fileHandle);
+			throw std::runtime_error("Failed to map shader archive " + filePath);
+		}
+	#else
+		int fd = open(filePath.c_str(), O_RDONLY);
+		if (fd == -1)
+			throw std::runtime_error("Failed to open shader archive " + filePath);
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+			mappedSize = (size_t)fileStat.st_size;
+			void* data = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED) {
+				mappedData = (const std::byte*)data;
+				// All the shaders are read right away, by the reflection then by the driver
+				madvise(data, mappedSize, MADV_WILLNEED);
+			}
+		}
+		close(fd); // the mapping stays valid
+		if (!mappedData)
+			throw std::runtime_error("Failed to map shader archive " + filePath);
+	#endif
+
+	// Validate and index, without reading the SPIR-V itself
+	auto fail = [this, &filePath](const std::string& reason){
+		Unmap();
+		throw std::runtime_error("Invalid shader archive " + filePath + " : " + reason);
+	};
+	if (mappedSize < sizeof(ShaderArchiveHeader)) fail("too small");
+	const auto& header = *(const ShaderArchiveHeader*)mappedData;
+	if (memcmp(header.magic, magic, sizeof(magic)) != 0) fail("not a shader archive");
+	if (header.version != version) fail("unsupported version " + std::to_string(header.version));
+	if (uint64_t(header.entryCount) * sizeof(ShaderArchiveEntry) > mappedSize - sizeof(ShaderArchiveHeader)) fail("index out of bounds");
+	auto blobFits = [this](uint64_t offset, uint64_t size){return offset <= mappedSize && size <= mappedSize - offset;};
+	const auto* index = (const ShaderArchiveEntry*)(mappedData + sizeof(ShaderArchiveHeader));
+	entries.reserve(header.entryCount);
+	for (uint32_t i = 0; i < header.entryCount; ++i) {
+		const auto& entry = index[i];
+		if (!blobFits(entry.pathOffset, entry.pathLength)) fail("path " + std::to_string(i) + " out of bounds");
+		if (entry.codeOffset % blobAlignment != 0 || entry.codeSize % 4 != 0 || !blobFits(entry.codeOffset, entry.codeSize)) fail("shader " + std::to_string(i) + " out of bounds");
+		std::string_view path((const char*)(mappedData + entry.pathOffset), entry.pathLength);
+		entries[path] = {(VkShaderStageFlagBits)entry.stage, (const uint32_t*)(mappedData + entry.codeOffset), (size_t)entry.codeSize, entry.spvWriteTime};
+	}
+}
+
+ShaderArchive::~ShaderArchive() {
+	Unmap();
+}
+
+void ShaderArchive::Unmap() {
+	if (!mappedData) return;
+	#ifdef _WIN32
+		UnmapViewOfFile(mappedData);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+	#else
+		munmap((void*)mappedData, mappedSize);
+	#endif
+	mappedData = nullptr;
+	entries.clear();
+}
+
+const ShaderArchive::Entry* ShaderArchive::Find(const std::string& filepath) const {
+	auto entry = entries.find(filepath);
+	return entry == entries.end() ? nullptr : &entry->second;
+}
+
+bool ShaderArchive::IsUpToDate(const std::vector<std::string>& filepaths) const {
+	for (auto& filepath : filepaths) {
+		auto* entry = Find(filepath);
+		if (!entry) return false;
+		int64_t writeTime = GetWriteTime(filepath + ".spv");
+		if (writeTime != 0 && writeTime != entry->spvWriteTime) return false;
+	}
+	return true;
+}
+
+int64_t ShaderArchive::GetWriteTime(const std::string& filePath) {
+	std::error_code error;
+	auto time = std::filesystem::last_write_time(filePath, error);
+	return error ? 0 : (int64_t)time.time_since_epoch().count();
+}
+
+void ShaderArchive::Pack(const std::string& filePath, const std::vector<std::string>& filepaths) {
+	auto align = [](uint64_t offset){return (offset + blobAlignment - 1) / blobAlignment * blobAlignment;};
+
+	// Read and validate every shader first, the stage comes from its file name
+	std::vector<Shader> shaders;
+	shaders.reserve(filepaths.size());
+	std::vector<int64_t> writeTimes;
+	for (auto& filepath : filepaths) {
+		writeTimes.push_back(GetWriteTime(filepath + ".spv"));
+		shaders.emplace_back(filepath);
+	}
+
+	ShaderArchiveHeader header {};
+	memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.entryCount = (uint32_t)filepaths.size();
+	std::vector<ShaderArchiveEntry> index(filepaths.size());
+	uint64_t offset = sizeof(ShaderArchiveHeader) + index.size() * sizeof(ShaderArchiveEntry);
+	for (size_t i = 0; i < filepaths.size(); ++i) {
+		index[i].pathOffset = (uint32_t)offset;
+		index[i].pathLength = (uint32_t)filepaths[i].size();
+		offset += filepaths[i].size();
+	}
+	for (size_t i = 0; i < filepaths.size(); ++i) {
+		offset = align(offset);
+		index[i].stage = shaders[i].GetStage();
+		index[i].codeOffset = offset;
+		index[i].codeSize = shaders[i].GetCodeSize();
+		index[i].spvWriteTime = writeTimes[i];
+		offset += index[i].codeSize;
+	}
+
+	std::string temporary = filePath + ".tmp";
+	{
+		std::ofstream file(temporary, std::fstream::binary | std::fstream::trunc);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to write shader archive " + filePath);
+		auto pad = [&file](uint64_t offset){
+			static const char zeros[blobAlignment] {};
+			file.write(zeros, offset - (uint64_t)file.tellp());
+		};
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)index.data(), index.size() * sizeof(ShaderArchiveEntry));
+		for (auto& filepath : filepaths) {
+			file.write(filepath.data(), filepath.size());
+		}
+		for (size_t i = 0; i < shaders.size(); ++i) {
+			pad(index[i].codeOffset);
+			file.write((const char*)shaders[i].GetCode(), shaders[i].GetCodeSize());
+		}
+		if (!file.good())
+			throw std::runtime_error("Failed to write shader archive " + filePath);
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, filePath, error);
+	if (error) {
+		std::filesystem::remove(temporary, error);
+		throw std::runtime_error("Failed to replace shader archive " + filePath);
+	}
+}
@@ -0,0 +1,83 @@
+/*
+ * Packed SPIR-V archive
+ * Part of the Vulkan4D open-source game engine under the LGPL license - https://github.com/Vulkan4D
+ *
+ * All the .spv files of a renderer in one file, laid out so that loading is only a memory mapping :
+ *   ShaderArchiveHeader
+ *   ShaderArchiveEntry[entryCount]
+ *   file paths of the entries, concatenated
+ *   SPIR-V of each entry at its codeOffset, every blob starts on a multiple of blobAlignment
+ * The SPIR-V is handed to the device straight from the mapping.
+ */
+#pragma once
+#include "../../common.h"
+
+namespace v4d::graphics::vulkan {
+
+	struct ShaderArchiveHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(ShaderArchiveHeader) == 16);
+
+	struct ShaderArchiveEntry {
+		uint32_t pathOffset; // from the start of the file
+		uint32_t pathLength;
+		uint32_t stage; // VkShaderStageFlagBits
+		uint32_t reserved;
+		uint64_t codeOffset;
+		uint64_t codeSize; // in bytes
+		int64_t spvWriteTime; // of the .spv file when it was packed, the entry is outdated when the file changes
+	};
+	static_assert(sizeof(ShaderArchiveEntry) == 40);
+
+	class ShaderArchive {
+	public:
+		static constexpr char magic[4] = {'V','4','D','S'};
+		static const uint32_t version = 1;
+		static const size_t blobAlignment = 16;
+
+		struct Entry {
+			VkShaderStageFlagBits stage;
+			const uint32_t* code;
+			size_t codeSize; // in bytes
+			int64_t spvWriteTime;
+		};
+
+		// Maps the whole file in memory and validates its index, throws on failure
+		ShaderArchive(const std::string& filePath);
+		~ShaderArchive();
+
+		ShaderArchive(const ShaderArchive&) = delete;
+		ShaderArchive& operator=(const ShaderArchive&) = delete;
+
+		// filepath as in a ShaderInfo (without .spv), nullptr if it is not in the archive
+		const Entry* Find(const std::string& filepath) const;
+
+		// Whether all the shaders are in the archive, and their .spv files did not change since they were packed (missing .spv files are not checked, the archive may be shipped alone)
+		bool IsUpToDate(const std::vector<std::string>& filepaths) const;
+
+		size_t GetSize() const {return mappedSize;}
+		size_t GetEntryCount() const {return entries.size();}
+
+		// Packs the .spv files of the shaders (filepaths as in their ShaderInfo), throws if one of them cannot be read.
+		// Written to a temporary file then renamed, so that a renderer that maps the previous archive keeps reading it.
+		static void Pack(const std::string& filePath, const std::vector<std::string>& filepaths);
+
+	private:
+		const std::byte* mappedData = nullptr;
+		size_t mappedSize = 0;
+		#ifdef _WIN32
+			HANDLE fileHandle = INVALID_HANDLE_VALUE;
+			HANDLE mappingHandle = NULL;
+		#endif
+		std::unordered_map<std::string_view, Entry> entries {}; // the paths point into the mapping
+
+		void Unmap();
+		// last write time of a file as a number, 0 if it does not exist
+		static int64_t GetWriteTime(const std::string& filePath);
+	};
+
+}
@@ -0,0 +1,245 @@
+#include "../../common.h"
+#include "../../utilities/ThreadPool.h"
+
+#include <filesystem>
+#include <iomanip>
+
+#ifdef V4D_SHADERC
+	#include <shaderc/shaderc.hpp>
+#endif
+
+#ifdef _WIN32
+	#define popen _popen
+	#define pclose _pclose
+#endif
+
+using namespace v4d::graphics::vulkan;
+
+namespace {
+	// FNV-1a
+	void HashBytes(uint64_t& hash, const std::string& bytes) {
+		for (unsigned char c : bytes) {
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		// Separator, so that ("ab","c") and ("a","bc") differ
+		hash ^= 0xff;
+		hash *= 1099511628211ull;
+	}
+	
+	bool ReadFile(const std::string& path, std::string& contents) {
+		std::ifstream file(path, std::fstream::binary);
+		if (!file.is_open()) return false;
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		contents = stream.str();
+		return true;
+	}
+	
+	// Written to a temporary file then renamed, so that other threads and processes never read a partial file
+	void WriteFileAtomically(const std::string& path, const std::vector<char>& contents) {
+		std::string temporary = path + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+		{
+			std::ofstream file(temporary, std::fstream::binary | std::fstream::trunc);
+			if (!file.is_open()) return;
+			file.write(contents.data(), contents.size());
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary, path, error);
+		if (error) std::filesystem::remove(temporary, error);
+	}
+	
+	std::string GetDirectory(const std::string& path) {
+		auto slash = path.find_last_of('/');
+		return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+	}
+	
+	// Target of an #include "file" line, empty if the line is not an include
+	std::string ParseInclude(const std::string& line) {
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string::npos || line[i] != '#') return "";
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i == std::string::npos || line.compare(i, 7, "include") != 0) return "";
+		size_t begin = line.find_first_of("\"<", i + 7);
+		if (begin == std::string::npos) return "";
+		size_t end = line.find_first_of("\">", begin + 1);
+		if (end == std::string::npos) return "";
+		return line.substr(begin + 1, end - begin - 1);
+	}
+	
+	#ifdef V4D_SHADERC
+		// Resolves #include "file" relative to the including file, like glslangValidator
+		class Includer : public shaderc::CompileOptions::IncluderInterface {
+			struct Include {
+				std::string name;
+				std::string content;
+				shaderc_include_result result;
+			};
+		public:
+			shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type, const char* requestingSource, size_t) override {
+				auto* include = new Include;
+				include->name = GetDirectory(requestingSource) + requestedSource;
+				if (!ReadFile(include->name, include->content)) {
+					// An empty name tells shaderc that the include failed, the content is the error message
+					include->content = "Cannot open include file '" + include->name + "'";
+					include->name = "";
+				}
+				include->result = {include->name.c_str(), include->name.size(), include->content.c_str(), include->content.size(), include};
+				return &include->result;
+			}
+			void ReleaseInclude(shaderc_include_result* result) override {
+				delete static_cast<Include*>(result->user_data);
+			}
+		};
+		
+		shaderc_shader_kind GetShaderKind(const std::string& type) {
+			static const std::unordered_map<std::string, shaderc_shader_kind> kinds {
+				{"vert", shaderc_glsl_vertex_shader},
+				{"tesc", shaderc_glsl_tess_control_shader},
+				{"tese", shaderc_glsl_tess_evaluation_shader},
+				{"geom", shaderc_glsl_geometry_shader},
+				{"frag", shaderc_glsl_fragment_shader},
+				{"comp", shaderc_glsl_compute_shader},
+			};
+			auto kind = kinds.find(type);
+			return kind != kinds.end() ? kind->second : shaderc_glsl_infer_from_source;
+		}
+	#endif
+}
+
+ShaderCompiler::ShaderCompiler(const std::string& sourceDirectory, const std::string& cacheDirectory)
+: sourceDirectory(sourceDirectory), cacheDirectory(cacheDirectory), compilerVersion(GetCompilerVersion()) {
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+	if (error) LOG_WARN("Cannot create shader cache directory '" << cacheDirectory << "', shaders will be compiled every time")
+}
+
+std::string ShaderCompiler::ReadSourceWithIncludes(const std::string& path, std::vector<std::string>& includeStack) const {
+	std::string source;
+	if (!ReadFile(path, source)) {
+		throw std::runtime_error("Failed to load shader source '" + path + "'");
+	}
+	if (std::find(includeStack.begin(), includeStack.end(), path) != includeStack.end()) return ""; // recursive include, the compiler reports it
+	includeStack.push_back(path);
+	std::string contents = path + "\n" + source;
+	std::istringstream lines(source);
+	for (std::string line; std::getline(lines, line);) {
+		std::string include = ParseInclude(line);
+		if (!include.empty()) contents += ReadSourceWithIncludes(GetDirectory(path) + include, includeStack);
+	}
+	includeStack.pop_back();
+	return contents;
+}
+
+uint64_t ShaderCompiler::HashShader(const std::string& filepath, const std::string& type) const {
+	uint64_t hash = 14695981039346656037ull;
+	std::vector<std::string> includeStack;
+	HashBytes(hash, ReadSourceWithIncludes(sourceDirectory + "/" + filepath, includeStack));
+	HashBytes(hash, type);
+	HashBytes(hash, compilerVersion);
+	for (auto& [name, value] : defines) {
+		HashBytes(hash, name);
+		HashBytes(hash, value);
+	}
+	return hash;
+}
+
+std::vector<char> ShaderCompiler::GetSpirv(const std::string& filepath) {
+	std::string type = filepath.substr(filepath.find_last_of('.') + 1);
+	std::ostringstream cachePath;
+	cachePath << cacheDirectory << "/" << filepath.substr(filepath.find_last_of('/') + 1) << "." << std::hex << std::setw(16) << std::setfill('0') << HashShader(filepath, type) << ".spv";
+	
+	std::string spirv;
+	if (ReadFile(cachePath.str(), spirv) && spirv.size() > 0) {
+		cached++;
+		return std::vector<char>(spirv.begin(), spirv.end());
+	}
+	
+	try {
+		auto bytecode = Compile(filepath, type);
+		WriteFileAtomically(cachePath.str(), bytecode);
+		compiled++;
+		return bytecode;
+	} catch (std::exception&) {
+		failed++;
+		throw;
+	}
+}
+
+void ShaderCompiler::CompileAll(const std::vector<std::string>& filepaths, v4d::utilities::ThreadPool& threadPool) {
+	auto start = std::chrono::high_resolution_clock::now();
+	Stats before = GetStats();
+	threadPool.ParallelFor(filepaths.size(), 1, [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; ++i) {
+			try {
+				GetSpirv(filepaths[i]);
+			} catch (std::exception& e) {
+				LOG_ERROR(e.what())
+			}
+		}
+	});
+	Stats after = GetStats();
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	LOG("Shaders : " << (after.compiled - before.compiled) << " compiled, " << (after.cached - before.cached) << " from the cache, " << (after.failed - before.failed) << " failed, in " << milliseconds << " ms")
+}
+
+std::vector<char> ShaderCompiler::Compile(const std::string& filepath, const std::string& type) const {
+	std::string sourcePath = sourceDirectory + "/" + filepath;
+	#ifdef V4D_SHADERC
+		std::string source;
+		if (!ReadFile(sourcePath, source)) {
+			throw std::runtime_error("Failed to load shader source '" + sourcePath + "'");
+		}
+		shaderc::Compiler compiler;
+		shaderc::CompileOptions options;
+		options.SetIncluder(std::make_unique<Includer>());
+		for (auto& [name, value] : defines) {
+			options.AddMacroDefinition(name, value);
+		}
+		auto result = compiler.CompileGlslToSpv(source, GetShaderKind(type), sourcePath.c_str(), options);
+		if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+			throw std::runtime_error("Failed to compile shader '" + filepath + "' :\n" + result.GetErrorMessage());
+		}
+		std::vector<char> bytecode((result.cend() - result.cbegin()) * sizeof(uint32_t));
+		memcpy(bytecode.data(), result.cbegin(), bytecode.size());
+		return bytecode;
+	#else
+		std::string output = cacheDirectory + "/" + filepath.substr(filepath.find_last_of('/') + 1) + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".spv";
+		std::string command = "glslangValidator -V";
+		for (auto& [name, value] : defines) {
+			command += " \"-D" + name + "=" + value + "\"";
+		}
+		command += " \"" + sourcePath + "\" -o \"" + output + "\" 2>&1";
+		std::string messages;
+		FILE* pipe = popen(command.c_str(), "r");
+		if (!pipe) {
+			throw std::runtime_error("Failed to run glslangValidator for shader '" + filepath + "'");
+		}
+		char buffer[256];
+		while (fgets(buffer, sizeof(buffer), pipe)) messages += buffer;
+		int status = pclose(pipe);
+		std::string spirv;
+		bool compiled = status == 0 && ReadFile(output, spirv);
+		std::remove(output.c_str());
+		if (!compiled) {
+			throw std::runtime_error("Failed to compile shader '" + filepath + "' :\n" + messages);
+		}
+		return std::vector<char>(spirv.begin(), spirv.end());
+	#endif
+}
+
+std::string ShaderCompiler::GetCompilerVersion() {
+	#ifdef V4D_SHADERC
+		unsigned int version = 0, revision = 0;
+		shaderc_get_spv_version(&version, &revision);
+		return "shaderc " + std::to_string(version) + "." + std::to_string(revision);
+	#else
+		std::string version = "glslangValidator ";
+		if (FILE* pipe = popen("glslangValidator --version 2>&1", "r")) {
+			char buffer[256];
+			while (fgets(buffer, sizeof(buffer), pipe)) version += buffer;
+			pclose(pipe);
+		}
+		return version;
+	#endif
+}
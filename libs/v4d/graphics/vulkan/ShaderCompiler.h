@@ -0,0 +1,52 @@
+/*
+ * GLSL to SPIR-V compiler with an on-disk cache
+ * Part of the Vulkan4D open-source game engine under the LGPL license - https://github.com/Vulkan4D
+ *
+ * Compiles shader sources at runtime, with the shaderc library when built with V4D_SHADERC, otherwise by running glslangValidator.
+ * Compiled SPIR-V is cached on disk under a hash of everything that affects it :
+ * the source, its #include files, the defines, the stage and the compiler's version. Unchanged shaders are never compiled again.
+ */
+#pragma once
+#include "../../common.h"
+
+namespace v4d::utilities {
+	class ThreadPool;
+}
+
+namespace v4d::graphics::vulkan {
+
+	class ShaderCompiler {
+	public:
+		std::string sourceDirectory; // the GLSL file of a shader is sourceDirectory + "/" + its ShaderInfo's filepath
+		std::string cacheDirectory;
+		std::vector<std::pair<std::string, std::string>> defines {}; // name and value, for all shaders
+		
+		ShaderCompiler(const std::string& sourceDirectory, const std::string& cacheDirectory = "shaders/cache");
+		
+		// SPIR-V of a shader (filepath as in its ShaderInfo, without .spv), from the cache or compiled now.
+		// Throws a std::runtime_error with the compiler's messages if the shader does not compile.
+		std::vector<char> GetSpirv(const std::string& filepath);
+		
+		// Compiles the shaders that are not in the cache yet, in parallel, so that GetSpirv() finds them all in the cache.
+		// Failures are only logged here, they are thrown again by GetSpirv().
+		void CompileAll(const std::vector<std::string>& filepaths, v4d::utilities::ThreadPool& threadPool);
+		
+		struct Stats {
+			uint32_t compiled;
+			uint32_t cached;
+			uint32_t failed;
+		};
+		Stats GetStats() const {return {compiled, cached, failed};}
+		
+	private:
+		std::atomic<uint32_t> compiled {0}, cached {0}, failed {0};
+		std::string compilerVersion;
+		
+		// Contents of the source and of all its includes, in the order that they are included
+		std::string ReadSourceWithIncludes(const std::string& path, std::vector<std::string>& includeStack) const;
+		uint64_t HashShader(const std::string& filepath, const std::string& type) const;
+		std::vector<char> Compile(const std::string& filepath, const std::string& type) const;
+		static std::string GetCompilerVersion();
+	};
+	
+}
@@ -6,19 +6,165 @@ ShaderPipeline::~ShaderPipeline() {
 	
 };
 
+void ShaderPipeline::CreatePipeline(Device* device) {
+	CreateBasePipeline(device);
+	try {
+		for (uint32_t i = 1; i <= permutations.size(); ++i) {
+			SetPermutationPipeline(i, CreatePermutationPipeline(device, i));
+		}
+	} catch (...) {
+		DestroyPermutationPipelines(device);
+		device->DestroyPipeline(pipeline, nullptr);
+		pipeline = VK_NULL_HANDLE;
+		throw;
+	}
+}
+
+void ShaderPipeline::SetPermutationPipeline(uint32_t permutation, VkPipeline permutationPipeline) {
+	permutations.at(permutation - 1).pipeline = permutationPipeline;
+}
+
+bool ShaderPipeline::IsPermutationReady(uint32_t permutation) const {
+	return permutation == 0 ? pipeline != VK_NULL_HANDLE : permutations.at(permutation - 1).pipeline != VK_NULL_HANDLE;
+}
+
 void ShaderPipeline::Execute(Device* device, VkCommandBuffer cmdBuffer, uint32_t instanceCount, void* pushConstant, int pushConstantIndex) {
-	Bind(device, cmdBuffer);
-	if (pushConstant) PushConstant(device, cmdBuffer, pushConstant, pushConstantIndex);
-	Render(device, cmdBuffer, instanceCount);
+	CommandRecorder recorder(device, cmdBuffer);
+	Execute(recorder, instanceCount, pushConstant, pushConstantIndex);
 }
 
 void ShaderPipeline::Execute(Device* device, VkCommandBuffer cmdBuffer) {
-	Bind(device, cmdBuffer);
-	Render(device, cmdBuffer, 1);
+	CommandRecorder recorder(device, cmdBuffer);
+	Execute(recorder);
+}
+
+void ShaderPipeline::Execute(CommandRecorder& commandBuffer, uint32_t instanceCount, void* pushConstant, int pushConstantIndex) {
+	Bind(commandBuffer);
+	if (pushConstant) PushConstant(commandBuffer, pushConstant, pushConstantIndex);
+	Render(commandBuffer, instanceCount);
+}
+
+void ShaderPipeline::Execute(CommandRecorder& commandBuffer) {
+	Bind(commandBuffer);
+	Render(commandBuffer, 1);
+}
+
+bool ShaderPipeline::Reload(Device* device, ShaderCompiler* compiler) {
+	std::vector<Shader> newShaders;
+	try {
+		for (auto& shader : shaderFiles) {
+			if (compiler) {
+				newShaders.emplace_back(shader.filepath, compiler->GetSpirv(shader.filepath), shader.entryPoint, shader.specializationInfo);
+			} else {
+				newShaders.emplace_back(shader.filepath, shader.entryPoint, shader.specializationInfo);
+			}
+		}
+	} catch (std::exception& e) {
+		LOG_WARN("Failed to reload shaders, keeping the current pipeline : " << e.what())
+		return false;
+	}
+	
+	// The current pipelines and shader modules stay alive until the new ones are created
+	VkPipeline oldPipeline = pipeline;
+	std::vector<VkPipeline> oldPermutationPipelines;
+	for (auto& permutation : permutations) {
+		oldPermutationPipelines.push_back(permutation.pipeline);
+		permutation.pipeline = VK_NULL_HANDLE;
+	}
+	std::vector<Shader> oldShaders = std::move(shaders);
+	std::vector<VkPipelineShaderStageCreateInfo> oldStages = std::move(stages);
+	shaders = std::move(newShaders);
+	stages.clear();
+	try {
+		CreatePipeline(device);
+	} catch (std::exception& e) {
+		LOG_WARN("Failed to recreate pipeline, keeping the current one : " << e.what())
+		DestroyShaderStages(device);
+		shaders = std::move(oldShaders);
+		stages = std::move(oldStages);
+		pipeline = oldPipeline;
+		for (size_t i = 0; i < permutations.size(); ++i) {
+			permutations[i].pipeline = oldPermutationPipelines[i];
+		}
+		return false;
+	}
+	
+	device->DestroyPipeline(oldPipeline, nullptr);
+	for (auto oldPermutationPipeline : oldPermutationPipelines) {
+		device->DestroyPipeline(oldPermutationPipeline, nullptr);
+	}
+	for (auto& shader : oldShaders) {
+		shader.DestroyShaderModule(device);
+	}
+	return true;
 }
 
 void ShaderPipeline::PushConstant(Device* device, VkCommandBuffer cmdBuffer, void* pushConstant, int pushConstantIndex) {
-	auto& pushConstantRange = GetPipelineLayout()->pushConstants[pushConstantIndex];
-	device->CmdPushConstants(cmdBuffer, GetPipelineLayout()->handle, pushConstantRange.stageFlags, pushConstantRange.offset, pushConstantRange.size, pushConstant);
+	GetPipelineLayout()->PushConstants(device, cmdBuffer, pushConstant, pushConstantIndex);
 }
 
+void ShaderPipeline::PushConstant(CommandRecorder& commandBuffer, void* pushConstant, int pushConstantIndex) {
+	GetPipelineLayout()->PushConstants(commandBuffer, pushConstant, pushConstantIndex);
+}
+
+
+uint32_t ShaderPipeline::AddPermutation(const VkSpecializationInfo& constants) {
+	Permutation permutation;
+	permutation.entries.assign(constants.pMapEntries, constants.pMapEntries + constants.mapEntryCount);
+	permutation.data.assign((const char*)constants.pData, (const char*)constants.pData + constants.dataSize);
+	std::string key((const char*)permutation.entries.data(), permutation.entries.size() * sizeof(VkSpecializationMapEntry));
+	key.append(permutation.data.data(), permutation.data.size());
+	auto [cached, inserted] = permutationCache.try_emplace(key, (uint32_t)permutations.size() + 1);
+	if (inserted) permutations.push_back(std::move(permutation));
+	return cached->second;
+}
+
+size_t ShaderPipeline::GetPermutationCount() const {
+	return permutations.size() + 1;
+}
+
+void ShaderPipeline::SetPermutation(uint32_t permutation) {
+	currentPermutation = permutation <= permutations.size() ? permutation : 0;
+}
+
+VkPipeline ShaderPipeline::GetCurrentPipeline() const {
+	// The base pipeline stands in for a permutation that is still being created
+	if (currentPermutation == 0 || permutations[currentPermutation - 1].pipeline == VK_NULL_HANDLE) return pipeline;
+	return permutations[currentPermutation - 1].pipeline;
+}
+
+std::vector<VkPipelineShaderStageCreateInfo> ShaderPipeline::MakePermutationStages(const Permutation& permutation, std::vector<MergedSpecialization>& specializations) const {
+	std::vector<VkPipelineShaderStageCreateInfo> permutationStages = stages;
+	specializations.clear();
+	specializations.resize(permutationStages.size()); // not resized again, the stages point into it
+	for (size_t i = 0; i < permutationStages.size(); ++i) {
+		auto& merged = specializations[i];
+		const VkSpecializationInfo* own = permutationStages[i].pSpecializationInfo;
+		if (own) {
+			// The stage's own constants, except those that the permutation overrides
+			merged.data.assign((const char*)own->pData, (const char*)own->pData + own->dataSize);
+			for (uint32_t j = 0; j < own->mapEntryCount; ++j) {
+				bool overridden = std::any_of(permutation.entries.begin(), permutation.entries.end(), [&](const VkSpecializationMapEntry& entry){
+					return entry.constantID == own->pMapEntries[j].constantID;
+				});
+				if (!overridden) merged.entries.push_back(own->pMapEntries[j]);
+			}
+		}
+		uint32_t offset = (uint32_t)merged.data.size();
+		merged.data.insert(merged.data.end(), permutation.data.begin(), permutation.data.end());
+		for (auto entry : permutation.entries) {
+			entry.offset += offset;
+			merged.entries.push_back(entry);
+		}
+		merged.info = {(uint32_t)merged.entries.size(), merged.entries.data(), merged.data.size(), merged.data.data()};
+		permutationStages[i].pSpecializationInfo = &merged.info;
+	}
+	return permutationStages;
+}
+
+void ShaderPipeline::DestroyPermutationPipelines(Device* device) {
+	for (auto& permutation : permutations) {
+		if (permutation.pipeline != VK_NULL_HANDLE) device->DestroyPipeline(permutation.pipeline, nullptr);
+		permutation.pipeline = VK_NULL_HANDLE;
+	}
+}
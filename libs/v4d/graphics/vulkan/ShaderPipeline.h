@@ -15,24 +15,75 @@ namespace v4d::graphics::vulkan {
 		using ShaderProgram::ShaderProgram; // use parent constructor
 		virtual ~ShaderPipeline();
 		
-		virtual void CreatePipeline(Device*) = 0;
+		// creates the base pipeline then its permutations, throws if one of them cannot be created
+		virtual void CreatePipeline(Device*);
 		virtual void DestroyPipeline(Device*) = 0;
 		
+		// CreatePipeline() in two steps, for a PipelineScheduler. CreatePermutationPipeline() does not modify this object,
+		// so that permutations may be created on other threads once the base pipeline exists.
+		// Its result is given back with SetPermutationPipeline(), the base pipeline is bound in place of the permutation until then.
+		virtual void CreateBasePipeline(Device*) = 0;
+		virtual VkPipeline CreatePermutationPipeline(Device*, uint32_t permutation) const = 0;
+		void SetPermutationPipeline(uint32_t permutation, VkPipeline permutationPipeline);
+		bool IsPermutationReady(uint32_t permutation) const;
+		
+		// shared by all the pipelines of a renderer (see PipelineScheduler), VK_NULL_HANDLE for none
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		
 		// Execute() will call Bind() and Render() automatically
 		virtual void Execute(Device* device, VkCommandBuffer cmdBuffer, uint32_t instanceCount, void* pushConstant, int pushConstantIndex = 0);
 		virtual void Execute(Device* device, VkCommandBuffer cmdBuffer);
+		// Same, the binds and push constants that are already in the recorder's command buffer are skipped
+		virtual void Execute(CommandRecorder& commandBuffer, uint32_t instanceCount, void* pushConstant, int pushConstantIndex = 0);
+		virtual void Execute(CommandRecorder& commandBuffer);
 		
 		// sends a push constant to the shader now
 		void PushConstant(Device* device, VkCommandBuffer cmdBuffer, void* pushConstant, int pushConstantIndex = 0);
+		void PushConstant(CommandRecorder& commandBuffer, void* pushConstant, int pushConstantIndex = 0);
+		
+		// re-reads the spv files and recreates the pipeline with the same settings, the device must be idle
+		// returns false and keeps the current pipeline if the files cannot be read or the pipeline cannot be created
+		bool Reload(Device* device, ShaderCompiler* compiler = nullptr);
+		
+		// Permutations of the program, with other values for some of its specialization constants (over each stage's own constants).
+		// Each permutation gets its own pipeline, derived from the base pipeline (VK_PIPELINE_CREATE_DERIVATIVE_BIT).
+		// Constants are copied, identical ones return the same permutation. They must be added before CreatePipeline(),
+		// DestroyPipeline() removes them. Permutation 0 is the base pipeline.
+		uint32_t AddPermutation(const VkSpecializationInfo& constants);
+		size_t GetPermutationCount() const;
+		
+		// the pipeline that the next Execute() binds
+		void SetPermutation(uint32_t permutation);
+		VkPipeline GetCurrentPipeline() const;
 		
 	protected:
 		VkPipeline pipeline = VK_NULL_HANDLE;
 		
+		struct Permutation {
+			std::vector<VkSpecializationMapEntry> entries;
+			std::vector<char> data;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+		};
+		std::vector<Permutation> permutations {}; // permutation i+1
+		std::unordered_map<std::string, uint32_t> permutationCache {}; // map entries and data bytes, to permutation index
+		uint32_t currentPermutation = 0;
+		
+		// Stages of a permutation, where its constants are merged over each stage's own constants.
+		// The returned stages point into specializations, which must stay alive until the pipeline is created.
+		struct MergedSpecialization {
+			std::vector<VkSpecializationMapEntry> entries;
+			std::vector<char> data;
+			VkSpecializationInfo info;
+		};
+		std::vector<VkPipelineShaderStageCreateInfo> MakePermutationStages(const Permutation& permutation, std::vector<MergedSpecialization>& specializations) const;
+		
+		void DestroyPermutationPipelines(Device* device);
+		
 		// binds the pipeline (to be implemented in child classes)
-		virtual void Bind(Device*, VkCommandBuffer) = 0;
+		virtual void Bind(CommandRecorder&) = 0;
 		
 		// issues the draw calls (to be implemented in child classes)
-		virtual void Render(Device*, VkCommandBuffer, uint32_t instanceCount) = 0;
+		virtual void Render(CommandRecorder&, uint32_t instanceCount) = 0;
 		
 	};
 	
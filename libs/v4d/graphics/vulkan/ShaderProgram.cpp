@@ -20,11 +20,33 @@ void ShaderProgram::AddVertexInputBinding(uint32_t stride, VkVertexInputRate inp
 	AddVertexInputBinding(bindings.size(), stride, inputRate, attrs);
 }
 
-void ShaderProgram::ReadShaders() {
+void ShaderProgram::ReadShaders(ShaderCompiler* compiler, const std::shared_ptr<const ShaderArchive>& archive) {
 	shaders.clear();
 	for (auto& shader : shaderFiles) {
-		shaders.emplace_back(shader.filepath, shader.entryPoint, shader.specializationInfo);
+		const ShaderArchive::Entry* entry = archive ? archive->Find(shader.filepath) : nullptr;
+		if (compiler) {
+			shaders.emplace_back(shader.filepath, compiler->GetSpirv(shader.filepath), shader.entryPoint, shader.specializationInfo);
+		} else if (entry) {
+			shaders.emplace_back(shader.filepath, archive, *entry, shader.entryPoint, shader.specializationInfo);
+		} else {
+			shaders.emplace_back(shader.filepath, shader.entryPoint, shader.specializationInfo);
+		}
+	}
+}
+
+bool ShaderProgram::UsesShaderFile(const std::string& filepath) const {
+	for (auto& shader : shaderFiles) {
+		if (shader.filepath == filepath || shader.filepath == filepath + ".spv") return true;
 	}
+	return false;
+}
+
+std::vector<std::string> ShaderProgram::GetShaderFiles() const {
+	std::vector<std::string> files;
+	for (auto& shader : shaderFiles) {
+		files.push_back(shader.filepath);
+	}
+	return files;
 }
 
 void ShaderProgram::Reset() {
@@ -32,8 +54,65 @@ void ShaderProgram::Reset() {
 	attributes.clear();
 }
 
+ShaderReflection ShaderProgram::GetReflection() const {
+	ShaderReflection reflection;
+	for (auto& shader : shaders) {
+		reflection.Merge(shader.GetReflection());
+	}
+	return reflection;
+}
+
+void ShaderProgram::ValidateLayout() const {
+	std::string program;
+	for (auto& shader : shaders) {
+		program += (program.empty()? "" : ", ") + shader.name + "." + shader.type;
+	}
+	auto fail = [&program](const std::string& message){
+		throw std::runtime_error("Shader program (" + program + ") " + message);
+	};
+	ShaderReflection reflection = GetReflection();
+	
+	// Descriptor bindings, the set number is the index of the descriptor set in the pipeline layout
+	for (auto& reflected : reflection.bindings) {
+		std::string binding = "set " + std::to_string(reflected.set) + " binding " + std::to_string(reflected.binding) + " (" + reflected.name + ")";
+		if (reflected.set >= pipelineLayout->descriptorSets.size()) fail("uses " + binding + " but its pipeline layout has " + std::to_string(pipelineLayout->descriptorSets.size()) + " descriptor sets");
+		auto& bindings = pipelineLayout->descriptorSets[reflected.set]->GetBindings();
+		auto declared = bindings.find(reflected.binding);
+		if (declared == bindings.end()) fail("uses " + binding + " which is not in the descriptor set");
+		if (declared->second.descriptorType != reflected.descriptorType) fail("uses " + binding + " as descriptor type " + std::to_string(reflected.descriptorType) + " but it is declared as " + std::to_string(declared->second.descriptorType));
+		if (declared->second.descriptorCount < reflected.descriptorCount) fail("uses " + std::to_string(reflected.descriptorCount) + " descriptors in " + binding + " but it only has " + std::to_string(declared->second.descriptorCount));
+		if ((declared->second.stageFlags & reflected.stageFlags) != reflected.stageFlags) fail("uses " + binding + " in stages that are not in its stage flags");
+		if (declared->second.bufferSize && reflected.bufferSize && declared->second.bufferSize != reflected.bufferSize) fail("declares " + binding + " with " + std::to_string(reflected.bufferSize) + " bytes but its C++ struct has " + std::to_string(declared->second.bufferSize));
+	}
+	
+	// Push constants, the layout's ranges must cover each stage's block (they do not when a hot reload grows it),
+	// and the C++ structs may be larger than the largest block only by its tail padding
+	uint32_t structSize = 0, blockSize = 0;
+	for (auto& pushConstant : pipelineLayout->pushConstants) structSize = std::max(structSize, pushConstant.offset + pushConstant.size);
+	for (auto& block : reflection.pushConstants) {
+		auto range = std::find_if(pipelineLayout->pushConstantRanges.begin(), pipelineLayout->pushConstantRanges.end(), [&block](const VkPushConstantRange& range){
+			return (range.stageFlags & block.stageFlags) == block.stageFlags;
+		});
+		if (range == pipelineLayout->pushConstantRanges.end()) fail("uses push constants in a stage that has no push constant range");
+		if (range->offset + range->size < block.size) fail("declares " + std::to_string(block.size) + " bytes of push constants but the range of its stage has " + std::to_string(range->offset + range->size));
+		if (structSize < block.size) fail("declares " + std::to_string(block.size) + " bytes of push constants but its C++ struct has " + std::to_string(structSize));
+		blockSize = std::max(blockSize, block.size);
+	}
+	if (blockSize && structSize > ((blockSize + 15) & ~15u)) LOG_WARN("Shader program (" << program << ") declares " << blockSize << " bytes of push constants but its C++ struct has " << structSize)
+	
+	// Vertex inputs, every location must be fed by an attribute
+	for (auto& input : reflection.vertexInputs) {
+		for (uint32_t location = input.location; location < input.location + input.locationCount; ++location) {
+			if (std::none_of(attributes.begin(), attributes.end(), [location](const VkVertexInputAttributeDescription& attr){return attr.location == location;})) {
+				fail("reads vertex input " + input.name + " at location " + std::to_string(location) + " which has no attribute");
+			}
+		}
+	}
+}
+
 void ShaderProgram::CreateShaderStages(Device* device) {
 	if (stages.size() == 0) {
+		ValidateLayout();
 		for (auto& shader : shaders) {
 			shader.CreateShaderModule(device);
 			stages.push_back(shader.stageInfo);
@@ -17,16 +17,20 @@ namespace v4d::graphics::vulkan {
 	};
 
 	class ShaderProgram {
-	private:
+	protected:
 		std::vector<ShaderInfo> shaderFiles;
 		std::vector<Shader> shaders;
 		std::vector<VkPipelineShaderStageCreateInfo> stages;
 		
+	private:
 		std::vector<VkVertexInputBindingDescription> bindings;
 		std::vector<VkVertexInputAttributeDescription> attributes;
 		
 		PipelineLayout* pipelineLayout = nullptr;
 		
+		// throws if the pipeline layout or the vertex input do not provide what the stages use
+		void ValidateLayout() const;
+		
 	public:
 
 		ShaderProgram(PipelineLayout& pipelineLayout, const std::vector<ShaderInfo>& infos);
@@ -36,12 +40,24 @@ namespace v4d::graphics::vulkan {
 		void AddVertexInputBinding(uint32_t binding, uint32_t stride, VkVertexInputRate inputRate, std::vector<VertexInputAttributeDescription> attrs);
 		void AddVertexInputBinding(uint32_t stride, VkVertexInputRate inputRate, std::vector<VertexInputAttributeDescription> attrs);
 
-		// reads the spv files and instantiates all Shaders in the shaders vector
-		void ReadShaders();
+		// reads the spv files and instantiates all Shaders in the shaders vector,
+		// or gets their SPIR-V from the compiler (compiled from the GLSL sources, or from its cache),
+		// or from the archive when they are in it (the shaders keep it mapped)
+		void ReadShaders(ShaderCompiler* compiler = nullptr, const std::shared_ptr<const ShaderArchive>& archive = nullptr);
+		
+		// whether one of the stages is read from this file (same path as its ShaderInfo, without .spv)
+		bool UsesShaderFile(const std::string& filepath) const;
+		
+		// the file path of each stage, as given to the constructor
+		std::vector<std::string> GetShaderFiles() const;
 		
 		// clears bindings and attributes
 		void Reset();
 		
+		// what the stages declare, merged (descriptor bindings used by several stages have all their stage flags)
+		ShaderReflection GetReflection() const;
+		
+		// validates the pipeline layout and vertex input against the stages' SPIR-V before creating their modules
 		void CreateShaderStages(Device* device);
 		void DestroyShaderStages(Device* device);
 		
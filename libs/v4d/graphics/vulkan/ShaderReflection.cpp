@@ -0,0 +1,300 @@
+#include "../../common.h"
+
+using namespace v4d::graphics::vulkan;
+
+namespace {
+
+	// From the SPIR-V specification, only what is needed to find the interface of a module
+	enum : uint32_t {
+		OpName = 5,
+		OpTypeBool = 20,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpSpecConstant = 50,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+		OpTypeAccelerationStructure = 5341,
+	};
+	enum : uint32_t {
+		DecorationBufferBlock = 3,
+		DecorationRowMajor = 4,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35,
+	};
+	enum : uint32_t {
+		StorageClassUniformConstant = 0,
+		StorageClassInput = 1,
+		StorageClassUniform = 2,
+		StorageClassPushConstant = 9,
+		StorageClassStorageBuffer = 12,
+	};
+	const uint32_t DimBuffer = 5;
+	const uint32_t DimSubpassData = 6;
+	const uint32_t SpirvMagicNumber = 0x07230203;
+	const uint32_t NotDecorated = ~0u;
+
+	struct SpirvMember {
+		uint32_t offset = 0;
+		uint32_t matrixStride = 0;
+		bool rowMajor = false;
+	};
+
+	// A result id, either a type, a constant or a variable
+	struct SpirvId {
+		uint32_t opcode = 0;
+		std::vector<uint32_t> operands {}; // the words after the result id
+		std::string name {};
+		uint32_t set = NotDecorated;
+		uint32_t binding = NotDecorated;
+		uint32_t location = NotDecorated;
+		uint32_t arrayStride = 0;
+		bool bufferBlock = false;
+		bool builtIn = false;
+		std::vector<SpirvMember> members {};
+	};
+
+	class SpirvModule {
+		std::vector<SpirvId> ids;
+
+	public:
+		std::vector<uint32_t> variables {};
+
+		SpirvModule(const uint32_t* words, size_t codeSize) {
+			if (codeSize < 20 || codeSize % 4 != 0) throw std::runtime_error("Invalid SPIR-V size");
+			size_t wordCount = codeSize / 4;
+			if (words[0] != SpirvMagicNumber) throw std::runtime_error("Invalid SPIR-V magic number");
+			ids.resize(words[3]);
+
+			for (size_t i = 5; i < wordCount;) {
+				uint32_t opcode = words[i] & 0xffff;
+				uint32_t length = words[i] >> 16;
+				if (length == 0 || i + length > wordCount) throw std::runtime_error("Invalid SPIR-V instruction length");
+				const uint32_t* op = &words[i];
+				switch (opcode) {
+					case OpName: if (length > 2) {
+						const char* str = reinterpret_cast<const char*>(op + 2);
+						Get(op[1]).name = std::string(str, strnlen(str, (length - 2) * 4));
+					}break;
+					case OpDecorate: if (length > 2) {
+						Decorate(Get(op[1]), op[2], length > 3 ? op[3] : 0);
+					}break;
+					case OpMemberDecorate: if (length > 3) {
+						auto& type = Get(op[1]);
+						if (type.members.size() <= op[2]) type.members.resize(op[2] + 1);
+						auto& member = type.members[op[2]];
+						if (op[3] == DecorationOffset && length > 4) member.offset = op[4];
+						if (op[3] == DecorationMatrixStride && length > 4) member.matrixStride = op[4];
+						if (op[3] == DecorationRowMajor) member.rowMajor = true;
+						if (op[3] == DecorationBuiltIn) type.builtIn = true;
+					}break;
+					case OpTypeBool:
+					case OpTypeInt:
+					case OpTypeFloat:
+					case OpTypeVector:
+					case OpTypeMatrix:
+					case OpTypeImage:
+					case OpTypeSampler:
+					case OpTypeSampledImage:
+					case OpTypeArray:
+					case OpTypeRuntimeArray:
+					case OpTypeStruct:
+					case OpTypePointer:
+					case OpTypeAccelerationStructure: if (length > 1) {
+						auto& type = Get(op[1]);
+						type.opcode = opcode;
+						type.operands.assign(op + 2, op + length);
+					}break;
+					case OpConstant:
+					case OpSpecConstant:
+					case OpVariable: if (length > 3) {
+						// result type first, then the result id
+						auto& id = Get(op[2]);
+						id.opcode = opcode;
+						id.operands.assign(op + 1, op + length);
+						if (opcode == OpVariable) variables.push_back(op[2]);
+					}break;
+				}
+				i += length;
+			}
+		}
+
+		const SpirvId& Get(uint32_t id) const {
+			if (id >= ids.size()) throw std::runtime_error("Invalid SPIR-V id");
+			return ids[id];
+		}
+		SpirvId& Get(uint32_t id) {
+			if (id >= ids.size()) throw std::runtime_error("Invalid SPIR-V id");
+			return ids[id];
+		}
+
+		uint32_t Operand(const SpirvId& id, size_t i) const {
+			if (i >= id.operands.size()) throw std::runtime_error("Invalid SPIR-V instruction");
+			return id.operands[i];
+		}
+
+		// Default value of the constant that sizes an array, 0 if it is computed from specialization constants
+		uint32_t ArrayLength(const SpirvId& arrayType) const {
+			auto& length = Get(Operand(arrayType, 1));
+			if (length.opcode != OpConstant && length.opcode != OpSpecConstant) return 0;
+			return Operand(length, 2);
+		}
+
+		// Size of a type in a block with an explicit layout (Offset, ArrayStride and MatrixStride decorations)
+		uint32_t SizeOf(uint32_t typeId) const {
+			auto& type = Get(typeId);
+			switch (type.opcode) {
+				case OpTypeBool: return 4;
+				case OpTypeInt:
+				case OpTypeFloat: return Operand(type, 0) / 8;
+				case OpTypeVector: return SizeOf(Operand(type, 0)) * Operand(type, 1);
+				case OpTypeMatrix: return SizeOf(Operand(type, 0)) * Operand(type, 1);
+				case OpTypeArray: return (type.arrayStride ? type.arrayStride : SizeOf(Operand(type, 0))) * ArrayLength(type);
+				case OpTypeRuntimeArray: return 0;
+				case OpTypeStruct: {
+					uint32_t size = 0;
+					for (size_t i = 0; i < type.operands.size(); ++i) {
+						SpirvMember member = i < type.members.size() ? type.members[i] : SpirvMember{};
+						auto& memberType = Get(type.operands[i]);
+						uint32_t memberSize = SizeOf(type.operands[i]);
+						if (memberType.opcode == OpTypeMatrix && member.matrixStride) {
+							// columns, or rows when row major, are matrixStride apart
+							uint32_t vectors = member.rowMajor ? Operand(Get(Operand(memberType, 0)), 1) : Operand(memberType, 1);
+							memberSize = member.matrixStride * vectors;
+						}
+						size = std::max(size, member.offset + memberSize);
+					}
+					return size;
+				}
+			}
+			return 0;
+		}
+
+	private:
+		static void Decorate(SpirvId& id, uint32_t decoration, uint32_t value) {
+			switch (decoration) {
+				case DecorationBufferBlock: id.bufferBlock = true; break;
+				case DecorationArrayStride: id.arrayStride = value; break;
+				case DecorationBuiltIn: id.builtIn = true; break;
+				case DecorationLocation: id.location = value; break;
+				case DecorationBinding: id.binding = value; break;
+				case DecorationDescriptorSet: id.set = value; break;
+			}
+		}
+	};
+
+}
+
+ShaderReflection::ShaderReflection(const uint32_t* code, size_t codeSize, VkShaderStageFlagBits stage) {
+	SpirvModule module(code, codeSize);
+
+	for (uint32_t variableId : module.variables) {
+		auto& variable = module.Get(variableId);
+		uint32_t storageClass = module.Operand(variable, 2);
+		auto& pointer = module.Get(module.Operand(variable, 0));
+		if (pointer.opcode != OpTypePointer) throw std::runtime_error("Invalid SPIR-V variable type");
+		uint32_t typeId = module.Operand(pointer, 1);
+		auto* type = &module.Get(typeId);
+
+		switch (storageClass) {
+			case StorageClassUniformConstant:
+			case StorageClassUniform:
+			case StorageClassStorageBuffer: {
+				if (variable.binding == NotDecorated) break;
+				Binding binding {variable.set == NotDecorated ? 0 : variable.set, variable.binding, VK_DESCRIPTOR_TYPE_MAX_ENUM, 1, 0, (VkShaderStageFlags)stage, variable.name};
+				if (type->opcode == OpTypeArray) {
+					binding.descriptorCount = module.ArrayLength(*type);
+					typeId = module.Operand(*type, 0);
+					type = &module.Get(typeId);
+				} else if (type->opcode == OpTypeRuntimeArray) {
+					binding.descriptorCount = 0;
+					typeId = module.Operand(*type, 0);
+					type = &module.Get(typeId);
+				}
+				switch (type->opcode) {
+					case OpTypeSampler: binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER; break;
+					case OpTypeSampledImage: binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; break;
+					case OpTypeAccelerationStructure: binding.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV; break;
+					case OpTypeImage: {
+						// operands : sampled type, dim, depth, arrayed, multisampled, sampled (1 = with a sampler, 2 = storage)
+						uint32_t dim = module.Operand(*type, 1);
+						bool storage = module.Operand(*type, 5) == 2;
+						if (dim == DimSubpassData) binding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+						else if (dim == DimBuffer) binding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+						else binding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+					}break;
+					case OpTypeStruct: {
+						binding.descriptorType = (storageClass == StorageClassStorageBuffer || type->bufferBlock) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+						if (binding.name.empty()) binding.name = type->name;
+						// A block that ends with a runtime array is sized by its element, that is what a C++ struct describes
+						auto* lastMember = type->operands.empty() ? nullptr : &module.Get(type->operands.back());
+						if (lastMember && lastMember->opcode == OpTypeRuntimeArray) {
+							binding.bufferSize = lastMember->arrayStride ? lastMember->arrayStride : module.SizeOf(module.Operand(*lastMember, 0));
+						} else {
+							binding.bufferSize = module.SizeOf(typeId);
+						}
+					}break;
+				}
+				if (binding.descriptorType == VK_DESCRIPTOR_TYPE_MAX_ENUM) {
+					throw std::runtime_error("Unsupported descriptor type for set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding));
+				}
+				bindings.push_back(binding);
+			}break;
+			case StorageClassPushConstant: {
+				pushConstants.push_back({module.SizeOf(typeId), (VkShaderStageFlags)stage});
+			}break;
+			case StorageClassInput: {
+				if (stage != VK_SHADER_STAGE_VERTEX_BIT || variable.builtIn || type->builtIn || variable.location == NotDecorated) break;
+				uint32_t locationCount = 1;
+				if (type->opcode == OpTypeArray) {
+					locationCount = module.ArrayLength(*type);
+					type = &module.Get(module.Operand(*type, 0));
+				}
+				if (type->opcode == OpTypeMatrix) {
+					locationCount *= module.Operand(*type, 1);
+				}
+				vertexInputs.push_back({variable.location, locationCount, variable.name});
+			}break;
+		}
+	}
+}
+
+void ShaderReflection::Merge(const ShaderReflection& other) {
+	for (auto& binding : other.bindings) {
+		auto existing = std::find_if(bindings.begin(), bindings.end(), [&binding](const Binding& b){return b.set == binding.set && b.binding == binding.binding;});
+		if (existing == bindings.end()) {
+			bindings.push_back(binding);
+			continue;
+		}
+		if (existing->descriptorType != binding.descriptorType) {
+			throw std::runtime_error("Set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) + " is declared with different types in different stages");
+		}
+		existing->stageFlags |= binding.stageFlags;
+		existing->descriptorCount = std::max(existing->descriptorCount, binding.descriptorCount);
+		existing->bufferSize = std::max(existing->bufferSize, binding.bufferSize);
+	}
+	pushConstants.insert(pushConstants.end(), other.pushConstants.begin(), other.pushConstants.end());
+	vertexInputs.insert(vertexInputs.end(), other.vertexInputs.begin(), other.vertexInputs.end());
+}
+
+const ShaderReflection::Binding* ShaderReflection::FindBinding(uint32_t set, uint32_t binding) const {
+	for (auto& b : bindings) {
+		if (b.set == set && b.binding == binding) return &b;
+	}
+	return nullptr;
+}
@@ -0,0 +1,51 @@
+/*
+ * SPIR-V reflection
+ * Part of the Vulkan4D open-source game engine under the LGPL license - https://github.com/Vulkan4D
+ *
+ * Reads what a shader module expects from its pipeline layout and its vertex input : descriptor bindings, push constant block and vertex input locations.
+ * Only the few instructions that declare them are parsed, the rest of the module is skipped.
+ */
+#pragma once
+#include "../../common.h"
+
+namespace v4d::graphics::vulkan {
+
+	struct ShaderReflection {
+
+		struct Binding {
+			uint32_t set;
+			uint32_t binding;
+			VkDescriptorType descriptorType;
+			uint32_t descriptorCount; // 0 for a runtime array, or an array sized by a specialization constant
+			uint32_t bufferSize; // buffers only : size of the block, or of one element of the runtime array it ends with
+			VkShaderStageFlags stageFlags;
+			std::string name;
+		};
+
+		struct PushConstantBlock {
+			uint32_t size; // up to the end of its last member, without the padding that a C++ struct may have
+			VkShaderStageFlags stageFlags;
+		};
+
+		struct VertexInput {
+			uint32_t location;
+			uint32_t locationCount; // matrices take one location per column
+			std::string name;
+		};
+
+		std::vector<Binding> bindings {};
+		std::vector<PushConstantBlock> pushConstants {}; // at most one per stage
+		std::vector<VertexInput> vertexInputs {}; // vertex stage only
+
+		ShaderReflection() = default;
+		// codeSize in bytes, throws a std::runtime_error if the SPIR-V is malformed
+		ShaderReflection(const uint32_t* code, size_t codeSize, VkShaderStageFlagBits stage);
+
+		// Adds the bindings and push constants of another stage of the same program, the stage flags of the bindings that both use are combined.
+		// Throws if the other stage declares the same binding with another type.
+		void Merge(const ShaderReflection& other);
+
+		const Binding* FindBinding(uint32_t set, uint32_t binding) const;
+	};
+
+}
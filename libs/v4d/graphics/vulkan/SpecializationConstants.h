@@ -0,0 +1,51 @@
+/*
+ * Typed Vulkan specialization constants
+ * Part of the Vulkan4D open-source game engine under the LGPL license - https://github.com/Vulkan4D
+ *
+ * A struct of constant values, and the constant_id in the shaders that each of its members is bound to
+ */
+#pragma once
+#include "../../common.h"
+
+namespace v4d::graphics::vulkan {
+
+	template<class T>
+	class SpecializationConstants {
+		std::vector<VkSpecializationMapEntry> entries {};
+		VkSpecializationInfo info {0, nullptr, sizeof(T), nullptr};
+		
+	public:
+		T values {};
+		
+		SpecializationConstants() {
+			info.pData = &values;
+		}
+		
+		// info points to this object's members
+		SpecializationConstants(const SpecializationConstants&) = delete;
+		SpecializationConstants& operator=(const SpecializationConstants&) = delete;
+		
+		// layout(constant_id = constantId) const <type> ... in GLSL, bool members must be VkBool32
+		template<class M>
+		SpecializationConstants& Bind(uint32_t constantId, M T::* member) {
+			static_assert(std::is_same_v<M, int32_t> || std::is_same_v<M, uint32_t> || std::is_same_v<M, float> || std::is_same_v<M, double>, "Specialization constants are int, uint, bool (VkBool32), float or double");
+			size_t offset = reinterpret_cast<const char*>(&(values.*member)) - reinterpret_cast<const char*>(&values);
+			for (auto& entry : entries) {
+				if (entry.constantID == constantId) {
+					entry = {constantId, (uint32_t)offset, sizeof(M)};
+					return *this;
+				}
+			}
+			entries.push_back({constantId, (uint32_t)offset, sizeof(M)});
+			info.mapEntryCount = (uint32_t)entries.size();
+			info.pMapEntries = entries.data();
+			return *this;
+		}
+		
+		// For a ShaderInfo or a permutation, values are read when the pipelines are created
+		VkSpecializationInfo* GetInfo() {
+			return &info;
+		}
+	};
+	
+}
@@ -0,0 +1,85 @@
+#include "libs/v4d/common.h"
+#include "ThreadPool.h"
+
+using namespace v4d::utilities;
+
+ThreadPool::ThreadPool(size_t threadCount) {
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+		if (threadCount == 0) threadCount = 1;
+	}
+	for (size_t i = 0; i < threadCount; ++i) {
+		threads.emplace_back(&ThreadPool::Work, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(tasksMutex);
+		stopping = true;
+	}
+	tasksCondition.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::Work() {
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock lock(tasksMutex);
+			tasksCondition.wait(lock, [this]{return stopping || !tasks.empty();});
+			if (stopping && tasks.empty()) return;
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+		task();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)>& func) {
+	if (count == 0) return;
+	if (chunkSize == 0) chunkSize = 1;
+	size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+	if (chunkCount == 1) {
+		func(0, count);
+		return;
+	}
+
+	// Shared with the helper tasks, which may only start running after we returned if the workers are busy with other tasks
+	struct State {
+		std::atomic<size_t> nextChunk {0};
+		std::atomic<size_t> doneChunks {0};
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+	auto state = std::make_shared<State>();
+
+	auto run = [state, count, chunkSize, chunkCount, &func]{
+		size_t chunk;
+		while ((chunk = state->nextChunk++) < chunkCount) {
+			size_t begin = chunk * chunkSize;
+			func(begin, std::min(begin + chunkSize, count));
+			if (++state->doneChunks == chunkCount) {
+				std::lock_guard lock(state->mutex);
+				state->done.notify_all();
+			}
+		}
+	};
+
+	size_t helperCount = std::min(threads.size(), chunkCount - 1);
+	{
+		std::lock_guard lock(tasksMutex);
+		for (size_t i = 0; i < helperCount; ++i) {
+			tasks.emplace(run);
+		}
+	}
+	tasksCondition.notify_all();
+
+	// The calling thread works too
+	run();
+
+	std::unique_lock lock(state->mutex);
+	state->done.wait(lock, [&state, chunkCount]{return state->doneChunks == chunkCount;});
+}
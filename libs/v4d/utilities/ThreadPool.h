@@ -0,0 +1,54 @@
+/*
+ * Thread pool
+ * Part of the Vulkan4D open-source game engine under the LGPL license - https://github.com/Vulkan4D
+ * @author Olivier St-Laurent <olivier@xenon3d.com>
+ *
+ * Fixed set of worker threads that run queued tasks, with a blocking ParallelFor helper for data-parallel loops
+ */
+#pragma once
+#include "libs/v4d/common.h"
+
+#include <condition_variable>
+#include <future>
+
+namespace v4d::utilities {
+
+	class ThreadPool {
+		std::vector<std::thread> threads {};
+		std::queue<std::function<void()>> tasks {};
+		std::mutex tasksMutex;
+		std::condition_variable tasksCondition;
+		bool stopping = false;
+
+	public:
+		// threadCount = 0 uses one thread per hardware thread, minus the calling thread
+		ThreadPool(size_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		size_t GetThreadCount() const {return threads.size();}
+
+		// Runs func on one of the worker threads
+		template<class F>
+		auto Enqueue(F&& func) -> std::future<decltype(func())> {
+			auto task = std::make_shared<std::packaged_task<decltype(func())()>>(std::forward<F>(func));
+			auto future = task->get_future();
+			{
+				std::lock_guard lock(tasksMutex);
+				tasks.emplace([task]{(*task)();});
+			}
+			tasksCondition.notify_one();
+			return future;
+		}
+
+		// Splits [0, count) into chunks of chunkSize and runs func(begin, end) for each of them on the worker threads and the calling thread.
+		// Returns when all chunks are done.
+		void ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)>& func);
+
+	private:
+		void Work();
+	};
+
+}
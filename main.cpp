@@ -8,6 +8,8 @@
 
 #include "DeferredRenderer.hpp"
 
+#include <random>
+
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
 
@@ -35,10 +37,25 @@ int main(int argc, char *argv[]) {
 		VK_PRESENT_MODE_FIFO_KHR,
 		VK_PRESENT_MODE_IMMEDIATE_KHR,
 	};
+	// Startup time of each step, the pipelines also log their own creation times
+	auto startupStep = std::chrono::high_resolution_clock::now();
+	auto logStartupStep = [&startupStep](const char* step){
+		auto now = std::chrono::high_resolution_clock::now();
+		LOG("Startup : " << step << " " << std::chrono::duration<double, std::milli>(now - startupStep).count() << " ms")
+		startupStep = now;
+	};
 	renderer.InitRenderer();
+	logStartupStep("init");
+	for (int i = 1; i < argc; ++i) {
+		// Compiles the shaders of the source tree (next to the build directory, like the shaders build step) instead of reading the prebuilt .spv files
+		if (std::string(argv[i]) == "--compile-shaders") renderer.EnableShaderCompiler(i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "../SimpleQtDeferredRenderer");
+	}
 	renderer.ReadShaders();
+	logStartupStep("shaders");
 	renderer.LoadScene();
+	logStartupStep("scene");
 	renderer.LoadRenderer();
+	logStartupStep("renderer");
 
     struct PlayerView {
         double camSpeed = 10.0, mouseSensitivity = 1.0, tiltSpeed = 2.0;
@@ -53,6 +70,129 @@ int main(int argc, char *argv[]) {
         glm::dmat4 freeFlyCamRotationMatrix {1};
     } player;
 
+    // Culling benchmark (--cull-benchmark), queries random scenes of increasing size from the initial point of view,
+    // with an AABB tree like the renderer's and with a test of every object
+    struct CullBenchmark {
+        bool enabled = false;
+        std::vector<int> objectCounts {1000, 10000, 100000};
+        int queries = 100;
+        double sphereRadius = 50; // like a point light's influence
+        double coneRange = 100, coneAngle = glm::radians(30.0); // like a spot light's
+
+        void Run(const v4d::graphics::Camera& camera) const {
+            using clock = std::chrono::high_resolution_clock;
+            v4d::graphics::Frustum frustum = camera.GetFrustum();
+            v4d::graphics::BoundingSphere sphere {camera.worldPosition, sphereRadius};
+            v4d::graphics::BoundingCone cone {camera.worldPosition, glm::normalize(camera.lookDirection), coneRange, coneAngle};
+            for (int objectCount : objectCounts) {
+                // Same density at every size, boxes of 0.5 to 2 units around the camera
+                std::mt19937 random(1);
+                float extent = 10.0f * std::cbrt((float)objectCount);
+                std::uniform_real_distribution<float> position(-extent, extent), halfSize(0.25f, 1.0f);
+                std::vector<v4d::graphics::Aabb> objects(objectCount);
+                for (auto& aabb : objects) {
+                    glm::vec3 center = glm::vec3(camera.worldPosition) + glm::vec3(position(random), position(random), position(random));
+                    glm::vec3 half {halfSize(random)};
+                    aabb = {center - half, center + half};
+                }
+
+                auto buildStart = clock::now();
+                v4d::graphics::DynamicAabbTree tree;
+                for (int i = 0; i < objectCount; ++i) tree.CreateProxy(objects[i], i);
+                double buildMilliseconds = std::chrono::duration<double, std::milli>(clock::now() - buildStart).count();
+                LOG(objectCount << " objects : tree built in " << buildMilliseconds << " ms, height " << tree.GetHeight())
+
+                // The tree tests fat AABBs, so it may report a few more objects
+                auto compare = [&](const char* name, const auto& volume){
+                    size_t treeCount = 0, linearCount = 0;
+                    auto start = clock::now();
+                    for (int q = 0; q < queries; ++q) {
+                        treeCount = 0;
+                        tree.Query(volume, [&treeCount](uint32_t){++treeCount;});
+                    }
+                    double treeMilliseconds = std::chrono::duration<double, std::milli>(clock::now() - start).count() / queries;
+                    start = clock::now();
+                    for (int q = 0; q < queries; ++q) {
+                        linearCount = 0;
+                        for (auto& aabb : objects) if (volume.Test(aabb) != v4d::graphics::OUTSIDE) ++linearCount;
+                    }
+                    double linearMilliseconds = std::chrono::duration<double, std::milli>(clock::now() - start).count() / queries;
+                    LOG("    " << name << " : tree " << treeMilliseconds << " ms per query (" << treeCount << " objects), "
+                        << "brute force " << linearMilliseconds << " ms per query (" << linearCount << " objects)")
+                };
+                compare("frustum", frustum);
+                compare("sphere", sphere);
+                compare("cone", cone);
+            }
+        }
+    } cullBenchmark;
+
+    // Lighting benchmark (--light-benchmark), renders the scene from the initial point of view with an increasing number of point lights in each lighting mode
+    struct LightBenchmark {
+        bool enabled = false;
+        std::vector<int> lightCounts {5, 50, 100, 500, 1000, 2000, 5000, 10000};
+        std::vector<DeferredRenderer::LightingMode> modes {DeferredRenderer::LIGHTING_PER_LIGHT, DeferredRenderer::LIGHTING_CLUSTERED, DeferredRenderer::LIGHTING_VOLUMES};
+        int maxPerLightCount = 2000; // shading every light for every pixel is too slow to be worth measuring beyond this
+        int warmupFrames = 10;
+        int measuredFrames = 100;
+        size_t step = 0;
+        int frame = 0;
+        double totalMilliseconds = 0;
+        std::vector<v4d::graphics::LightSource> sceneLights {};
+
+        int GetLightCount() const {return lightCounts[step % lightCounts.size()];}
+        DeferredRenderer::LightingMode GetMode() const {return modes[step / lightCounts.size()];}
+        const char* GetModeName() const {
+            switch (GetMode()) {
+                case DeferredRenderer::LIGHTING_PER_LIGHT: return "Per light";
+                case DeferredRenderer::LIGHTING_CLUSTERED: return "Clustered";
+                case DeferredRenderer::LIGHTING_VOLUMES: return "Light volume";
+            }
+            return "";
+        }
+        bool IsDone() const {return step >= lightCounts.size() * modes.size();}
+    } benchmark;
+
+    // Shadow benchmark (--shadow-benchmark), renders the scene from the initial point of view with each shadow filter
+    struct ShadowBenchmark {
+        bool enabled = false;
+        struct Setting {
+            DeferredRenderer::ShadowFilter filter;
+            uint32_t taps;
+            const char* name;
+        };
+        std::vector<Setting> settings {
+            {DeferredRenderer::SHADOW_FILTER_HARDWARE_PCF, 1, "Hardware PCF"},
+            {DeferredRenderer::SHADOW_FILTER_POISSON, 8, "Poisson disk, 8 taps"},
+            {DeferredRenderer::SHADOW_FILTER_POISSON, 16, "Poisson disk, 16 taps"},
+            {DeferredRenderer::SHADOW_FILTER_POISSON, 32, "Poisson disk, 32 taps"},
+            {DeferredRenderer::SHADOW_FILTER_VARIANCE, 1, "Variance"},
+            {DeferredRenderer::SHADOW_FILTER_EXPONENTIAL, 1, "Exponential"},
+        };
+        int warmupFrames = 10;
+        int measuredFrames = 100;
+        size_t step = 0;
+        int frame = 0;
+        double shadowMilliseconds = 0;
+        double prefilteringMilliseconds = 0;
+        double lightingMilliseconds = 0;
+
+        bool IsDone() const {return step >= settings.size();}
+    } shadowBenchmark;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--light-benchmark") benchmark.enabled = true;
+        if (std::string(argv[i]) == "--shadow-benchmark") shadowBenchmark.enabled = true;
+        if (std::string(argv[i]) == "--cull-benchmark") cullBenchmark.enabled = true;
+        // Recompiles the shaders of the source tree (next to the build directory, like the shaders build step) when they are saved
+        if (std::string(argv[i]) == "--shader-hot-reload") renderer.EnableShaderHotReload(i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "../SimpleQtDeferredRenderer/shaders");
+    }
+    if (benchmark.enabled) {
+        // Keep the scene's own lights except its point lights
+        for (auto& lightSource : renderer.lightSources) {
+            if (lightSource.type != v4d::graphics::POINT_LIGHT) benchmark.sceneLights.push_back(lightSource);
+        }
+    }
+
     // Game Loop
     std::thread gameLoopThread ([&]{
         while (window.isVisible()) {
@@ -125,6 +265,52 @@ int main(int argc, char *argv[]) {
                 window.resetEvents();
             }
 
+            if (cullBenchmark.enabled) {
+                // CPU only, from the initial point of view
+                PlayerView view {};
+                v4d::graphics::Camera camera = renderer.camera;
+                camera.worldPosition = view.worldPosition;
+                camera.lookDirection = view.viewForward;
+                camera.viewUp = view.viewUp;
+                camera.RefreshViewMatrix();
+                camera.RefreshProjectionMatrix((double)window.width() / window.height());
+                cullBenchmark.Run(camera);
+                break;
+            }
+            if (benchmark.enabled) {
+                player = PlayerView{};
+                // Skip the steps that would take too long
+                while (benchmark.frame == 0 && !benchmark.IsDone() && benchmark.GetMode() == DeferredRenderer::LIGHTING_PER_LIGHT && benchmark.GetLightCount() > benchmark.maxPerLightCount) {
+                    benchmark.step++;
+                }
+                if (benchmark.IsDone()) break;
+                if (benchmark.frame == 0) {
+                    // Same random lights for both modes, scattered above the ground in front of the camera
+                    std::mt19937 random(1);
+                    std::uniform_real_distribution<double> x(-40, 40), y(0, 80), z(-5.5, -2);
+                    std::uniform_real_distribution<float> color(0.2f, 1.0f);
+                    renderer.lightSources = benchmark.sceneLights;
+                    for (int i = 0; i < benchmark.GetLightCount(); ++i) {
+                        renderer.lightSources.push_back({v4d::graphics::POINT_LIGHT, {x(random), y(random), z(random)}, {color(random), color(random), color(random)}, /*intensity*/1.0, {1,1,1}, 0, 0, /*radius*/6});
+                    }
+                    renderer.lightingMode = benchmark.GetMode();
+                    benchmark.totalMilliseconds = 0;
+                }
+            }
+            if (shadowBenchmark.enabled) {
+                player = PlayerView{};
+                if (shadowBenchmark.IsDone()) break;
+                if (shadowBenchmark.frame == 0) {
+                    // Filters are applied when the pipelines are created
+                    renderer.shadowFilter = shadowBenchmark.settings[shadowBenchmark.step].filter;
+                    renderer.shadowFilterTaps = shadowBenchmark.settings[shadowBenchmark.step].taps;
+                    renderer.ReloadRenderer();
+                    shadowBenchmark.shadowMilliseconds = 0;
+                    shadowBenchmark.prefilteringMilliseconds = 0;
+                    shadowBenchmark.lightingMilliseconds = 0;
+                }
+            }
+
             // Update camera position
             renderer.camera.worldPosition = player.worldPosition;
             renderer.camera.lookDirection = player.viewForward;
@@ -133,6 +319,36 @@ int main(int argc, char *argv[]) {
             // Draw a frame
             renderer.Render();
 
+            if (benchmark.enabled) {
+                // GPU timings come back a few frames late, the warmup frames cover that
+                if (benchmark.frame >= benchmark.warmupFrames) benchmark.totalMilliseconds += renderer.GetLightingGpuTime();
+                if (++benchmark.frame == benchmark.warmupFrames + benchmark.measuredFrames) {
+                    auto& culling = renderer.GetLightCullingStats();
+                    LOG(benchmark.GetModeName() << " lighting, " << benchmark.GetLightCount() << " point lights : " << (benchmark.totalMilliseconds / benchmark.measuredFrames) << " ms, "
+                        << culling.culled << " lights culled, " << culling.scissored << " scissored (" << culling.pixelsSaved << " pixels saved)")
+                    benchmark.frame = 0;
+                    benchmark.step++;
+                }
+                continue; // no need to sleep
+            }
+            if (shadowBenchmark.enabled) {
+                if (shadowBenchmark.frame >= shadowBenchmark.warmupFrames) {
+                    shadowBenchmark.shadowMilliseconds += renderer.GetShadowGpuTime();
+                    shadowBenchmark.prefilteringMilliseconds += renderer.GetShadowPrefilteringGpuTime();
+                    shadowBenchmark.lightingMilliseconds += renderer.GetLightingGpuTime();
+                }
+                if (++shadowBenchmark.frame == shadowBenchmark.warmupFrames + shadowBenchmark.measuredFrames) {
+                    int n = shadowBenchmark.measuredFrames;
+                    auto& commands = renderer.GetCommandStats();
+                    auto binds = commands.GetTotal();
+                    LOG(shadowBenchmark.settings[shadowBenchmark.step].name << " : " << (shadowBenchmark.shadowMilliseconds / n) << " ms shadow maps, " << (shadowBenchmark.prefilteringMilliseconds / n) << " ms prefiltering, " << (shadowBenchmark.lightingMilliseconds / n) << " ms lighting, "
+                        << commands.draws << " draws with " << binds.issued << " binds (" << binds.elided << " redundant binds skipped)")
+                    shadowBenchmark.frame = 0;
+                    shadowBenchmark.step++;
+                }
+                continue; // no need to sleep
+            }
+
             // sleep
             using namespace std::literals::chrono_literals;
             std::this_thread::sleep_for(10ms);
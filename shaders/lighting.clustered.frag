@@ -0,0 +1,52 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : require
+
+precision highp int;
+precision highp float;
+
+// Shades all the lights binned by lighting.clusters.comp in a single full screen pass
+
+layout(std430, push_constant) uniform ClusterGrid {
+	uvec2 screenSize;
+	uint tileSize;
+	uint depthSlices;
+	float zNear;
+	float zFar;
+	float projectionScaleX;
+	float projectionScaleY;
+	uint lightCount;
+	uint maxLightsPerCluster;
+} grid;
+
+#include "lighting.glsl"
+
+// Clusters
+layout(set = 2, binding = 1, std430) readonly buffer ClusterLightCounts {
+	uint clusterLightCounts[];
+};
+layout(set = 2, binding = 2, std430) readonly buffer ClusterLightIndices {
+	uint clusterLightIndices[];
+};
+
+layout(location = 0) out vec4 out_color;
+
+void main(void) {
+    GBuffers gBuffers = LoadGBuffers();
+
+	// Find our cluster
+	uvec2 tileCount = (grid.screenSize + grid.tileSize - 1) / grid.tileSize;
+	uvec2 tile = min(uvec2(gl_FragCoord.xy) / grid.tileSize, tileCount - 1);
+	float depth = -gBuffers.position.z;
+	uint slice = depth > grid.zNear ? uint(log(depth / grid.zNear) / log(grid.zFar / grid.zNear) * float(grid.depthSlices)) : 0;
+	slice = min(slice, grid.depthSlices - 1);
+	uint clusterIndex = (slice * tileCount.y + tile.y) * tileCount.x + tile.x;
+
+	vec3 light = vec3(0);
+
+	uint clusterLightCount = clusterLightCounts[clusterIndex];
+	for (uint i = 0; i < clusterLightCount; ++i) {
+		light += ShadeLight(lights[clusterLightIndices[clusterIndex * grid.maxLightsPerCluster + i]], gBuffers);
+	}
+
+	out_color = vec4(gBuffers.albedo.rgb * light, 1);
+}
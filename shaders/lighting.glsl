@@ -0,0 +1,219 @@
+// Included by the lighting shaders (lighting.frag and lighting.clustered.frag), so that every lighting path shades the same way
+
+struct LightSource {
+	vec3 viewPosition;
+	float radius; // 0 = infinite
+	vec3 color;
+	float intensity;
+	vec3 viewDirection;
+	int type; // 0 = point, 1 = spot, 2 = ambient (skybox), 3 = directional
+	float innerAngle;
+	float outerAngle;
+	int shadowMap; // -1 = no shadow
+};
+
+struct GBuffers {
+	highp vec4 albedo;
+	lowp  vec3 normal;
+	highp vec3 position;
+};
+
+// G-Buffers
+layout(set = 1, input_attachment_index = 0, binding = 0) uniform highp subpassInput gBuffer_albedo;
+layout(set = 1, input_attachment_index = 1, binding = 1) uniform highp  subpassInput gBuffer_normal;
+layout(set = 1, input_attachment_index = 2, binding = 2) uniform highp subpassInput gBuffer_position;
+
+layout(set = 1, binding = 3) uniform sampler2DShadow shadowAtlas; // comparison sampler, unless the shadow maps are prefiltered
+layout(set = 1, binding = 5) uniform sampler2D shadowMoments; // prefiltered shadow maps
+layout(set = 1, binding = 6) uniform samplerCubeArrayShadow shadowCubes; // point lights, comparison sampler
+layout(set = 1, binding = 7) uniform sampler2DArrayShadow shadowCascades; // directional light, comparison sampler
+
+// Lights
+layout(set = 2, binding = 0, std430) readonly buffer Lights {
+	LightSource lights[];
+};
+
+// Shadow maps, in the light's tile of the shadow atlas (spot lights), in a cube of the shadow cubes (point lights) or in the cascades (directional light)
+struct ShadowMap {
+	mat4 cameraViewToShadowMapMatrix; // point lights: to the light's position, with the world's axes
+	vec4 atlasRect; // offset and size in uv coordinates
+	vec2 cubeDepthProjection; // projection[2][2] and [3][2] of the cube's faces
+	int layer; // point lights: cube, directional light: cascade
+	float cascadeEnd; // distance from the camera up to which the cascade is used
+	int cascadeCount; // the light's cascades are consecutive
+};
+layout(set = 2, binding = 3, std430) readonly buffer ShadowMaps {
+	ShadowMap shadowMaps[];
+};
+
+// Shadow filtering, chosen when the pipeline is created (DeferredRenderer::ShadowFilter)
+layout(constant_id = 0) const int shadowFilter = 1; // 0 = hardware PCF, 1 = Poisson disk, 2 = variance, 3 = exponential
+layout(constant_id = 1) const int shadowFilterTaps = 16; // Poisson disk, 1 to 32
+layout(constant_id = 2) const float shadowFilterRadius = 3.0; // in texels
+layout(constant_id = 3) const float shadowExponent = 80.0; // exponential shadow maps
+
+// Light type of the pipeline's permutation (DeferredRenderer::lightingPermutations), -1 reads it from each light,
+// otherwise the branches on the light's type are resolved when the pipeline is created
+layout(constant_id = 4) const int lightType = -1;
+
+// Blinn-Phong specular, chosen when the pipeline is created (DeferredRenderer::specularPower and specularStrength)
+layout(constant_id = 5) const float specularPower = 32.0;
+layout(constant_id = 6) const float specularStrength = 0.5;
+
+// Points in the unit disk, placed by best-candidate sampling so that the first shadowFilterTaps are evenly spread
+const vec2 poissonDisk[32] = vec2[](
+	vec2(0.1598, -0.0876), vec2(-0.7077, 0.6530), vec2(-0.8787, -0.4625), vec2(0.4498, 0.7946),
+	vec2(-0.0140, -0.9691), vec2(0.9604, 0.1273), vec2(0.7267, -0.6354), vec2(-0.1353, 0.4350),
+	vec2(-0.6069, 0.0375), vec2(-0.2373, -0.4569), vec2(-0.1232, 0.9810), vec2(0.5064, 0.2749),
+	vec2(-0.5276, -0.8283), vec2(0.2684, -0.5886), vec2(0.5796, -0.2227), vec2(-0.9958, 0.0183),
+	vec2(0.8086, 0.5270), vec2(-0.2180, 0.0256), vec2(-0.3691, 0.7307), vec2(0.9282, -0.2771),
+	vec2(-0.9304, 0.3644), vec2(0.2101, 0.5128), vec2(0.3752, -0.9192), vec2(-0.5430, -0.2966),
+	vec2(-0.4931, 0.3610), vec2(0.1594, 0.2104), vec2(0.1776, 0.9468), vec2(0.0446, -0.3771),
+	vec2(-0.2160, -0.7554), vec2(0.6924, 0.0359), vec2(0.0004, 0.7118), vec2(-0.7962, -0.1783)
+);
+
+GBuffers LoadGBuffers() {
+	return GBuffers(
+		subpassLoad(gBuffer_albedo).rgba,
+		subpassLoad(gBuffer_normal).xyz,
+		subpassLoad(gBuffer_position).xyz
+	);
+}
+
+// The permutation's light type, or the light's own
+int LightType(LightSource lightSource) {
+	return lightType >= 0 ? lightType : lightSource.type;
+}
+
+// Blinn-Phong, diffuse + specular of a light coming from lightDir (view space)
+vec3 BlinnPhong(GBuffers gBuffers, vec3 lightDir, vec3 lightColor, float lightIntensity) {
+	// diffuse
+	float diff = max(dot(gBuffers.normal, lightDir), 0.0);
+	vec3 diffuse = diff * lightColor * lightIntensity;
+
+	// specular
+	vec3 viewDir = normalize(-gBuffers.position);
+	vec3 reflectDir = reflect(-lightDir, gBuffers.normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), specularPower);
+	vec3 specular = specularStrength * spec * lightColor;
+
+	return diffuse + specular;
+}
+
+// Fades out to zero at the light's radius (0 = infinite)
+float RadiusFalloff(vec3 lightPosition, float radius, vec3 position) {
+	if (radius <= 0) return 1.0;
+	float d = distance(lightPosition, position) / radius;
+	float attenuation = clamp(1.0 - d*d*d*d, 0.0, 1.0);
+	return attenuation * attenuation;
+}
+
+// Spot light cone, angles in degrees
+float SpotCone(vec3 lightDir, vec3 spotDirection, float innerAngle, float outerAngle) {
+	float innerCutOff = cos(radians(innerAngle));
+	float outerCutOff = cos(radians(outerAngle));
+	float theta = dot(lightDir, normalize(-spotDirection));
+	float epsilon = (innerCutOff - outerCutOff);
+	return clamp((theta - outerCutOff) / epsilon, 0.0, 1.0);
+}
+
+// Fraction of the light that is not occluded, filtered within the light's tile
+float SampleShadow(int shadowMapIndex, vec3 position, vec3 normal, vec3 lightDir) {
+	ShadowMap shadowMapData = shadowMaps[shadowMapIndex];
+	vec4 pos = shadowMapData.cameraViewToShadowMapMatrix * vec4(position, 1);
+	vec3 lightSpacePos = (pos.xyz / abs(pos.w));
+	lightSpacePos.z = clamp(lightSpacePos.z, 0, 1);
+	// Reversed depth, the receiver is lit where its depth is greater than or equal to the occluder's
+	float receiverDepth = lightSpacePos.z + max(0.01 * (1.0 - dot(lightDir, normal)), 0.001);
+	vec2 texelSize = 1.0 / textureSize(shadowAtlas, 0);
+	vec2 uv = shadowMapData.atlasRect.xy + (lightSpacePos.xy / 2.0 + 0.5) * shadowMapData.atlasRect.zw;
+	// Samples must not read the neighbouring tiles
+	vec2 tileMin = shadowMapData.atlasRect.xy + texelSize * 0.5;
+	vec2 tileMax = shadowMapData.atlasRect.xy + shadowMapData.atlasRect.zw - texelSize * 0.5;
+
+	// The sampler compares and bilinearly filters 2x2 texels
+	if (shadowFilter == 0) {
+		return texture(shadowAtlas, vec3(clamp(uv, tileMin, tileMax), receiverDepth));
+	}
+
+	// Rotated per pixel, so that the banding of a few taps turns into noise
+	if (shadowFilter == 1) {
+		float angle = 6.2831853 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+		mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle)) * shadowFilterRadius;
+		float lit = 0.0;
+		for (int i = 0; i < shadowFilterTaps; ++i) {
+			lit += texture(shadowAtlas, vec3(clamp(uv + rotation * poissonDisk[i] * texelSize, tileMin, tileMax), receiverDepth));
+		}
+		return lit / float(shadowFilterTaps);
+	}
+
+	// Prefiltered by shaders/shadows.prefilter.comp
+	vec2 moments = texture(shadowMoments, clamp(uv, tileMin, tileMax)).rg;
+	if (shadowFilter == 2) {
+		// Chebyshev's upper bound, rescaled to reduce light bleeding
+		if (receiverDepth >= moments.x) return 1.0;
+		float variance = max(moments.y - moments.x * moments.x, 0.000001);
+		float d = moments.x - receiverDepth;
+		float pMax = variance / (variance + d * d);
+		return clamp((pMax - 0.2) / 0.8, 0, 1);
+	}
+	return clamp(exp(shadowExponent * receiverDepth) / moments.r, 0, 1);
+}
+
+// Fraction of the light that is not occluded, with a single hardware PCF sample whatever the shadow filter
+float SamplePointShadow(int shadowMapIndex, vec3 position, vec3 normal, vec3 lightDir) {
+	ShadowMap shadowMapData = shadowMaps[shadowMapIndex];
+	vec3 dir = (shadowMapData.cameraViewToShadowMapMatrix * vec4(position, 1)).xyz;
+	// The face's view depth is the distance along the major axis, moved towards the light so that surfaces do not shadow themselves
+	vec3 absDir = abs(dir);
+	float d = max(max(absDir.x, absDir.y), absDir.z) * (1.0 - max(0.02 * (1.0 - dot(lightDir, normal)), 0.005));
+	float receiverDepth = clamp((shadowMapData.cubeDepthProjection.x * -d + shadowMapData.cubeDepthProjection.y) / d, 0, 1);
+	return texture(shadowCubes, vec4(dir, shadowMapData.layer), receiverDepth);
+}
+
+// Fraction of the light that is not occluded, in the first cascade that contains the position, lit beyond the last one
+float SampleCascadedShadow(int firstShadowMap, vec3 position, vec3 normal, vec3 lightDir) {
+	float depth = -position.z;
+	int cascadeCount = shadowMaps[firstShadowMap].cascadeCount;
+	for (int i = 0; i < cascadeCount; ++i) {
+		ShadowMap shadowMapData = shadowMaps[firstShadowMap + i];
+		if (depth > shadowMapData.cascadeEnd) continue;
+		mat4 m = shadowMapData.cameraViewToShadowMapMatrix;
+		// Pushed out along the normal by about a texel of this cascade, its x scale is one over its radius
+		float texelSize = 2.0 / (float(textureSize(shadowCascades, 0).x) * length(vec3(m[0][0], m[1][0], m[2][0])));
+		vec3 pos = (m * vec4(position + normal * texelSize * 1.5 * (1.0 - dot(lightDir, normal)), 1)).xyz;
+		float receiverDepth = clamp(pos.z, 0, 1) + 0.0005;
+		return texture(shadowCascades, vec4(pos.xy / 2.0 + 0.5, shadowMapData.layer, receiverDepth));
+	}
+	return 1.0;
+}
+
+// Light reflected by the surface from a point, spot or directional light (diffuse + specular), with its falloff, cone and shadow
+vec3 ShadeLight(LightSource lightSource, GBuffers gBuffers) {
+	int type = LightType(lightSource);
+	vec3 lightDir = type == 3 ? normalize(-lightSource.viewDirection) : normalize(lightSource.viewPosition - gBuffers.position);
+	float attenuation = type == 3 ? 1.0 : RadiusFalloff(lightSource.viewPosition, lightSource.radius, gBuffers.position);
+
+	// Spot light
+	if (type == 1) {
+		attenuation *= SpotCone(lightDir, lightSource.viewDirection, lightSource.innerAngle, lightSource.outerAngle);
+
+		// Shadow map, not sampled where the light does not reach anyway
+		if (lightSource.shadowMap >= 0 && attenuation > 0) {
+			attenuation *= SampleShadow(lightSource.shadowMap, gBuffers.position, gBuffers.normal, lightDir);
+		}
+	}
+
+	// Directional light, cascades
+	else if (type == 3 && lightSource.shadowMap >= 0) {
+		attenuation *= SampleCascadedShadow(lightSource.shadowMap, gBuffers.position, gBuffers.normal, lightDir);
+	}
+
+	// Point light, shadow cube
+	else if (type == 0 && lightSource.shadowMap >= 0 && attenuation > 0) {
+		attenuation *= SamplePointShadow(lightSource.shadowMap, gBuffers.position, gBuffers.normal, lightDir);
+	}
+
+	if (attenuation <= 0) return vec3(0);
+	return BlinnPhong(gBuffers, lightDir, lightSource.color, lightSource.intensity) * attenuation;
+}
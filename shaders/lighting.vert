@@ -4,7 +4,17 @@ precision highp int;
 precision highp float;
 precision highp sampler2D;
 
+layout(std430, push_constant) uniform LightBatch {
+	uint firstLight;
+	uint lightCount;
+} lightBatch;
+
+layout(location = 0) flat out uint out_firstLight;
+layout(location = 1) flat out uint out_lightCount;
+
 void main() {
 	// Full screen triangle using 3 empty vertices
 	gl_Position = vec4(vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2) * 2.0f + -1.0f, 0.0f, 1.0f);
+	out_firstLight = lightBatch.firstLight;
+	out_lightCount = lightBatch.lightCount;
 }
@@ -0,0 +1,53 @@
+#version 460 core
+
+precision highp int;
+precision highp float;
+
+// Places the unit light volumes from LightVolume.hpp around a light, so that only the pixels it may reach run lighting.frag
+// The light's index in the lights buffer is the instance index
+
+struct LightSource {
+	vec3 viewPosition;
+	float radius; // 0 = infinite
+	vec3 color;
+	float intensity;
+	vec3 viewDirection;
+	int type; // 0 = point, 1 = spot
+	float innerAngle;
+	float outerAngle;
+	int shadowMap; // -1 = no shadow
+};
+
+layout(set = 0, binding = 0) uniform CameraUBO {
+	dmat4 cameraViewMatrix;
+	dmat4 cameraProjectionMatrix;
+};
+
+layout(set = 2, binding = 0, std430) readonly buffer Lights {
+	LightSource lights[];
+};
+
+layout(location = 0) in vec3 pos;
+
+layout(location = 0) flat out uint out_firstLight;
+layout(location = 1) flat out uint out_lightCount;
+
+void main() {
+	LightSource lightSource = lights[gl_InstanceIndex];
+	vec3 viewPos;
+	if (lightSource.type == 1) {
+		// Cone along the spot light's direction, as long as its radius
+		vec3 forward = normalize(lightSource.viewDirection);
+		vec3 up = abs(forward.y) < 0.99 ? vec3(0,1,0) : vec3(1,0,0);
+		vec3 right = normalize(cross(up, forward));
+		up = cross(forward, right);
+		float baseRadius = tan(radians(lightSource.outerAngle)) * lightSource.radius;
+		viewPos = lightSource.viewPosition + (right * pos.x + up * pos.y) * baseRadius + forward * pos.z * lightSource.radius;
+	} else {
+		// Sphere
+		viewPos = lightSource.viewPosition + pos * lightSource.radius;
+	}
+	gl_Position = mat4(cameraProjectionMatrix) * vec4(viewPos, 1);
+	out_firstLight = uint(gl_InstanceIndex);
+	out_lightCount = 1;
+}
@@ -17,7 +17,7 @@ layout(location = 1) out highp vec3 gBuffer_normal;
 layout(location = 2) out highp vec3 gBuffer_position;
 
 void main() {
-	gBuffer_albedo = vec4(v2f.color, 1);
+	gBuffer_albedo = vec4(v2f.color, 1); // alpha is the gloss of the reflections, 1 = mirror
 	gBuffer_normal = normalize(v2f.normal);
 	gBuffer_position = v2f.pos;
 }
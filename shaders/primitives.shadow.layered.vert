@@ -0,0 +1,25 @@
+#version 460 core
+
+precision highp int;
+precision highp float;
+
+// Same as primitives.shadow.vert, for layered shadow maps (the faces of shadow cubes, the cascades of directional lights).
+// Each instance is one layer that the object overlaps.
+layout(std430, push_constant) uniform MeshInstancePushConstant {
+	mat4 projectionMatrix; // identity, layers have different projections so each instance's matrix includes its own
+};
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec3 color;
+
+// Per instance, the layer's view projection times the model matrix
+layout(location = 3) in mat4 modelViewMatrix;
+layout(location = 7) in float layer;
+
+layout(location = 0) flat out int out_layer;
+
+void main(void) {
+	gl_Position = projectionMatrix * modelViewMatrix * vec4(pos, 1);
+	out_layer = int(layer);
+}
@@ -4,15 +4,17 @@ precision highp int;
 precision highp float;
 precision highp sampler2D;
 
-layout(std430, push_constant) uniform MVP {
+layout(std430, push_constant) uniform MeshInstancePushConstant {
 	mat4 projectionMatrix;
-	mat4 modelViewMatrix;
 };
 
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec3 color;
 
+// Per instance
+layout(location = 3) in mat4 modelViewMatrix;
+
 void main(void) {
     gl_Position = projectionMatrix * modelViewMatrix * vec4(pos, 1);
 }
@@ -4,15 +4,18 @@ precision highp int;
 precision highp float;
 precision highp sampler2D;
 
-layout(std430, push_constant) uniform MVP {
+layout(std430, push_constant) uniform MeshInstancePushConstant {
 	mat4 projectionMatrix;
-	mat4 modelViewMatrix;
 };
 
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec3 color;
 
+// Per instance
+layout(location = 3) in mat4 modelViewMatrix;
+layout(location = 7) in mat3 normalMatrix;
+
 struct V2F {
 	vec3 pos;
 	vec3 normal;
@@ -22,8 +25,9 @@ struct V2F {
 layout(location = 0) out V2F v2f;
 
 void main(void) {
-    gl_Position = projectionMatrix * modelViewMatrix * vec4(pos, 1);
-    v2f.pos = (modelViewMatrix * vec4(pos, 1)).xyz;
-    v2f.normal = normalize(transpose(inverse(mat3(modelViewMatrix))) * normal);
+    vec4 viewPos = modelViewMatrix * vec4(pos, 1);
+    gl_Position = projectionMatrix * viewPos;
+    v2f.pos = viewPos.xyz;
+    v2f.normal = normalize(normalMatrix * normal);
     v2f.color = color;
 }
@@ -0,0 +1,24 @@
+# Offline converter from Wavefront OBJ to the binary .v4dmesh format, with a loading throughput benchmark
+# It only builds the engine's mesh data, file format and simplifier, which do not depend on Vulkan or Qt.
+
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+ROOT = ../..
+
+SOURCES += \
+    $$ROOT/libs/v4d/graphics/MeshFile.cpp \
+    $$ROOT/libs/v4d/graphics/MeshSimplifier.cpp \
+    main.cpp
+
+HEADERS += \
+    $$ROOT/libs/v4d/core.h \
+    $$ROOT/libs/v4d/graphics/Bounds.hpp \
+    $$ROOT/libs/v4d/graphics/MeshData.h \
+    $$ROOT/libs/v4d/graphics/MeshFile.h \
+    $$ROOT/libs/v4d/graphics/MeshSimplifier.h
+
+INCLUDEPATH += $$ROOT
+INCLUDEPATH += $$ROOT/libs/xvk/glm
+
+QMAKE_CXXFLAGS += -Wno-unknown-pragmas
@@ -0,0 +1,176 @@
+/*
+ * Offline mesh converter
+ *
+ * Converts Wavefront OBJ files to the binary .v4dmesh format (with generated levels of detail),
+ * and benchmarks the loading throughput of .v4dmesh files.
+ *
+ *   MeshConverter <input.obj> <output.v4dmesh> [--lods N]
+ *   MeshConverter --bench <file.v4dmesh>... [--iterations N]
+ */
+#include "libs/v4d/core.h"
+#include "libs/v4d/graphics/MeshFile.h"
+
+using namespace v4d::graphics;
+
+#pragma region OBJ
+
+// Reads positions, normals and optional vertex colors (v x y z r g b), polygons are triangulated as fans.
+// Vertices are deduplicated per position/normal pair. Missing normals are computed from the faces.
+static void ReadObj(const std::string& filePath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	std::ifstream file(filePath);
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open " + filePath);
+
+	std::vector<glm::vec3> positions, colors, normals;
+	std::unordered_map<uint64_t, uint32_t> vertexIndices;
+	bool computeNormals = false;
+
+	// OBJ indices are 1-based and may be negative (relative to the end)
+	auto resolve = [](long index, size_t count) -> long {
+		return index < 0 ? (long)count + index : index - 1;
+	};
+
+	std::string line;
+	std::vector<uint32_t> face;
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+		if (type == "v") {
+			glm::vec3 p {0}, c {0.5};
+			stream >> p.x >> p.y >> p.z;
+			if (!(stream >> c.r >> c.g >> c.b)) c = glm::vec3{0.5};
+			positions.push_back(p);
+			colors.push_back(c);
+		} else if (type == "vn") {
+			glm::vec3 n {0};
+			stream >> n.x >> n.y >> n.z;
+			normals.push_back(n);
+		} else if (type == "f") {
+			face.clear();
+			std::string token;
+			while (stream >> token) {
+				// v, v/vt, v//vn or v/vt/vn
+				long v = 0, vn = 0;
+				size_t firstSlash = token.find('/');
+				v = resolve(std::stol(token.substr(0, firstSlash)), positions.size());
+				if (firstSlash != std::string::npos) {
+					size_t secondSlash = token.find('/', firstSlash + 1);
+					if (secondSlash != std::string::npos && secondSlash + 1 < token.size())
+						vn = resolve(std::stol(token.substr(secondSlash + 1)), normals.size()) + 1;
+				}
+				if (v < 0 || v >= (long)positions.size() || vn < 0 || vn > (long)normals.size())
+					throw std::runtime_error("Invalid face index in " + filePath + " : " + line);
+				if (vn == 0) computeNormals = true;
+
+				uint64_t key = uint64_t(v) << 32 | uint64_t(vn);
+				auto [it, inserted] = vertexIndices.try_emplace(key, (uint32_t)vertices.size());
+				if (inserted) vertices.emplace_back(positions[v], vn ? glm::normalize(normals[vn-1]) : glm::vec3{0}, colors[v]);
+				face.push_back(it->second);
+			}
+			for (size_t i = 2; i < face.size(); ++i) {
+				indices.insert(indices.end(), {face[0], face[i-1], face[i]});
+			}
+		}
+	}
+
+	if (computeNormals) {
+		// Vertices without a normal (vn index 0 in their key) get the area-weighted sum of their face normals
+		std::vector<bool> missingNormal(vertices.size(), false);
+		for (auto [key, index] : vertexIndices) {
+			if ((key & 0xffffffff) == 0) missingNormal[index] = true;
+		}
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			glm::vec3 n = glm::cross(vertices[indices[i+1]].pos - vertices[indices[i]].pos, vertices[indices[i+2]].pos - vertices[indices[i]].pos);
+			for (size_t k = i; k < i + 3; ++k) {
+				if (missingNormal[indices[k]]) vertices[indices[k]].normal += n;
+			}
+		}
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			float length = glm::length(vertices[i].normal);
+			if (missingNormal[i] && length > 0) vertices[i].normal /= length;
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Benchmark
+
+static int Bench(const std::vector<std::string>& files, int iterations) {
+	// Stands in for a mapped staging buffer, so that we measure the one copy that a real upload does
+	std::vector<std::byte> staging;
+	size_t totalBytes = 0;
+	size_t meshCount = 0;
+	double coldSeconds = 0, warmSeconds = 0;
+
+	for (int iteration = 0; iteration <= iterations; ++iteration) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (auto& filePath : files) {
+			MeshFile file(filePath);
+			const auto& header = file.GetHeader();
+			size_t vertexSize = header.vertexCount * sizeof(Vertex);
+			size_t indexSize = header.indexCount * sizeof(uint32_t);
+			if (staging.size() < vertexSize + indexSize) staging.resize(vertexSize + indexSize);
+			memcpy(staging.data(), file.GetVertices(), vertexSize);
+			memcpy(staging.data() + vertexSize, file.GetIndices(), indexSize);
+			if (iteration > 0) {
+				totalBytes += vertexSize + indexSize;
+				meshCount++;
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		// The first pass may hit the disk, the next ones read from the page cache
+		if (iteration == 0) coldSeconds = seconds;
+		else warmSeconds += seconds;
+	}
+
+	LOG("First pass: " << files.size() << " meshes in " << (coldSeconds * 1000.0) << " ms")
+	if (iterations > 0 && warmSeconds > 0) {
+		LOG("Warm: " << (totalBytes / warmSeconds / 1048576.0) << " MB/s, " << (meshCount / warmSeconds) << " meshes/s (" << iterations << " iterations)")
+	}
+	return 0;
+}
+
+#pragma endregion
+
+int main(int argc, char* argv[]) {
+	std::vector<std::string> args(argv + 1, argv + argc);
+	try {
+		if (args.size() >= 2 && args[0] == "--bench") {
+			std::vector<std::string> files;
+			int iterations = 10;
+			for (size_t i = 1; i < args.size(); ++i) {
+				if (args[i] == "--iterations" && i + 1 < args.size()) iterations = std::stoi(args[++i]);
+				else files.push_back(args[i]);
+			}
+			return Bench(files, iterations);
+		}
+
+		if (args.size() >= 2) {
+			int lodCount = 5;
+			for (size_t i = 2; i < args.size(); ++i) {
+				if (args[i] == "--lods" && i + 1 < args.size()) lodCount = std::stoi(args[++i]);
+			}
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			ReadObj(args[0], vertices, indices);
+			MeshData mesh(vertices, indices);
+			mesh.GenerateLods(lodCount);
+			MeshFile::Write(args[1], mesh);
+			LOG(args[1] << " : " << mesh.vertices.size() << " vertices, " << mesh.lods.size() << " levels of detail")
+			for (auto& lod : mesh.lods) {
+				LOG("    " << (lod.indexCount / 3) << " triangles, error " << lod.error)
+			}
+			return 0;
+		}
+	} catch (std::exception& e) {
+		LOG_ERROR(e.what())
+		return 1;
+	}
+
+	std::cout << "Usage:" << std::endl
+		<< "    MeshConverter <input.obj> <output.v4dmesh> [--lods N]" << std::endl
+		<< "    MeshConverter --bench <file.v4dmesh>... [--iterations N]" << std::endl;
+	return 1;
+}